@@ -1,3 +1,8 @@
+import com.android.build.api.artifact.SingleArtifact
+import java.io.ByteArrayOutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
 plugins {
     id("com.android.application")
     kotlin("android")
@@ -15,6 +20,17 @@ android {
         // Compressed resources cannot be mmapped.
         // We leave dictionary files uncompressed to speed up their loading
         noCompress.add("txt")
+        noCompress.add("idx")
+        noCompress.add("fcd")
+
+        // Text dictionaries ship front-coded (see encodeDictionaries), so they stay out of the APK.
+        // Any pattern replaces the default ones of aapt, so those are listed as well
+        ignoreAssetsPatterns.addAll(
+            listOf(
+                "!.svn", "!.git", "!.ds_store", "!*.scc", ".*", "<dir>_*", "!CVS", "!thumbs.db",
+                "!picasa.ini", "!*~", "!words.txt"
+            )
+        )
     }
 
     buildFeatures {
@@ -102,3 +118,192 @@ dependencies {
 kapt {
     correctErrorTypes = true
 }
+
+val encodeDictionaries = tasks.register<EncodeDictionariesTask>("encodeDictionaries") {
+    dictionariesDirectory.set(layout.projectDirectory.dir("src/main/assets/dictionaries"))
+    sampleText.set(layout.projectDirectory.file("src/tools/resources/front_coded/sample.txt"))
+    sampleBlob.set(layout.projectDirectory.file("src/tools/resources/front_coded/sample.fcd"))
+    outputDirectory.set(layout.buildDirectory.dir("generated/dictionaries"))
+}
+
+androidComponents {
+    onVariants { variant ->
+        variant.sources.assets?.addGeneratedSourceDirectory(
+            encodeDictionaries,
+            EncodeDictionariesTask::outputDirectory
+        )
+
+        // words.txt is ignored whether or not words.fcd made it, so make sure it did
+        val variantName = variant.name.replaceFirstChar { it.uppercase() }
+        val checkAssets = tasks.register<CheckDictionaryAssetsTask>(
+            "check${variantName}DictionaryAssets"
+        ) {
+            dictionariesDirectory.set(layout.projectDirectory.dir("src/main/assets/dictionaries"))
+            mergedAssets.set(variant.artifacts.get(SingleArtifact.ASSETS))
+        }
+        tasks.matching { it.name == "package$variantName" }.configureEach {
+            dependsOn(checkAssets)
+        }
+    }
+}
+
+/**
+ * Front-codes every bundled words.txt into the words.fcd the app loads instead,
+ * byte for byte like the host-side crossword-dictionary-encoder does
+ * (see indexing/front_coded.hpp for the layout).
+ * Both encode the same sample to the same checked-in blob: the encoder's output is checked
+ * by crossword-benchmark --verify, and this task's output before it encodes anything.
+ */
+abstract class EncodeDictionariesTask : DefaultTask() {
+
+    @get:InputDirectory
+    @get:PathSensitive(PathSensitivity.RELATIVE)
+    abstract val dictionariesDirectory: DirectoryProperty
+
+    @get:InputFile
+    @get:PathSensitive(PathSensitivity.NONE)
+    abstract val sampleText: RegularFileProperty
+
+    @get:InputFile
+    @get:PathSensitive(PathSensitivity.NONE)
+    abstract val sampleBlob: RegularFileProperty
+
+    @get:OutputDirectory
+    abstract val outputDirectory: DirectoryProperty
+
+    @TaskAction
+    fun encode() {
+        val sample = frontCode(sampleText.get().asFile.readBytes())
+        check(sample.contentEquals(sampleBlob.get().asFile.readBytes())) {
+            "The sample dictionary does not encode like crossword-dictionary-encoder does"
+        }
+
+        val dictionaries = dictionariesDirectory.get().asFile
+        val output = outputDirectory.get().asFile
+        output.deleteRecursively()
+
+        dictionaries.walk().filter { it.name == "words.txt" }.forEach { text ->
+            val relative = text.parentFile.relativeTo(dictionaries)
+            val target = output.resolve("dictionaries").resolve(relative).resolve("words.fcd")
+            target.parentFile.mkdirs()
+            target.writeBytes(frontCode(text.readBytes()))
+        }
+    }
+
+    private fun frontCode(text: ByteArray): ByteArray {
+        val data = ByteArrayOutputStream()
+        val blocks = mutableListOf<Pair<Int, Int>>()
+        var lineCount = 0
+        var textSize = 0
+        var previousStart = 0
+        var previousLength = 0
+
+        fun addLine(start: Int, length: Int) {
+            check(length <= MAX_LINE_LENGTH) {
+                "Lines longer than $MAX_LINE_LENGTH bytes cannot be encoded"
+            }
+
+            // Every block starts with a line that shares nothing, to be decoded on its own
+            if (lineCount % LINES_PER_BLOCK == 0) {
+                blocks.add(data.size() to textSize)
+                previousLength = 0
+            }
+
+            var shared = 0
+            val maxShared = minOf(length, previousLength)
+            while (shared < maxShared && text[start + shared] == text[previousStart + shared]) {
+                shared++
+            }
+
+            val suffix = length - shared
+            if (shared < ESCAPE_NIBBLE && suffix <= 0xF) {
+                data.write(shared shl 4 or suffix)
+            } else {
+                data.write(ESCAPE_NIBBLE shl 4)
+                data.write(shared)
+                data.write(suffix)
+            }
+            data.write(text, start + shared, suffix)
+
+            previousStart = start
+            previousLength = length
+            lineCount++
+            textSize += length + 1
+        }
+
+        // Both CR and LF end a line, and empty lines are skipped, like the loaders do
+        var lineStart = 0
+        val lf = '\n'.code.toByte()
+        val cr = '\r'.code.toByte()
+        for (i in 0..text.size) {
+            if (i == text.size || text[i] == lf || text[i] == cr) {
+                if (i > lineStart) {
+                    addLine(lineStart, i - lineStart)
+                }
+                lineStart = i + 1
+            }
+        }
+        blocks.add(data.size() to textSize)
+
+        val blocksOffset = HEADER_SIZE
+        val dataOffset = blocksOffset + blocks.size * BLOCK_SIZE
+        val totalSize = dataOffset + data.size()
+        val blob = ByteBuffer.allocate(totalSize).order(ByteOrder.LITTLE_ENDIAN)
+        blob.put("XWDF".toByteArray(Charsets.US_ASCII))
+        blob.putInt(VERSION)
+        blob.putInt(lineCount)
+        blob.putInt(blocks.size - 1)
+        blob.putInt(LINES_PER_BLOCK)
+        blob.putInt(blocksOffset)
+        blob.putInt(dataOffset)
+        blob.putInt(data.size())
+        blob.putInt(textSize)
+        blob.putInt(totalSize)
+        blocks.forEach { (blockData, blockText) ->
+            blob.putInt(blockData)
+            blob.putInt(blockText)
+        }
+        blob.put(data.toByteArray())
+        return blob.array()
+    }
+
+    companion object {
+        private const val VERSION = 1
+        private const val HEADER_SIZE = 40
+        private const val BLOCK_SIZE = 8
+        private const val LINES_PER_BLOCK = 128
+        private const val ESCAPE_NIBBLE = 0xF
+        private const val MAX_LINE_LENGTH = 255
+    }
+}
+
+/**
+ * Makes sure that the merged assets of a variant hold the front-coded form
+ * of every bundled dictionary, and not its plain text.
+ */
+abstract class CheckDictionaryAssetsTask : DefaultTask() {
+
+    @get:InputDirectory
+    @get:PathSensitive(PathSensitivity.RELATIVE)
+    abstract val dictionariesDirectory: DirectoryProperty
+
+    @get:InputDirectory
+    @get:PathSensitive(PathSensitivity.RELATIVE)
+    abstract val mergedAssets: DirectoryProperty
+
+    @TaskAction
+    fun checkAssets() {
+        val dictionaries = dictionariesDirectory.get().asFile
+        val assets = mergedAssets.get().asFile.resolve("dictionaries")
+
+        dictionaries.walk().filter { it.name == "words.txt" }.forEach { text ->
+            val relative = text.parentFile.relativeTo(dictionaries)
+            check(assets.resolve(relative).resolve("words.fcd").isFile) {
+                "Assets lack the front-coded form of $relative/words.txt"
+            }
+            check(!assets.resolve(relative).resolve("words.txt").exists()) {
+                "Assets hold the plain text of $relative/words.txt"
+            }
+        }
+    }
+}
@@ -0,0 +1,1173 @@
+#include "indexing/anagrams.hpp"
+#include "indexing/front_coded.hpp"
+#include "indexing/missing_letters.hpp"
+#include "indexing/prebuilt.hpp"
+#include "indexing/rhymes.hpp"
+#include "indexing/word_index.hpp"
+#include "utils/cancellation.hpp"
+#include "utils/utf8.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using crossword::indexing::AnagramIndex;
+using crossword::indexing::MissingLettersIndex;
+using crossword::indexing::PrebuiltIndex;
+using crossword::indexing::RhymeIndex;
+using crossword::indexing::WordIndex;
+using crossword::utils::CancellationToken;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Patterns used to measure missing letters lookups.
+    /// They range from very selective to ones that fan out across most of the trie.
+    const char8_t* const missing_letters_patterns[] = {
+        u8"k.t",        u8"a.",        u8"..a..",       u8"ko...",     u8"prz......",
+        u8"ż..a",       u8".....a...", u8"......ość",   u8"..........", u8"nie........",
+        u8"k.r.w.",     u8".a.o.e..",  u8"ł....",       u8"......",    u8"zaba.......",
+        u8"...........y",
+    };
+
+    /// Patterns using sets of letters, runs and length bounds (see CompiledPattern).
+    const char8_t* const extended_patterns[] = {
+        u8"k[oa]t",   u8"[ąa]*ość", u8"*ość{5,7}", u8"pr[zs]*nie", u8"[^aey]*[^aey]{4}",
+        u8"ko?t*",    u8"*ż*ź*",    u8"*a{10,}",
+    };
+
+    /// Patterns typed a keystroke at a time, filling in dots and then fixing a letter.
+    const char8_t* const typing_sequence[] = {
+        u8"........", u8".a......", u8".a.o....", u8".a.o.e..", u8".a.o.et.",
+        u8".a.o.etr", u8"ba.o.etr", u8"barometr", u8"batometr",
+    };
+
+    /// Patterns with many results, which take long to look up all of them.
+    const char8_t* const cancelled_patterns[] = {
+        u8"..........", u8".....a...", u8"*a{10,}", u8"[^aey]*[^aey]{4}",
+    };
+
+    /// Words differing only in letters outside of the alphabet, which all share a symbol.
+    /// Xβz spells xβz in other case, so it replaces the latter like any other duplicate.
+    const char8_t* const homographs[] = {
+        u8"xβz", u8"xγz", u8"kotα", u8"αβγ", u8"Xβz", u8"kotβ", u8"δεζ", u8"xδz",
+    };
+
+    /// Patterns matching the homographs, one or all of them.
+    const char8_t* const homograph_patterns[] = {
+        u8"xβz", u8"XΓZ", u8"x.z", u8"...", u8"kot.", u8"kotβ", u8".β.", u8"αβγ",
+        u8"k[oa]t*", u8"*z", u8"x?z", u8"*γ*",
+    };
+
+    /// Words used to measure anagram lookups.
+    const char8_t* const anagram_queries[] = {
+        u8"kot", u8"alert", u8"ołtarz", u8"rak", u8"kajak", u8"sroka", u8"lampa", u8"zamek",
+    };
+
+    /// Words used to measure rhyme lookups.
+    const char8_t* const rhyme_queries[] = {
+        u8"kot", u8"miłość", u8"rzeka", u8"krzesło", u8"zamek", u8"pies",
+    };
+
+    /// How many results does the app request per lookup?
+    constexpr size_t max_results = 500;
+
+    /// How many of the most frequent words does a ranked lookup request?
+    constexpr size_t best_results = 20;
+
+    /// Reads the whole file into memory. Returns an empty vector on failure.
+    std::vector<uint8_t> read_file(const char* path) {
+        std::vector<uint8_t> contents;
+        auto file = std::fopen(path, "rb");
+        if (file == nullptr) {
+            return contents;
+        }
+
+        uint8_t chunk[65536];
+        size_t read;
+        while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            contents.insert(contents.end(), chunk, chunk + read);
+        }
+
+        std::fclose(file);
+        return contents;
+    }
+
+    /// Reports the peak resident set size of this process, in KiB.
+    long peak_rss_kib() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    /// Reports the current resident set size of this process, in KiB.
+    long current_rss_kib() {
+        long pages_total = 0;
+        long pages_resident = 0;
+        auto statm = std::fopen("/proc/self/statm", "r");
+        if (statm == nullptr) {
+            return 0;
+        }
+        if (std::fscanf(statm, "%ld %ld", &pages_total, &pages_resident) != 2) {
+            pages_resident = 0;
+        }
+        std::fclose(statm);
+        return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    template <typename Duration>
+    double to_ms(Duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    template <typename Duration>
+    double to_us(Duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+
+    /// Picks the p-th percentile from a sorted sample.
+    double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        auto rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    /// Prints a UTF-8 string left-aligned in a column of the given width.
+    void print_padded(const char8_t* str, int width) {
+        auto length = 0;
+        for (auto it = str; *it != 0; ++it) {
+            if (!crossword::utils::codepoint_is_continuation(*it)) {
+                ++length;
+            }
+        }
+        std::printf("%s%*s", reinterpret_cast<const char*>(str), std::max(width - length, 0), "");
+    }
+
+    /// Estimates how much memory the trie nodes and their child maps take.
+    double node_memory_mib(const MissingLettersIndex& index) {
+        using Chunk = crossword::ChildChunk;
+        auto bytes = index.node_count() * sizeof(crossword::WordNode)
+                     + index.chunk_count() * sizeof(Chunk);
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+
+    double to_mib(size_t bytes) {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+
+    /// Prints where the memory of an index goes, as reported by the index itself.
+    void print_memory(const char* name, const WordIndex& index) {
+        auto stats = index.memory_stats();
+        auto total = stats.other_bytes;
+        for (const auto& arena : stats.arenas) {
+            std::printf("[%s] arena %s: %zu segments, reserved %.1f MiB, used %.1f MiB, "
+                        "released %.2f MiB\n",
+                        name, arena.name, arena.stats.segment_count,
+                        to_mib(arena.stats.reserved_bytes), to_mib(arena.stats.used_bytes),
+                        to_mib(arena.stats.released_bytes));
+            total += arena.stats.reserved_bytes;
+        }
+        std::printf("[%s] other: %.1f MiB, total: %.1f MiB\n", name, to_mib(stats.other_bytes),
+                    to_mib(total));
+
+        if (!stats.fan_out.empty()) {
+            std::printf("[%s] fan-out:", name);
+            for (size_t n = 0; n < stats.fan_out.size(); ++n) {
+                if (stats.fan_out[n] > 0) {
+                    std::printf(" %zu:%zu", n, stats.fan_out[n]);
+                }
+            }
+            std::printf("\n");
+        }
+    }
+
+    /// Loads an index of type T from the buffer and reports how long it took.
+    /// @param sharded Whether to build disjoint key ranges instead of merging partial indexes.
+    template <typename T>
+    std::unique_ptr<T> load(const char* name,
+                            const std::vector<uint8_t>& buffer,
+                            int thread_count,
+                            bool sharded = false) {
+        auto rss_before = current_rss_kib();
+        auto index = std::make_unique<T>();
+        auto length = static_cast<int>(buffer.size());
+
+        auto start = Clock::now();
+        if constexpr (requires { index->load_from_buffer_sharded(nullptr, 0, 0); }) {
+            if (sharded) {
+                index->load_from_buffer_sharded(buffer.data(), length, thread_count);
+            } else {
+                index->load_from_buffer_parallel(buffer.data(), length, thread_count);
+            }
+        } else {
+            index->load_from_buffer_parallel(buffer.data(), length, thread_count);
+        }
+        auto end = Clock::now();
+
+        const auto& stats = index->last_load_stats();
+        std::printf("[%s, threads: %d%s] load: %.1f ms (partition: %.1f ms, parse: %.1f ms, "
+                    "merge: %.1f ms), rss delta: %.1f MiB\n",
+                    name, thread_count, sharded ? ", sharded" : "", to_ms(end - start),
+                    to_ms(stats.partition_time), to_ms(stats.parse_time), to_ms(stats.merge_time),
+                    static_cast<double>(current_rss_kib() - rss_before) / 1024.0);
+        return index;
+    }
+
+    /// Runs every query the given number of times and prints latency percentiles.
+    template <size_t N>
+    void measure_lookups(const char* name,
+                         const WordIndex& index,
+                         const char8_t* const (&queries)[N],
+                         int iterations) {
+        std::vector<double> all_samples;
+        std::vector<double> samples;
+
+        std::printf("[%s] lookup latency, %d iterations per query, up to %zu results:\n", name,
+                    iterations, max_results);
+        std::printf("  %-16s %8s %10s %10s\n", "query", "results", "p50 us", "p99 us");
+
+        for (auto query_chars : queries) {
+            auto query = std::u8string(query_chars);
+            samples.clear();
+
+            // Warm up the caches first
+            auto result_count = index.lookup(query, max_results).size();
+
+            for (auto i = 0; i < iterations; ++i) {
+                auto start = Clock::now();
+                auto results = index.lookup(query, max_results);
+                auto end = Clock::now();
+                samples.push_back(to_us(end - start));
+            }
+
+            std::sort(samples.begin(), samples.end());
+            all_samples.insert(all_samples.end(), samples.begin(), samples.end());
+            std::printf("  ");
+            print_padded(query_chars, 16);
+            std::printf(" %8zu %10.1f %10.1f\n", result_count, percentile(samples, 0.5),
+                        percentile(samples, 0.99));
+        }
+
+        std::sort(all_samples.begin(), all_samples.end());
+        std::printf("  %-16s %8s %10.1f %10.1f\n", "(all)", "", percentile(all_samples, 0.5),
+                    percentile(all_samples, 0.99));
+    }
+
+    /// Scores every word of the dictionary with a Zipf-like frequency, in a random order,
+    /// and formats the scores as load_scores expects them. No dictionary ships frequencies.
+    std::vector<uint8_t> synthetic_scores(const std::vector<uint8_t>& dictionary) {
+        std::vector<std::string_view> words;
+        crossword::utils::for_each_line(dictionary.data(), 0, dictionary.size(),
+                                        [&](const uint8_t* line, size_t length) {
+                                            words.emplace_back(
+                                                reinterpret_cast<const char*>(line), length);
+                                        });
+
+        std::mt19937 random(2024);
+        std::shuffle(words.begin(), words.end(), random);
+
+        std::string scores;
+        for (size_t rank = 0; rank < words.size(); ++rank) {
+            scores += words[rank];
+            scores += '\t';
+            scores += std::to_string(100'000'000 / (rank + 1));
+            scores += '\n';
+        }
+        return {scores.begin(), scores.end()};
+    }
+
+    /// Looks up the most frequent words of every pattern and prints latency percentiles,
+    /// next to how many words match the pattern in total.
+    template <size_t N>
+    void measure_best(const char* name,
+                      const MissingLettersIndex& index,
+                      const char8_t* const (&queries)[N],
+                      int iterations) {
+        std::vector<double> samples;
+
+        std::printf("[%s] ranked lookup latency, %d iterations per query, best %zu results:\n",
+                    name, iterations, best_results);
+        std::printf("  %-16s %8s %10s %10s\n", "query", "matches", "p50 us", "p99 us");
+
+        for (auto query_chars : queries) {
+            auto query = std::u8string(query_chars);
+            samples.clear();
+
+            auto match_count = index.lookup(query, SIZE_MAX).size();
+            for (auto i = 0; i < iterations; ++i) {
+                auto start = Clock::now();
+                auto results = index.lookup_best(query, best_results);
+                auto end = Clock::now();
+                samples.push_back(to_us(end - start));
+            }
+
+            std::sort(samples.begin(), samples.end());
+            std::printf("  ");
+            print_padded(query_chars, 16);
+            std::printf(" %8zu %10.1f %10.1f\n", match_count, percentile(samples, 0.5),
+                        percentile(samples, 0.99));
+        }
+    }
+
+    /// Looks up the first page of every pattern of the typing sequence, in order,
+    /// and prints latency percentiles of every keystroke.
+    /// @param cached Whether to look the sequence up through a fresh query cache every time.
+    void measure_typing(const char* name, MissingLettersIndex& index, bool cached, int iterations) {
+        constexpr auto steps = std::size(typing_sequence);
+        std::vector<std::vector<double>> samples(steps);
+
+        for (auto i = 0; i < iterations; ++i) {
+            if (cached) {
+                index.enable_query_cache();
+            }
+            for (size_t step = 0; step < steps; ++step) {
+                auto query = std::u8string(typing_sequence[step]);
+                auto start = Clock::now();
+                auto page = index.lookup_page(query, max_results, {});
+                auto end = Clock::now();
+                samples[step].push_back(to_us(end - start));
+            }
+        }
+        index.disable_query_cache();
+
+        std::printf("[%s] typing latency, %d iterations, up to %zu results:\n", name, iterations,
+                    max_results);
+        std::printf("  %-16s %8s %10s %10s\n", "query", "results", "p50 us", "p99 us");
+        for (size_t step = 0; step < steps; ++step) {
+            std::sort(samples[step].begin(), samples[step].end());
+            auto result_count = index.lookup(typing_sequence[step], max_results).size();
+            std::printf("  ");
+            print_padded(typing_sequence[step], 16);
+            std::printf(" %8zu %10.1f %10.1f\n", result_count, percentile(samples[step], 0.5),
+                        percentile(samples[step], 0.99));
+        }
+    }
+
+    /// Looks up all the results of every pattern on another thread, cancels the lookup
+    /// shortly after it starts, and prints how long it takes to return afterwards.
+    template <size_t N>
+    void measure_cancellation(const char* name,
+                              const WordIndex& index,
+                              const char8_t* const (&queries)[N],
+                              int iterations) {
+        constexpr size_t all_results = 1'000'000;
+        constexpr auto cancel_after = std::chrono::microseconds(200);
+        std::vector<double> samples;
+
+        std::printf("[%s] cancellation latency, %d iterations per query, cancelled after %d us:\n",
+                    name, iterations, static_cast<int>(cancel_after.count()));
+        std::printf("  %-16s %8s %10s %10s %10s\n", "query", "results", "full us", "p50 us",
+                    "p99 us");
+
+        for (auto query_chars : queries) {
+            auto query = std::u8string(query_chars);
+            samples.clear();
+
+            auto start = Clock::now();
+            auto result_count = index.lookup_page(query, all_results, {}).words.size();
+            auto full = to_us(Clock::now() - start);
+
+            for (auto i = 0; i < iterations; ++i) {
+                CancellationToken cancellation;
+                std::thread lookup([&] {
+                    index.lookup_page(query, all_results, {}, &cancellation);
+                });
+                std::this_thread::sleep_for(cancel_after);
+
+                auto cancelled = Clock::now();
+                cancellation.cancel();
+                lookup.join();
+                samples.push_back(to_us(Clock::now() - cancelled));
+            }
+
+            std::sort(samples.begin(), samples.end());
+            std::printf("  ");
+            print_padded(query_chars, 16);
+            std::printf(" %8zu %10.1f %10.1f %10.1f\n", result_count, full,
+                        percentile(samples, 0.5), percentile(samples, 0.99));
+        }
+    }
+
+    /// Encodes the dictionary as front-coded, reports its size, and measures how long it takes
+    /// to decode it serially and in parallel.
+    /// @returns The decoded text, to measure loading from it.
+    std::vector<uint8_t> measure_front_coded(const std::vector<uint8_t>& buffer,
+                                             int thread_count,
+                                             int iterations) {
+        namespace front_coded = crossword::indexing::front_coded;
+
+        auto encode_start = Clock::now();
+        auto blob = front_coded::encode(buffer.data(), buffer.size());
+        auto encode_end = Clock::now();
+
+        front_coded::Dictionary dictionary;
+        if (!dictionary.open(blob.data(), blob.size())) {
+            return {};
+        }
+
+        std::printf("[front_coded] size: %.1f MiB (%.1f%% of the text), blocks: %zu, "
+                    "encode: %.1f ms\n",
+                    to_mib(blob.size()),
+                    100.0 * static_cast<double>(blob.size()) / static_cast<double>(buffer.size()),
+                    dictionary.block_count(), to_ms(encode_end - encode_start));
+
+        std::vector<uint8_t> text;
+        for (auto threads : {1, thread_count}) {
+            std::vector<double> samples;
+            for (auto i = 0; i < iterations; ++i) {
+                auto start = Clock::now();
+                text = dictionary.decode(threads);
+                auto end = Clock::now();
+                samples.push_back(to_ms(end - start));
+            }
+
+            std::sort(samples.begin(), samples.end());
+            std::printf("[front_coded, threads: %d] decode p50: %.2f ms, p99: %.2f ms\n", threads,
+                        percentile(samples, 0.5), percentile(samples, 0.99));
+        }
+        return text;
+    }
+
+    /// Applies a transformation (e.g. minimization) to the index and measures it again.
+    template <typename F>
+    void transform(const char* name, MissingLettersIndex& index, F&& fn, int iterations) {
+        auto start = Clock::now();
+        fn(index);
+        auto end = Clock::now();
+
+        std::printf("[%s] time: %.1f ms, nodes: %zu, chunks: %zu, node memory: %.1f MiB\n", name,
+                    to_ms(end - start), index.node_count(), index.chunk_count(),
+                    node_memory_mib(index));
+        measure_lookups(name, index, missing_letters_patterns, iterations);
+        measure_lookups(name, index, extended_patterns, iterations);
+    }
+
+    /// Spells a word in lowercase, so that all of its spellings score the same word.
+    std::u8string fold_word(std::u8string_view word) {
+        std::u8string folded;
+        auto it = word.data();
+        auto end = it + word.size();
+        while (it < end) {
+            crossword::utils::append_codepoint(
+                folded, crossword::utils::fold_case(crossword::utils::decode_codepoint(it, end)));
+        }
+        return folded;
+    }
+
+    /// Decodes the codepoints of a word in lowercase.
+    std::u32string folded_letters(std::u8string_view word) {
+        std::u32string letters;
+        auto it = word.data();
+        auto end = it + word.size();
+        while (it < end) {
+            letters.push_back(
+                crossword::utils::fold_case(crossword::utils::decode_codepoint(it, end)));
+        }
+        return letters;
+    }
+
+    /// Matches case-folded letters with a pattern without any length bounds, by backtracking.
+    bool match_letters(std::u32string_view pattern, std::u32string_view word) {
+        if (pattern.empty()) {
+            return word.empty();
+        }
+
+        auto rest = pattern.substr(1);
+        switch (pattern[0]) {
+        case U'*':
+            return match_letters(rest, word)
+                   || (!word.empty() && match_letters(pattern, word.substr(1)));
+        case U'?':
+            return match_letters(rest, word)
+                   || (!word.empty() && match_letters(rest, word.substr(1)));
+        case U'.':
+            return !word.empty() && match_letters(rest, word.substr(1));
+        case U'[': {
+            auto close = pattern.find(U']');
+            auto negated = pattern[1] == U'^';
+            auto letters = pattern.substr(negated ? 2 : 1, close - (negated ? 2 : 1));
+            return !word.empty() && (letters.find(word[0]) != letters.npos) != negated
+                   && match_letters(pattern.substr(close + 1), word.substr(1));
+        }
+        default:
+            return !word.empty() && word[0] == pattern[0] && match_letters(rest, word.substr(1));
+        }
+    }
+
+    /// Matches a word with a well-formed pattern (see CompiledPattern for the syntax)
+    /// codepoint by codepoint, to check the lookups without any automaton.
+    /// Both of them are given as their folded_letters.
+    bool matches_pattern(std::u32string_view source, std::u32string_view letters) {
+        auto bounds = source.find(U'{');
+        if (bounds != source.npos) {
+            auto comma = source.find(U',', bounds);
+            auto close = source.size() - 1;
+            auto bound = [&](size_t from, size_t to, size_t fallback) {
+                size_t value = 0;
+                for (auto i = from; i < to; ++i) {
+                    value = value * 10 + static_cast<size_t>(source[i] - U'0');
+                }
+                return to > from ? value : fallback;
+            };
+            auto min = bound(bounds + 1, std::min(comma, close), 0);
+            auto max = comma == source.npos ? min : bound(comma + 1, close, SIZE_MAX);
+            if (letters.size() < min || letters.size() > max) {
+                return false;
+            }
+            source = source.substr(0, bounds);
+        }
+
+        return match_letters(source, letters);
+    }
+
+    /// Compares lookups of index variants with those of a plain index, see verify.
+    class Verifier {
+    public:
+        /// Patterns along with all of their results.
+        using Expected = std::vector<std::pair<std::u8string, std::vector<std::u8string>>>;
+
+    private:
+        /// All the results of every pattern, as the plain index returns them.
+        Expected expected;
+        size_t mismatches = 0;
+
+        void report(const char* name, const char* how, const std::u8string& pattern) {
+            std::printf("[verify] %s: %s results of %s differ\n", name, how,
+                        reinterpret_cast<const char*>(pattern.c_str()));
+            ++mismatches;
+        }
+
+    public:
+        /// Page size of paged lookups, odd to misalign pages with anything else.
+        static constexpr size_t page_size = 97;
+
+        template <typename... Patterns>
+        explicit Verifier(const WordIndex& reference, const Patterns&... patterns) {
+            auto add = [&](const auto& queries) {
+                for (auto pattern : queries) {
+                    expected.emplace_back(pattern, reference.lookup(pattern, SIZE_MAX));
+                }
+            };
+            (add(patterns), ...);
+        }
+
+        /// Compares lookups with results worked out without any index.
+        explicit Verifier(Expected expected) : expected(std::move(expected)) {}
+
+        /// Adds a pattern along with all of its results.
+        void expect(std::u8string pattern, std::vector<std::u8string> words) {
+            expected.emplace_back(std::move(pattern), std::move(words));
+        }
+
+        /// Checks that all the results of every pattern, and their pages put together,
+        /// come in the same order as those of the plain index.
+        /// @param page Page size of the paged lookups.
+        void check(const char* name, const WordIndex& index, size_t page = page_size) {
+            for (const auto& [pattern, words] : expected) {
+                if (index.lookup(pattern, SIZE_MAX) != words) {
+                    report(name, "all", pattern);
+                }
+
+                std::vector<std::u8string> paged;
+                std::vector<uint8_t> cursor;
+                do {
+                    auto results = index.lookup_page(pattern, page, cursor);
+                    paged.insert(paged.end(), results.words.begin(), results.words.end());
+                    cursor = std::move(results.cursor);
+                } while (!cursor.empty() && paged.size() <= words.size());
+                if (paged != words) {
+                    report(name, "paged", pattern);
+                }
+            }
+        }
+
+        /// Checks that the results of every pattern are the very words matching it,
+        /// as told by matches_pattern, whatever their order and letter case.
+        /// Words spelled in different case share a trie node, so only one of them is returned.
+        void check_matches(const char* name, const std::vector<uint8_t>& buffer) {
+            std::vector<std::pair<std::u8string_view, std::u32string>> all_words;
+            crossword::utils::for_each_line(buffer.data(), 0, buffer.size(),
+                                            [&](const uint8_t* line, size_t length) {
+                                                std::u8string_view word(
+                                                    reinterpret_cast<const char8_t*>(line),
+                                                    length);
+                                                all_words.emplace_back(word,
+                                                                       folded_letters(word));
+                                            });
+
+            auto folded_set = [](const auto& words) {
+                std::vector<std::u8string> folded;
+                for (const auto& word : words) {
+                    folded.push_back(fold_word(word));
+                }
+                std::sort(folded.begin(), folded.end());
+                folded.erase(std::unique(folded.begin(), folded.end()), folded.end());
+                return folded;
+            };
+
+            for (const auto& [pattern, words] : expected) {
+                std::vector<std::u8string_view> matching;
+                auto source = folded_letters(pattern);
+                for (const auto& [word, letters] : all_words) {
+                    if (matches_pattern(source, letters)) {
+                        matching.push_back(word);
+                    }
+                }
+                if (folded_set(words) != folded_set(matching)) {
+                    report(name, "matching", pattern);
+                }
+            }
+        }
+
+        /// Looks up an empty page of every pattern, e.g. to offer them to a query cache.
+        void look_up_empty_pages(const WordIndex& index) const {
+            for (const auto& entry : expected) {
+                index.lookup(entry.first, 0);
+                index.lookup_page(entry.first, 0, {});
+            }
+        }
+
+        /// Checks that the best words of every pattern are the highest-scored of all
+        /// its results, with ties in the order of the plain index.
+        void check_best(const char* name,
+                        const MissingLettersIndex& index,
+                        const std::unordered_map<std::u8string, uint32_t>& scores) {
+            for (const auto& [pattern, words] : expected) {
+                auto best = words;
+                std::stable_sort(best.begin(), best.end(), [&](const auto& a, const auto& b) {
+                    auto score = [&](const auto& word) {
+                        auto it = scores.find(fold_word(word));
+                        return it != scores.end() ? it->second : 0;
+                    };
+                    return score(a) > score(b);
+                });
+
+                for (size_t limit : {size_t{1}, best_results, max_results}) {
+                    auto expected_best = std::vector(best.begin(),
+                                                     best.begin() + static_cast<ptrdiff_t>(
+                                                         std::min(limit, best.size())));
+                    if (index.lookup_best(pattern, limit) != expected_best) {
+                        report(name, "best", pattern);
+                    }
+                }
+            }
+        }
+
+        /// Counts a failed check that is not a lookup of the plain index's patterns.
+        void fail(const char* name, const char* what) {
+            std::printf("[verify] %s: %s\n", name, what);
+            ++mismatches;
+        }
+
+        /// Prints how the checks of an index variant went.
+        void done(const char* name) const {
+            std::printf("[verify] %s: %zu patterns checked, %zu mismatches so far\n", name,
+                        expected.size(), mismatches);
+        }
+
+        bool passed() const noexcept {
+            return mismatches == 0;
+        }
+    };
+
+    /// Reads the number after the tab of a scores line.
+    uint32_t parse_score(const uint8_t* line, size_t tab) {
+        auto score = std::strtoul(reinterpret_cast<const char*>(line) + tab + 1, nullptr, 10);
+        return static_cast<uint32_t>(score);
+    }
+
+    /// Parses the scores the way load_scores does, to score results independently of it.
+    std::unordered_map<std::u8string, uint32_t> parse_scores(const std::vector<uint8_t>& buffer) {
+        std::unordered_map<std::u8string, uint32_t> scores;
+        crossword::utils::for_each_line(buffer.data(), 0, buffer.size(),
+                                        [&](const uint8_t* line, size_t length) {
+                                            std::u8string_view text(
+                                                reinterpret_cast<const char8_t*>(line), length);
+                                            auto tab = text.find(u8'\t');
+                                            auto& stored = scores[fold_word(
+                                                text.substr(0, tab))];
+                                            stored = std::max(stored, parse_score(line, tab));
+                                        });
+        return scores;
+    }
+
+    /// Checks every variant of the missing letters index, loaded, transformed and looked up
+    /// in every supported way, against the results of a plain one.
+    void verify_variants(Verifier& verifier, const std::vector<uint8_t>& buffer,
+                         int thread_count) {
+        auto index = load<MissingLettersIndex>("parallel", buffer, thread_count);
+        verifier.check("parallel load", *index);
+        verifier.done("parallel load");
+
+        index = load<MissingLettersIndex>("sharded", buffer, thread_count, true);
+        verifier.check("sharded load", *index);
+        verifier.done("sharded load");
+
+        index->set_parallel_lookup({.thread_count = static_cast<size_t>(thread_count)});
+        verifier.check("parallel lookup", *index);
+        verifier.done("parallel lookup");
+
+        index->compress();
+        verifier.check("compressed", *index);
+        verifier.done("compressed");
+
+        index->build_suffix_trie();
+        verifier.check("compressed+suffixes", *index);
+        verifier.done("compressed+suffixes");
+
+        index->build_positional_index();
+        verifier.check("compressed+positional", *index);
+        verifier.done("compressed+positional");
+
+        // Twice, so that the second round is served from the cache and refined from it.
+        // Empty pages come first, since they say nothing of the results to cache
+        index->enable_query_cache();
+        verifier.look_up_empty_pages(*index);
+        verifier.check("cached", *index);
+        verifier.check("cached", *index);
+        verifier.done("cached");
+        index->disable_query_cache();
+
+        auto scores_buffer = synthetic_scores(buffer);
+        auto scores = parse_scores(scores_buffer);
+        index->load_scores(scores_buffer.data(), scores_buffer.size());
+        verifier.check_best("compressed+scores", *index, scores);
+        verifier.done("compressed+scores");
+
+        index = load<MissingLettersIndex>("minimized", buffer, thread_count, true);
+        index->minimize();
+        verifier.check("minimized", *index);
+        verifier.done("minimized");
+
+        index->compress();
+        verifier.check("minimized+compressed", *index);
+        verifier.done("minimized+compressed");
+
+        index->load_scores(scores_buffer.data(), scores_buffer.size());
+        verifier.check_best("minimized+scores", *index, scores);
+        verifier.done("minimized+scores");
+    }
+
+    std::vector<uint8_t> to_buffer(std::u8string_view text) {
+        return {text.begin(), text.end()};
+    }
+
+    /// Checks that words differing only in letters outside of the alphabet, which share
+    /// a trie node, all get returned by every variant of the index.
+    /// @returns Whether all the results matched.
+    bool verify_homographs(const std::vector<uint8_t>& buffer, int thread_count) {
+        auto words = to_buffer(u8"kot\nkat\nkit\nkotek\nxβz\nxγz\n");
+        auto index = load<MissingLettersIndex>("homographs", words, 1);
+        Verifier verifier(*index, homograph_patterns);
+        if (index->word_count() != 6) {
+            verifier.fail("homographs", "words are missing");
+        }
+        if (index->lookup(u8"xβz", max_results) != std::vector<std::u8string>{u8"xβz"}) {
+            verifier.fail("homographs", "xβz is not found");
+        }
+        if (index->lookup(u8"x.z", max_results)
+            != std::vector<std::u8string>{u8"xβz", u8"xγz"}) {
+            verifier.fail("homographs", "x.z does not find both words");
+        }
+
+        // Pages of a single word each, which must not split the words of a node
+        std::vector<std::u8string> paged;
+        std::vector<uint8_t> cursor;
+        do {
+            auto page = index->lookup_page(u8"...", 1, cursor);
+            paged.insert(paged.end(), page.words.begin(), page.words.end());
+            cursor = std::move(page.cursor);
+        } while (!cursor.empty() && paged.size() <= 5);
+        if (paged != std::vector<std::u8string>{u8"kat", u8"kit", u8"kot", u8"xβz", u8"xγz"}) {
+            verifier.fail("homographs", "pages of ... differ");
+        }
+        verifier.done("homographs");
+
+        // Homographs spread over a sample of the dictionary, so that loading in parallel
+        // puts them in different partial indexes
+        std::vector<uint8_t> sample;
+        size_t line_number = 0;
+        size_t next = 0;
+        crossword::utils::for_each_line(buffer.data(), 0, buffer.size(),
+                                        [&](const uint8_t* line, size_t length) {
+                                            if (line_number++ % 64 != 0) {
+                                                return;
+                                            }
+                                            sample.insert(sample.end(), line, line + length);
+                                            sample.push_back('\n');
+                                            if (line_number % 32768 == 1
+                                                && next < std::size(homographs)) {
+                                                auto word = to_buffer(homographs[next++]);
+                                                sample.insert(sample.end(), word.begin(),
+                                                              word.end());
+                                                sample.push_back('\n');
+                                            }
+                                        });
+
+        auto reference = load<MissingLettersIndex>("homographs reference", sample, 1);
+        Verifier sample_verifier(*reference, homograph_patterns, missing_letters_patterns,
+                                 extended_patterns);
+        reference.reset();
+        verify_variants(sample_verifier, sample, thread_count);
+        return verifier.passed() && sample_verifier.passed();
+    }
+
+    /// Spells the letters of a word in lowercase and in codepoint order,
+    /// which all of its anagrams share.
+    std::u32string sorted_letters(std::u8string_view word) {
+        auto letters = folded_letters(word);
+        std::sort(letters.begin(), letters.end());
+        return letters;
+    }
+
+    /// Checks anagram lookups against a brute-force grouping of the words by their sorted
+    /// letters, for an index loaded in one piece and one spliced together from many chunks.
+    /// @returns Whether all the results matched.
+    bool verify_anagrams(const std::vector<uint8_t>& buffer, int thread_count) {
+        std::vector<std::u8string> queries(std::begin(anagram_queries), std::end(anagram_queries));
+        queries.emplace_back(u8"KOT");
+        queries.emplace_back(u8"Łotrza");
+        size_t line_number = 0;
+        crossword::utils::for_each_line(buffer.data(), 0, buffer.size(),
+                                        [&](const uint8_t* line, size_t length) {
+                                            if (line_number++ % 1024 == 0) {
+                                                queries.emplace_back(
+                                                    reinterpret_cast<const char8_t*>(line),
+                                                    length);
+                                            }
+                                        });
+
+        // Every word, duplicates included, in the order of the dictionary
+        std::unordered_map<std::u32string, std::vector<std::u8string>> groups;
+        for (const auto& query : queries) {
+            groups[sorted_letters(query)];
+        }
+        crossword::utils::for_each_line(buffer.data(), 0, buffer.size(),
+                                        [&](const uint8_t* line, size_t length) {
+                                            std::u8string_view word(
+                                                reinterpret_cast<const char8_t*>(line), length);
+                                            auto group = groups.find(sorted_letters(word));
+                                            if (group != groups.end()) {
+                                                group->second.emplace_back(word);
+                                            }
+                                        });
+
+        Verifier::Expected expected;
+        for (const auto& query : queries) {
+            expected.emplace_back(query, groups[sorted_letters(query)]);
+        }
+        Verifier verifier(std::move(expected));
+
+        // Posting lists are short, so the pages are too
+        AnagramIndex whole;
+        whole.load_from_buffer(buffer.data(), 0, buffer.size());
+        verifier.check("anagrams", whole, 2);
+        verifier.done("anagrams");
+
+        auto spliced = load<AnagramIndex>("anagrams", buffer, thread_count);
+        verifier.check("spliced anagrams", *spliced, 2);
+        verifier.done("spliced anagrams");
+        return verifier.passed();
+    }
+
+    /// Counts the letters at the end of two case-folded words which they share.
+    size_t shared_ending(std::u32string_view a, std::u32string_view b) {
+        size_t shared = 0;
+        while (shared < a.size() && shared < b.size()
+               && a[a.size() - 1 - shared] == b[b.size() - 1 - shared]) {
+            ++shared;
+        }
+        return shared;
+    }
+
+    /// Checks rhyme lookups against a brute-force search of the words sharing an ending,
+    /// and their pages against all the results, before and after compressing the trie.
+    /// @returns Whether all the results matched.
+    bool verify_rhymes(const std::vector<uint8_t>& buffer, int thread_count) {
+        std::vector<std::pair<std::u8string, std::u32string>> all_words;
+        crossword::utils::for_each_line(buffer.data(), 0, buffer.size(),
+                                        [&](const uint8_t* line, size_t length) {
+                                            std::u8string_view word(
+                                                reinterpret_cast<const char8_t*>(line), length);
+                                            all_words.emplace_back(fold_word(word),
+                                                                   folded_letters(word));
+                                        });
+
+        std::vector<std::u8string> queries(std::begin(rhyme_queries), std::end(rhyme_queries));
+        queries.emplace_back(u8"KOT");
+        queries.emplace_back(u8"zzzkot");
+        queries.emplace_back(u8"ą");
+
+        auto index = load<RhymeIndex>("rhymes", buffer, thread_count);
+        Verifier verifier(Verifier::Expected{});
+        for (const auto& query : queries) {
+            auto results = index->lookup(query, SIZE_MAX);
+            auto letters = folded_letters(query);
+            auto name = std::string(reinterpret_cast<const char*>(query.c_str()));
+
+            // Words spelled in another case share a trie node, so they are compared folded
+            std::vector<std::u8string> rhymes;
+            for (const auto& [word, word_letters] : all_words) {
+                if (word_letters != letters && shared_ending(word_letters, letters) > 0) {
+                    rhymes.push_back(word);
+                }
+            }
+            std::vector<std::u8string> found;
+            size_t last_shared = SIZE_MAX;
+            auto ordered = true;
+            for (const auto& word : results) {
+                auto shared = shared_ending(folded_letters(word), letters);
+                ordered &= shared <= last_shared;
+                last_shared = shared;
+                found.push_back(fold_word(word));
+            }
+            if (!ordered) {
+                verifier.fail("rhymes", (name + ": a longer ending comes later").c_str());
+            }
+            for (auto* words : {&rhymes, &found}) {
+                std::sort(words->begin(), words->end());
+                words->erase(std::unique(words->begin(), words->end()), words->end());
+            }
+            if (found != rhymes) {
+                verifier.fail("rhymes", (name + ": results differ from brute force").c_str());
+            }
+
+            verifier.expect(query, std::move(results));
+        }
+
+        verifier.check("rhymes", *index);
+        verifier.check("rhymes", *index, 7);
+        verifier.done("rhymes");
+
+        index->compress();
+        verifier.check("compressed rhymes", *index);
+        verifier.check("compressed rhymes", *index, 7);
+        verifier.done("compressed rhymes");
+        return verifier.passed();
+    }
+
+    /// Checks that front-coded dictionaries decode to the lines they were encoded from,
+    /// each followed by a LF, on one thread and on many. Besides the dictionary itself,
+    /// this decodes a sample with lines whose lengths do not fit a nibble, CR LF line ends,
+    /// empty lines and a missing last line end, also in blocks of a few lines.
+    /// The sample has to encode to the checked-in blob, which encodeDictionaries
+    /// in build.gradle.kts compares its own encoding with.
+    /// @returns Whether all of them decoded right.
+    bool verify_front_coded(const std::vector<uint8_t>& buffer, int thread_count) {
+        namespace front_coded = crossword::indexing::front_coded;
+
+        auto sample = read_file(CROSSWORD_FRONT_CODED_SAMPLES "/sample.txt");
+        auto sample_blob = read_file(CROSSWORD_FRONT_CODED_SAMPLES "/sample.fcd");
+        if (sample.empty() || front_coded::encode(sample.data(), sample.size()) != sample_blob) {
+            std::printf("[verify] front_coded: the sample does not encode to sample.fcd\n");
+            return false;
+        }
+
+        const std::pair<const std::vector<uint8_t>*, uint32_t> dictionaries[] = {
+            {&buffer, front_coded::default_lines_per_block},
+            {&sample, front_coded::default_lines_per_block},
+            {&sample, 3},
+            {&sample, 1},
+        };
+
+        auto passed = true;
+        for (const auto& [text, lines_per_block] : dictionaries) {
+            // Every non-empty line, split on its own rather than by utils::for_each_line
+            std::vector<uint8_t> expected;
+            size_t line_count = 0;
+            auto line_start = expected.size();
+            for (auto byte : *text) {
+                if (byte != '\r' && byte != '\n') {
+                    expected.push_back(byte);
+                } else if (expected.size() > line_start) {
+                    expected.push_back('\n');
+                    line_start = expected.size();
+                    ++line_count;
+                }
+            }
+            if (expected.size() > line_start) {
+                expected.push_back('\n');
+                ++line_count;
+            }
+
+            auto blob = front_coded::encode(text->data(), text->size(), lines_per_block);
+            front_coded::Dictionary dictionary;
+            if (!dictionary.open(blob.data(), blob.size())) {
+                std::printf("[verify] front_coded: a blob of %u lines per block does not open\n",
+                            lines_per_block);
+                passed = false;
+                continue;
+            }
+            if (dictionary.line_count() != line_count) {
+                std::printf("[verify] front_coded: %zu lines instead of %zu\n",
+                            dictionary.line_count(), line_count);
+                passed = false;
+            }
+            for (auto threads : {1, thread_count, 64}) {
+                if (dictionary.decode(threads) != expected) {
+                    std::printf("[verify] front_coded: %zu lines, %u per block, decode on %d "
+                                "threads differs\n",
+                                line_count, lines_per_block, threads);
+                    passed = false;
+                }
+            }
+        }
+
+        std::printf("[verify] front_coded: %zu dictionaries checked\n", std::size(dictionaries));
+        return passed;
+    }
+
+    /// Looks every pattern up in every variant of the missing letters index, and compares
+    /// the results with those of a plain index loaded on a single thread.
+    /// Optimizations must not change any results.
+    /// @returns Whether all the results matched.
+    bool verify(const std::vector<uint8_t>& buffer, int thread_count) {
+        auto reference = load<MissingLettersIndex>("reference", buffer, 1);
+        Verifier verifier(*reference, missing_letters_patterns, extended_patterns,
+                          typing_sequence, cancelled_patterns);
+        verifier.check_matches("reference", buffer);
+        verifier.done("reference");
+
+        auto blob = crossword::indexing::prebuilt::serialize(
+            reference->root_node(), reference->node_arenas(), reference->words(),
+            MissingLettersIndex::alphabet_type::id);
+        PrebuiltIndex prebuilt;
+        prebuilt.load_from_buffer(blob.data(), 0, blob.size());
+        verifier.check("prebuilt", prebuilt);
+        verifier.done("prebuilt");
+        reference.reset();
+
+        verify_variants(verifier, buffer, thread_count);
+        auto passed = verify_homographs(buffer, thread_count) && verifier.passed();
+        passed = verify_anagrams(buffer, thread_count) && passed;
+        passed = verify_rhymes(buffer, thread_count) && passed;
+        passed = verify_front_coded(buffer, thread_count) && passed;
+
+        std::printf("[verify] %s\n", passed ? "passed" : "FAILED");
+        return passed;
+    }
+}
+
+/// Usage: crossword-benchmark [dictionary path] [thread count] [iterations]
+///    or: crossword-benchmark --verify [dictionary path] [thread count]
+int main(int argc, char** argv) {
+    auto verifying = argc > 1 && std::string_view(argv[1]) == "--verify";
+    if (verifying) {
+        --argc;
+        ++argv;
+    }
+
+    const char* path = argc > 1 ? argv[1] : CROSSWORD_DEFAULT_DICTIONARY;
+    int thread_count = argc > 2 ? std::atoi(argv[2])
+                                : static_cast<int>(std::thread::hardware_concurrency());
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 50;
+    thread_count = std::max(thread_count, 1);
+    iterations = std::max(iterations, 1);
+
+    auto buffer = read_file(path);
+    if (buffer.empty()) {
+        std::fprintf(stderr, "Could not read dictionary %s\n", path);
+        return 1;
+    }
+
+    std::printf("dictionary: %s (%zu bytes)\n", path, buffer.size());
+    if (verifying) {
+        return verify(buffer, thread_count) ? 0 : 1;
+    }
+
+    // Single-threaded load first, so that the parallel load can be compared against it
+    load<MissingLettersIndex>("missing_letters", buffer, 1).reset();
+    load<MissingLettersIndex>("missing_letters", buffer, thread_count).reset();
+    auto index = load<MissingLettersIndex>("missing_letters", buffer, thread_count, true);
+
+    std::printf("[missing_letters] words: %zu, nodes: %zu, chunks: %zu, node memory: %.1f MiB\n",
+                index->word_count(), index->node_count(), index->chunk_count(),
+                node_memory_mib(*index));
+    std::printf("[missing_letters] word storage: %.1f MiB, reclaimed map chunks: %.1f MiB\n",
+                to_mib(index->word_storage_bytes()), to_mib(index->reclaimed_bytes()));
+    print_memory("missing_letters", *index);
+
+    measure_lookups("missing_letters", *index, missing_letters_patterns, iterations);
+    measure_lookups("missing_letters", *index, extended_patterns, iterations);
+
+    auto serialize_start = Clock::now();
+    auto blob = crossword::indexing::prebuilt::serialize(index->root_node(), index->node_arenas(),
+                                                         index->words(),
+                                                         MissingLettersIndex::alphabet_type::id);
+    auto serialize_end = Clock::now();
+
+    PrebuiltIndex prebuilt;
+    auto attach_start = Clock::now();
+    prebuilt.load_from_buffer(blob.data(), 0, blob.size());
+    auto attach_end = Clock::now();
+
+    std::printf("[prebuilt] size: %.1f MiB, serialize: %.1f ms, attach: %.3f ms\n",
+                static_cast<double>(blob.size()) / (1024.0 * 1024.0),
+                to_ms(serialize_end - serialize_start), to_ms(attach_end - attach_start));
+    print_memory("prebuilt", prebuilt);
+    measure_lookups("prebuilt", prebuilt, missing_letters_patterns, iterations);
+    measure_lookups("prebuilt", prebuilt, extended_patterns, iterations);
+
+    // Front-coded dictionaries load like the text they decode to
+    auto decoded = measure_front_coded(buffer, thread_count, iterations);
+    load<MissingLettersIndex>("front_coded", decoded, thread_count, true).reset();
+    decoded = {};
+
+    auto parallel = [thread_count](auto& index) {
+        index.set_parallel_lookup({.thread_count = static_cast<size_t>(thread_count)});
+    };
+    transform("parallel", *index, parallel, iterations);
+    measure_cancellation("parallel", *index, cancelled_patterns, iterations);
+    index->set_parallel_lookup({});
+
+    transform("compressed", *index, [](auto& index) { index.compress(); }, iterations);
+    measure_typing("compressed", *index, false, iterations);
+    measure_typing("compressed+cache", *index, true, iterations);
+    transform("compressed+suffixes", *index, [](auto& index) { index.build_suffix_trie(); },
+              iterations);
+    print_memory("compressed+suffixes", *index);
+    transform("compressed+positional", *index,
+              [](auto& index) { index.build_positional_index(); }, iterations);
+    print_memory("compressed+positional", *index);
+
+    auto scores = synthetic_scores(buffer);
+    index->load_scores(scores.data(), scores.size());
+    measure_best("compressed+scores", *index, missing_letters_patterns, iterations);
+    measure_best("compressed+scores", *index, extended_patterns, iterations);
+    index.reset();
+
+    index = load<MissingLettersIndex>("missing_letters", buffer, thread_count, true);
+    transform("minimized", *index, [](auto& index) { index.minimize(); }, iterations);
+    transform("minimized+compressed", *index, [](auto& index) { index.compress(); },
+              iterations);
+    // Nodes of a minimized trie cannot hold the scores of their paths, so nothing gets skipped
+    index->load_scores(scores.data(), scores.size());
+    measure_best("minimized+scores", *index, missing_letters_patterns, iterations);
+    index.reset();
+
+    auto anagrams = load<AnagramIndex>("anagrams", buffer, thread_count);
+    print_memory("anagrams", *anagrams);
+    measure_lookups("anagrams", *anagrams, anagram_queries, iterations);
+    anagrams.reset();
+
+    auto rhymes = load<RhymeIndex>("rhymes", buffer, thread_count);
+    rhymes->compress();
+    print_memory("rhymes", *rhymes);
+    measure_lookups("rhymes", *rhymes, rhyme_queries, iterations);
+
+    std::printf("peak rss: %.1f MiB\n", static_cast<double>(peak_rss_kib()) / 1024.0);
+    return 0;
+}
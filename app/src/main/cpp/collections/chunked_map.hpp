@@ -27,23 +27,25 @@ namespace crossword::collections {
     template <typename K, typename V>
     class ChunkedMapIterator {
     protected:
-        ChunkedMap<K, V>* map;
+        const MapChunk<K, V>* chunks;
         int16_t index;
+        int16_t size;
 
     public:
         using iterator_category = std::random_access_iterator_tag;
         using difference_type = int16_t;
 
-        ChunkedMapIterator(ChunkedMap<K, V>* map, int16_t index) : map(map), index(index) {}
+        ChunkedMapIterator(const MapChunk<K, V>* chunks, int16_t index, int16_t size) :
+            chunks(chunks), index(index), size(size) {}
         ChunkedMapIterator(const ChunkedMapIterator& other) = default;
         ~ChunkedMapIterator() {}
 
         operator bool() const {
-            return index >= 0 && index < map->size;
+            return index >= 0 && index < size;
         }
 
         bool operator==(const ChunkedMapIterator& other) const {
-            return map == other.map && index == other.index;
+            return chunks == other.chunks && index == other.index;
         }
 
         ChunkedMapIterator& operator+=(const difference_type& delta) {
@@ -97,7 +99,7 @@ namespace crossword::collections {
         void fill_element(std::pair<K, V>* element) {
             auto chunk_index = index / 3;
             auto index_inner = index - (chunk_index * 3);
-            MapChunk<K, V>* chunk = &map->chunks[chunk_index];
+            const MapChunk<K, V>* chunk = &chunks[chunk_index];
             switch (index_inner) {
             case 0:
                 element->first = chunk->key1;
@@ -130,34 +132,76 @@ namespace crossword::collections {
     static_assert(sizeof(ChunkedMapIterator<uint8_t, void*>) == 2 * sizeof(void*),
                   "ChunkedMapIterator of char keys must be 2 pointers in size");
 
+    /// The elements of a ChunkedMap, resolved from its arena, so that they can be iterated.
+    template <typename K, typename V>
+    struct ChunkedMapEntries {
+        const MapChunk<K, V>* chunks;
+        int16_t size;
+
+        ChunkedMapIterator<K, V> begin() const {
+            return ChunkedMapIterator<K, V>(chunks, 0, size);
+        }
+
+        ChunkedMapIterator<K, V> end() const {
+            return ChunkedMapIterator<K, V>(chunks, size, size);
+        }
+    };
+
+    /// A small map, which stores its elements in chunks of three.
+    /// @details The chunks live in an arena and the map only holds the 32-bit index
+    /// of the first one, so every operation takes the arena to resolve it.
+    /// All the chunks of a map are allocated together, so they take a single lookup.
     template <typename K, typename V>
     class ChunkedMap {
         using iterator = ChunkedMapIterator<K, V>;
+        using arena_type = Arena<MapChunk<K, V>>;
 
     public:
-        /// Map of chunks in this map.
-        MapChunk<K, V>* chunks;
+        /// Arena index of the first chunk of this map.
+        memory::ArenaIndex chunks;
         /// How many chunks are currently allocated?
         int16_t allocated_chunks;
         /// How many elements are currently in this map?
         int16_t size;
 
     private:
-        /// Resizes this map by one chunk.
-        /// This reallocates the chunks, making the pointers to them invalid.
-        void resize_by_one(Arena<MapChunk<K, V>>* arena) {
-            auto new_chunks = arena->alloc(allocated_chunks + 1);
+        /// Resolves the chunks of this map.
+        inline MapChunk<K, V>* chunks_in(const arena_type* arena) const noexcept {
+            return allocated_chunks > 0 ? arena->at(chunks) : nullptr;
+        }
+
+        /// Resizes this map to the provided number of chunks.
+        /// This reallocates the chunks, making the indices of them invalid.
+        /// The old chunks are released to the arena, so that another map can grow into them.
+        void resize(int16_t chunk_count, arena_type* arena) {
+            auto new_index = arena->alloc_index(chunk_count);
+            auto new_chunks = arena->at(new_index);
+            int16_t copied = 0;
             if (allocated_chunks > 0) {
-                for (auto i = 0; i < allocated_chunks; ++i) {
-                    new_chunks[i] = chunks[i];
+                auto old_chunks = chunks_in(arena);
+                for (; copied < std::min(allocated_chunks, chunk_count); ++copied) {
+                    new_chunks[copied] = old_chunks[copied];
                 }
+                arena->release_index(chunks, allocated_chunks);
+            }
+
+            // Reused chunks hold stale elements, keep the free slots as clean as new ones
+            for (auto i = copied; i < chunk_count; ++i) {
+                new_chunks[i] = MapChunk<K, V>{};
             }
-            chunks = new_chunks;
-            allocated_chunks += 1;
+
+            chunks = new_index;
+            allocated_chunks = chunk_count;
+        }
+
+        /// Resizes this map by one chunk.
+        /// This reallocates the chunks, making the indices of them invalid.
+        inline void resize_by_one(arena_type* arena) {
+            resize(allocated_chunks + 1, arena);
         }
 
     public:
-        constexpr ChunkedMap() : chunks(nullptr), allocated_chunks(0), size(0) {}
+        constexpr ChunkedMap() : chunks(arena_type::no_index), allocated_chunks(0), size(0) {}
 
         /// How many elements can be stored in the map without additional allocation?
         constexpr inline int16_t capacity() noexcept {
@@ -169,25 +213,31 @@ namespace crossword::collections {
             return size == 0;
         }
 
+        /// Resolves the elements of the map, e.g. for a range-based for loop.
+        ChunkedMapEntries<K, V> entries(const arena_type* arena) const {
+            return {chunks_in(arena), size};
+        }
+
         /// Creates an iterator that points to the first pair of the map.
         /// If the map is empty, equals to end().
-        iterator begin() {
-            return iterator(this, 0);
+        iterator begin(const arena_type* arena) const {
+            return entries(arena).begin();
         }
 
         /// Creates an iterator that points to an invalid element
         /// after the last element of the map.
-        iterator end() {
-            return iterator(this, size);
+        iterator end(const arena_type* arena) const {
+            return entries(arena).end();
         }
 
         /// Tries to find provided key, using linear search.
-        inline iterator find_chunk_linear(K key) {
+        inline iterator find_chunk_linear(K key, const arena_type* arena) const {
+            auto map_chunks = chunks_in(arena);
             int16_t chunk_index = 0;
             int16_t index_inner = 0;
 
             while (chunk_index < allocated_chunks) {
-                auto chunk = &chunks[chunk_index];
+                auto chunk = &map_chunks[chunk_index];
                 if (chunk->key1 == key) {
                     index_inner = 0;
                     break;
@@ -201,33 +251,33 @@ namespace crossword::collections {
                 ++chunk_index;
             }
 
-            return iterator(this,
-                            std::min(static_cast<int16_t>(chunk_index * 3 + index_inner), size));
+            auto index = std::min(static_cast<int16_t>(chunk_index * 3 + index_inner), size);
+            return iterator(map_chunks, index, size);
         }
 
         /// Tries to find a provided key in the map.
-        iterator find(K key) {
-            return find_chunk_linear(key);
+        iterator find(K key, const arena_type* arena) const {
+            return find_chunk_linear(key, arena);
         }
 
-        struct InsertResult {
-            std::pair<K, V> entry;
-            bool inserted;
-        };
-
-        InsertResult find_or_insert(K key, V value, Arena<MapChunk<K, V>>* arena) {
-            auto it = find(key);
-            if (it != end()) {
-                return {it.get_element(), false};
+        /// Makes sure that n elements can be stored in the map without additional allocation.
+        void reserve(int16_t n, arena_type* arena) {
+            if (n > capacity()) {
+                resize(static_cast<int16_t>((n + 2) / 3), arena);
             }
+        }
 
-            if (size == capacity()) {
-                resize_by_one(arena);
-            }
+        /// Returns the element stored at the provided position.
+        inline std::pair<K, V> entry_at(int16_t index, const arena_type* arena) const {
+            return iterator(chunks_in(arena), index, size).get_element();
+        }
 
-            auto chunk_index = size / 3;
-            auto index_inner = size - (chunk_index * 3);
-            auto chunk = &chunks[chunk_index];
+        /// Overwrites the element stored at the provided position.
+        /// The position must be lower than the capacity of the map.
+        void assign_at(int16_t index, K key, V value, arena_type* arena) {
+            auto chunk_index = index / 3;
+            auto index_inner = index - (chunk_index * 3);
+            auto chunk = &chunks_in(arena)[chunk_index];
             switch (index_inner) {
             case 0:
                 chunk->key1 = key;
@@ -244,14 +294,88 @@ namespace crossword::collections {
             default:
                 break;
             }
+        }
 
+        /// Sorts the elements of the map by their keys, in place.
+        /// Maps are small, so insertion sort is good enough.
+        void sort_by_key(arena_type* arena) {
+            for (int16_t i = 1; i < size; ++i) {
+                auto entry = entry_at(i, arena);
+                auto j = i;
+                while (j > 0) {
+                    auto previous = entry_at(j - 1, arena);
+                    if (previous.first <= entry.first) {
+                        break;
+                    }
+                    assign_at(j, previous.first, previous.second, arena);
+                    --j;
+                }
+                assign_at(j, entry.first, entry.second, arena);
+            }
+        }
+
+        struct InsertResult {
+            std::pair<K, V> entry;
+            bool inserted;
+        };
+
+        InsertResult find_or_insert(K key, V value, arena_type* arena) {
+            auto it = find(key, arena);
+            if (it != end(arena)) {
+                return {it.get_element(), false};
+            }
+
+            if (size == capacity()) {
+                resize_by_one(arena);
+            }
+
+            assign_at(size, key, value, arena);
+            size++;
+            return {entry_at(size - 1, arena), true};
+        }
+
+        /// Like find_or_insert, but keeps the elements sorted by their keys,
+        /// assuming they have been sorted before.
+        InsertResult find_or_insert_sorted(K key, V value, arena_type* arena) {
+            auto it = find(key, arena);
+            if (it != end(arena)) {
+                return {it.get_element(), false};
+            }
+
+            if (size == capacity()) {
+                resize_by_one(arena);
+            }
+
+            // Shift the greater elements to make room for the new one
+            auto index = size;
+            while (index > 0) {
+                auto previous = entry_at(index - 1, arena);
+                if (previous.first < key) {
+                    break;
+                }
+                assign_at(index, previous.first, previous.second, arena);
+                --index;
+            }
+
+            assign_at(index, key, value, arena);
             size++;
-            return {it.get_element(), true};
+            return {entry_at(index, arena), true};
+        }
+
+        /// Shifts the index of the chunks after their arena has been merged into another one
+        /// (see Arena::merge_shift).
+        void relocate(memory::ArenaIndex shift) noexcept {
+            if (allocated_chunks > 0) {
+                chunks += shift;
+            }
         }
     };
 
-    static_assert(sizeof(ChunkedMap<uint8_t, void*>) <= 2 * sizeof(void*),
-                  "ChunkedMap must not be larger than 2 pointers in size");
+    static_assert(sizeof(MapChunk<uint8_t, memory::ArenaIndex>) == 16,
+                  "MapChunk of char keys and arena indices must be 16 bytes in size");
+
+    static_assert(sizeof(ChunkedMap<uint8_t, memory::ArenaIndex>) == 8,
+                  "ChunkedMap must be 8 bytes in size");
 }
 
 #endif // CROSSWORD_HELPER_CHUNKED_MAP_HPP
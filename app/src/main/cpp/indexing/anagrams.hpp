@@ -1,18 +1,168 @@
 #ifndef CROSSWORD_HELPER_ANAGRAMS_HPP
 #define CROSSWORD_HELPER_ANAGRAMS_HPP
 
-#include "../utils/android.hpp"
+#include "../memory/arena.hpp"
+#include "../utils/lines.hpp"
+#include "../utils/log.hpp"
+#include "../utils/utf8.hpp"
 #include "word_index.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 namespace crossword::indexing {
 
+    using ::crossword::memory::Arena;
+
     /// The anagram index stores words in a way
     /// that allows for fast lookup of word anagrams.
+    /// @details Every word is keyed by its signature: case-folded codepoints sorted in ascending
+    /// order. Words sharing a signature are anagrams of each other and form a posting list.
     class AnagramIndex final : public WordIndex {
+    private:
+        /// A single word in a posting list.
+        struct Posting {
+            /// View of the word in the loaded buffer, which has to outlive the index.
+            std::u8string_view word;
+            Posting* next;
+        };
+
+        /// A slot in the signature table.
+        /// An empty slot has a null signature.
+        struct Bucket {
+            uint64_t hash;
+            std::u8string* signature;
+            Posting* head;
+            Posting* tail;
+        };
+
+        const size_t min_capacity = 1024;
+
+        /// Open addressing table of posting lists. Its capacity is always a power of two.
+        std::vector<Bucket> buckets;
+        size_t bucket_count;
+
+        std::unique_ptr<Arena<Posting>> arena_posting;
+        std::unique_ptr<Arena<std::u8string, false>> arena_string;
+
+        /// Calculates a signature of the word.
+        /// Anagrams (ignoring letter case) always have the same signature.
+        static std::u8string signature_of(std::u8string_view word) {
+            std::u32string codepoints;
+            codepoints.reserve(word.length());
+
+            auto it = word.data();
+            auto end = it + word.length();
+            while (it < end) {
+                codepoints.push_back(utils::fold_case(utils::decode_codepoint(it, end)));
+            }
+
+            std::sort(codepoints.begin(), codepoints.end());
+
+            std::u8string signature;
+            signature.reserve(word.length());
+            for (auto cp : codepoints) {
+                utils::append_codepoint(signature, cp);
+            }
+
+            return signature;
+        }
+
+        /// 64-bit FNV-1a hash of the signature.
+        static uint64_t hash_of(const std::u8string& signature) noexcept {
+            uint64_t hash = 14695981039346656037ull;
+            for (auto byte : signature) {
+                hash ^= static_cast<uint8_t>(byte);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        /// Finds the slot holding the signature,
+        /// or the empty slot where that signature should be inserted.
+        const Bucket* probe(uint64_t hash, const std::u8string& signature) const noexcept {
+            auto mask = buckets.size() - 1;
+            auto slot = static_cast<size_t>(hash) & mask;
+            while (true) {
+                auto bucket = &buckets[slot];
+                if (bucket->signature == nullptr) {
+                    return bucket;
+                }
+                if (bucket->hash == hash && *bucket->signature == signature) {
+                    return bucket;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+
+        inline Bucket* probe(uint64_t hash, const std::u8string& signature) noexcept {
+            const auto* self = this;
+            return const_cast<Bucket*>(self->probe(hash, signature));
+        }
+
+        /// Doubles the capacity of the table.
+        /// Signature hashes are cached, so no word is hashed again.
+        void grow() {
+            auto old_buckets = std::move(buckets);
+            buckets = std::vector<Bucket>(old_buckets.size() * 2, Bucket{});
+
+            auto mask = buckets.size() - 1;
+            for (const auto& bucket : old_buckets) {
+                if (bucket.signature == nullptr) {
+                    continue;
+                }
+
+                auto slot = static_cast<size_t>(bucket.hash) & mask;
+                while (buckets[slot].signature != nullptr) {
+                    slot = (slot + 1) & mask;
+                }
+                buckets[slot] = bucket;
+            }
+        }
+
+        /// Finds a slot for the signature, claiming a new one if needed.
+        Bucket* find_or_insert(uint64_t hash, const std::u8string& signature) {
+            // Keep the load factor at or below 1/2, so that probe sequences stay short
+            if ((bucket_count + 1) * 2 > buckets.size()) [[unlikely]] {
+                grow();
+            }
+
+            auto bucket = probe(hash, signature);
+            if (bucket->signature == nullptr) {
+                auto signature_ptr = arena_string->alloc();
+                *signature_ptr = signature;
+                *bucket = {hash, signature_ptr, nullptr, nullptr};
+                ++bucket_count;
+            }
+
+            return bucket;
+        }
+
+        /// Adds the word to the index.
+        void add(std::u8string_view word) {
+            auto signature = signature_of(word);
+            auto bucket = find_or_insert(hash_of(signature), signature);
+
+            auto posting = arena_posting->alloc();
+            *posting = {word, nullptr};
+            if (bucket->tail == nullptr) {
+                bucket->head = posting;
+            } else {
+                bucket->tail->next = posting;
+            }
+            bucket->tail = posting;
+        }
+
     public:
-        AnagramIndex() = default;
+        AnagramIndex() :
+            buckets(min_capacity, Bucket{}),
+            bucket_count(0),
+            arena_posting(std::make_unique<Arena<Posting>>()),
+            arena_string(std::make_unique<Arena<std::u8string, false>>()) {}
+
         ~AnagramIndex() = default;
 
         /// Tries to merge this index with another index.
@@ -26,7 +176,38 @@ namespace crossword::indexing {
                 return false;
             }
 
-            // TODO: implement
+            if (bucket_count == 0) {
+                // Nothing to splice into? Take over the other table as a whole
+                buckets.swap(other_index->buckets);
+                bucket_count = other_index->bucket_count;
+            } else {
+                // Posting lists of the same signature get spliced together,
+                // so the cost depends on the number of signatures, not on the number of words
+                for (const auto& other_bucket : other_index->buckets) {
+                    if (other_bucket.signature == nullptr) {
+                        continue;
+                    }
+
+                    if ((bucket_count + 1) * 2 > buckets.size()) [[unlikely]] {
+                        grow();
+                    }
+
+                    auto bucket = probe(other_bucket.hash, *other_bucket.signature);
+                    if (bucket->signature == nullptr) {
+                        *bucket = other_bucket;
+                        ++bucket_count;
+                    } else {
+                        bucket->tail->next = other_bucket.head;
+                        bucket->tail = other_bucket.tail;
+                    }
+                }
+            }
+
+            arena_posting->merge(other_index->arena_posting.get());
+            arena_string->merge(other_index->arena_string.get());
+
+            other_index->buckets.clear();
+            other_index->bucket_count = 0;
 
             return true;
         }
@@ -37,16 +218,95 @@ namespace crossword::indexing {
         /// @param max_results Maximum number of results to return.
         virtual std::vector<std::u8string> lookup(const std::u8string& input,
                                                   const size_t max_results) const override {
-            return {u8"TODO"};
+            std::vector<std::u8string> results;
+            if (input.empty()) {
+                return results;
+            }
+
+            auto signature = signature_of(input);
+            auto bucket = probe(hash_of(signature), signature);
+            for (auto posting = bucket->head; posting != nullptr; posting = posting->next) {
+                if (results.size() >= max_results) {
+                    break;
+                }
+                results.emplace_back(posting->word);
+            }
+
+            return results;
+        }
+
+        /// Returns a page of anagrams of the given word.
+        /// Posting lists are short, so the cursor is just the number of anagrams already seen.
+        /// For the same reason, pages take too little time to be worth cancelling.
+        virtual LookupPage
+        lookup_page(const std::u8string& input,
+                    const size_t max_results,
+                    const std::vector<uint8_t>& cursor,
+                    [[maybe_unused]] const utils::CancellationToken* cancellation = nullptr)
+            const override {
+            LookupPage page;
+            if (input.empty()) {
+                return page;
+            }
+
+            uint32_t skipped = 0;
+            if (cursor.size() == sizeof(skipped)) {
+                std::memcpy(&skipped, cursor.data(), sizeof(skipped));
+            }
+
+            auto signature = signature_of(input);
+            auto bucket = probe(hash_of(signature), signature);
+            auto posting = bucket->head;
+            for (uint32_t i = 0; i < skipped && posting != nullptr; ++i) {
+                posting = posting->next;
+            }
+
+            for (; posting != nullptr; posting = posting->next) {
+                if (page.words.size() >= max_results) {
+                    auto seen = static_cast<uint32_t>(skipped + page.words.size());
+                    page.cursor.resize(sizeof(seen));
+                    std::memcpy(page.cursor.data(), &seen, sizeof(seen));
+                    break;
+                }
+                page.words.push_back(posting->word);
+            }
+
+            return page;
+        }
+
+        /// Reports how much memory this index takes and what takes it.
+        /// The index has no trie, so only the words are counted.
+        virtual MemoryStats memory_stats() const override {
+            MemoryStats stats;
+            stats.arenas.push_back({"postings", arena_posting->stats()});
+            stats.arenas.push_back({"signatures", arena_string->stats()});
+            stats.other_bytes = buckets.capacity() * sizeof(Bucket);
+
+            // Signatures too long for the small string buffer live on the heap
+            auto inline_capacity = std::u8string().capacity();
+            for (const auto& bucket : buckets) {
+                if (bucket.signature != nullptr
+                    && bucket.signature->capacity() > inline_capacity) {
+                    stats.other_bytes += bucket.signature->capacity() + 1;
+                }
+            }
+
+            stats.word_count = stats.arenas[0].stats.used_bytes / sizeof(Posting);
+            return stats;
         }
 
         /// Parses lines from a UTF-8 encoded buffer and adds them to the index.
+        /// The words are not copied, so the buffer has to outlive the index (see retain).
         /// @param buffer Pointer to the data buffer.
         /// @param start Index to start searching from.
         /// @param end Exclusive end index of buffer parsing.
         virtual void
         load_from_buffer(const uint8_t* buffer, const size_t start, const size_t end) override {
-            // TODO: implement
+            utils::log::tag("load_from_buffer").i("Parsing %zu bytes", end - start);
+
+            utils::for_each_line(buffer, start, end, [this](const uint8_t* line, size_t length) {
+                add(std::u8string_view(reinterpret_cast<const char8_t*>(line), length));
+            });
         }
 
         virtual void load_from_buffer_parallel(const uint8_t* buffer,
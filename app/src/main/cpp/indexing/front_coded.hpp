@@ -0,0 +1,362 @@
+#ifndef CROSSWORD_HELPER_FRONT_CODED_HPP
+#define CROSSWORD_HELPER_FRONT_CODED_HPP
+
+#include "../memory/string_pool.hpp"
+#include "../utils/lines.hpp"
+#include "../utils/log.hpp"
+#include "../utils/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace crossword::indexing {
+
+    /// Layout of a front-coded dictionary: the lines of a plain text dictionary,
+    /// each stored as the length of the prefix it shares with the previous line,
+    /// followed by the rest of its bytes.
+    /// @details Dictionaries are mostly sorted, so neighbouring words share most of their
+    /// bytes and the blob takes several times less than the text. The lines are split into
+    /// blocks of a fixed number of lines. The first line of a block shares nothing, so every
+    /// block can be decoded on its own. A directory records where every block starts, both
+    /// in the blob and in the decoded text, so blocks get decoded in parallel, each straight
+    /// to its place in a single text buffer, which loads like the plain text dictionary.
+    /// Each line starts with a single byte holding both lengths, the shared one in the upper
+    /// nibble. If either does not fit a nibble, the upper nibble is escape_nibble instead,
+    /// and the lengths follow in two more bytes.
+    namespace front_coded {
+
+        static_assert(std::endian::native == std::endian::little,
+                      "Front-coded dictionaries are stored in little endian byte order");
+
+        constexpr char magic[4] = {'X', 'W', 'D', 'F'};
+        constexpr uint32_t version = 1;
+
+        /// Marks a line whose lengths are stored in the bytes after its first one.
+        constexpr uint8_t escape_nibble = 0xF;
+
+        /// How many lines does a block hold by default?
+        /// Every block restarts the shared prefixes, so bigger blocks compress better,
+        /// but split the dictionary into fewer pieces to decode in parallel.
+        constexpr uint32_t default_lines_per_block = 128;
+
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint32_t line_count;
+            uint32_t block_count;
+            /// Number of lines of every block except for the last one.
+            uint32_t lines_per_block;
+            /// Offset of the block directory, Block[block_count + 1].
+            uint32_t blocks_offset;
+            /// Offset of the encoded lines.
+            uint32_t data_offset;
+            uint32_t data_size;
+            /// Size of the decoded text, one LF after every line.
+            uint32_t text_size;
+            /// Total size of the blob, in bytes.
+            uint32_t total_size;
+        };
+
+        /// Where a block starts. The directory has one extra sentinel entry,
+        /// which marks the ends of the data and of the text.
+        struct Block {
+            /// Offset of the first line of the block, relative to the data.
+            uint32_t data_offset;
+            /// Offset the block decodes to, in the decoded text.
+            uint32_t text_offset;
+        };
+
+        static_assert(sizeof(Header) == 40, "Front-coded header must be 40 bytes in size");
+        static_assert(sizeof(Block) == 8, "Front-coded block must be 8 bytes in size");
+
+        /// Checks whether the buffer starts like a front-coded dictionary,
+        /// as opposed to a plain text one.
+        inline bool is_front_coded(const uint8_t* buffer, size_t length) noexcept {
+            return length >= sizeof(Header) && std::memcmp(buffer, magic, sizeof(magic)) == 0;
+        }
+
+        /// Encodes the lines of a plain text dictionary, in their order.
+        /// Empty lines are skipped, as they are by the text loaders.
+        /// @param lines_per_block Number of lines of every block, at least one.
+        /// @returns The encoded blob, or an empty vector if a line is too long to be stored
+        /// in an index (see memory::StringPool::max_length) or the text is too big.
+        inline std::vector<uint8_t> encode(const uint8_t* text,
+                                           size_t length,
+                                           uint32_t lines_per_block = default_lines_per_block) {
+            auto logger = utils::log::tag("front_coded");
+            lines_per_block = std::max<uint32_t>(lines_per_block, 1);
+
+            std::vector<uint8_t> data;
+            std::vector<Block> blocks;
+            size_t line_count = 0;
+            size_t text_size = 0;
+            const uint8_t* previous = nullptr;
+            size_t previous_length = 0;
+            auto too_long = false;
+
+            utils::for_each_line(text, 0, length, [&](const uint8_t* line, size_t line_length) {
+                if (line_length > memory::StringPool::max_length) {
+                    too_long = true;
+                    return;
+                }
+
+                if (line_count % lines_per_block == 0) {
+                    blocks.push_back({static_cast<uint32_t>(data.size()),
+                                      static_cast<uint32_t>(text_size)});
+                    previous_length = 0;
+                }
+
+                size_t shared = 0;
+                auto max_shared = std::min(line_length, previous_length);
+                while (shared < max_shared && line[shared] == previous[shared]) {
+                    ++shared;
+                }
+
+                auto suffix = line_length - shared;
+                if (shared < escape_nibble && suffix <= 0xF) {
+                    data.push_back(static_cast<uint8_t>(shared << 4 | suffix));
+                } else {
+                    data.push_back(static_cast<uint8_t>(escape_nibble << 4));
+                    data.push_back(static_cast<uint8_t>(shared));
+                    data.push_back(static_cast<uint8_t>(suffix));
+                }
+                data.insert(data.end(), line + shared, line + line_length);
+
+                previous = line;
+                previous_length = line_length;
+                ++line_count;
+                text_size += line_length + 1;
+            });
+
+            if (too_long) {
+                logger.w("Lines longer than %zu bytes cannot be encoded",
+                         memory::StringPool::max_length);
+                return {};
+            }
+
+            auto blocks_offset = sizeof(Header);
+            auto data_offset = blocks_offset + (blocks.size() + 1) * sizeof(Block);
+            auto total_size = data_offset + data.size();
+            if (total_size > UINT32_MAX || text_size > UINT32_MAX) {
+                logger.w("Dictionaries over 4 GiB cannot be encoded");
+                return {};
+            }
+            blocks.push_back({static_cast<uint32_t>(data.size()),
+                              static_cast<uint32_t>(text_size)});
+
+            Header header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.line_count = static_cast<uint32_t>(line_count);
+            header.block_count = static_cast<uint32_t>(blocks.size() - 1);
+            header.lines_per_block = lines_per_block;
+            header.blocks_offset = static_cast<uint32_t>(blocks_offset);
+            header.data_offset = static_cast<uint32_t>(data_offset);
+            header.data_size = static_cast<uint32_t>(data.size());
+            header.text_size = static_cast<uint32_t>(text_size);
+            header.total_size = static_cast<uint32_t>(total_size);
+
+            std::vector<uint8_t> blob(total_size);
+            std::memcpy(blob.data(), &header, sizeof(Header));
+            std::memcpy(blob.data() + blocks_offset, blocks.data(),
+                        blocks.size() * sizeof(Block));
+            std::copy(data.begin(), data.end(), blob.begin() + static_cast<ptrdiff_t>(data_offset));
+            return blob;
+        }
+
+        /// Reads a front-coded dictionary in place.
+        class Dictionary final {
+        private:
+            /// How many bytes do both parts of a short line get copied in?
+            /// Has to be more than what a nibble holds.
+            static constexpr size_t copy_width = 16;
+
+            const Header* header = nullptr;
+            const Block* blocks = nullptr;
+            const uint8_t* data = nullptr;
+
+        public:
+            /// Checks the header and the block directory of the blob.
+            /// The lines themselves get checked as they are decoded.
+            /// @returns False if the blob is not a valid front-coded dictionary.
+            bool open(const uint8_t* buffer, size_t length) {
+                auto logger = utils::log::tag("front_coded");
+                header = nullptr;
+
+                if (!is_front_coded(buffer, length)) {
+                    logger.w("Not a front-coded dictionary");
+                    return false;
+                }
+
+                // The blob is only guaranteed to be 4-byte aligned
+                auto candidate = reinterpret_cast<const Header*>(buffer);
+                if (candidate->version != version) {
+                    logger.w("Unsupported front-coded dictionary version %u", candidate->version);
+                    return false;
+                }
+
+                auto directory_end = size_t{candidate->blocks_offset}
+                                     + (size_t{candidate->block_count} + 1) * sizeof(Block);
+                auto lines_in_blocks = size_t{candidate->block_count}
+                                       * candidate->lines_per_block;
+                if (candidate->total_size != length || candidate->blocks_offset % 4 != 0
+                    || candidate->blocks_offset < sizeof(Header)
+                    || directory_end > candidate->data_offset
+                    || size_t{candidate->data_offset} + candidate->data_size > length
+                    || candidate->lines_per_block == 0 || candidate->line_count > lines_in_blocks
+                    || candidate->line_count + candidate->lines_per_block <= lines_in_blocks) {
+                    logger.w("Front-coded dictionary is malformed");
+                    return false;
+                }
+
+                auto directory = reinterpret_cast<const Block*>(buffer + candidate->blocks_offset);
+                for (size_t i = 0; i < candidate->block_count; ++i) {
+                    if (directory[i].data_offset > directory[i + 1].data_offset
+                        || directory[i].text_offset > directory[i + 1].text_offset) {
+                        logger.w("Front-coded dictionary blocks are out of order");
+                        return false;
+                    }
+                }
+                auto& sentinel = directory[candidate->block_count];
+                if (sentinel.data_offset != candidate->data_size
+                    || sentinel.text_offset != candidate->text_size
+                    || directory[0].data_offset != 0 || directory[0].text_offset != 0) {
+                    logger.w("Front-coded dictionary blocks do not cover the data");
+                    return false;
+                }
+
+                header = candidate;
+                blocks = directory;
+                data = buffer + candidate->data_offset;
+                return true;
+            }
+
+            /// Checks whether a valid dictionary has been opened.
+            bool valid() const noexcept {
+                return header != nullptr;
+            }
+
+            size_t line_count() const noexcept {
+                return header->line_count;
+            }
+
+            size_t block_count() const noexcept {
+                return header->block_count;
+            }
+
+            /// Size of the decoded text, in bytes.
+            size_t text_size() const noexcept {
+                return header->text_size;
+            }
+
+            /// Decodes a single block to its place in the text (see Block::text_offset).
+            /// @param text The whole decoded text, text_size() bytes long.
+            /// @returns False if the block is malformed. Its part of the text is undefined then.
+            bool decode_block(size_t block, uint8_t* text) const {
+                auto it = data + blocks[block].data_offset;
+                auto end = data + blocks[block + 1].data_offset;
+                auto data_end = data + header->data_size;
+                auto out = text + blocks[block].text_offset;
+                auto out_end = text + blocks[block + 1].text_offset;
+
+                auto first_line = block * header->lines_per_block;
+                auto lines = std::min<size_t>(header->lines_per_block,
+                                              header->line_count - first_line);
+
+                // The previous line has been written to the text already, so it is copied from.
+                // The first line of a block shares nothing, so it copies nothing from it.
+                const uint8_t* previous = out;
+                size_t previous_length = 0;
+                for (size_t line = 0; line < lines; ++line) {
+                    if (it == end) {
+                        return false;
+                    }
+                    size_t shared = *it >> 4;
+                    size_t suffix = *it & 0xF;
+                    ++it;
+                    auto short_line = shared != escape_nibble;
+                    if (!short_line) {
+                        if (end - it < 2) {
+                            return false;
+                        }
+                        shared = it[0];
+                        suffix = it[1];
+                        it += 2;
+                    }
+
+                    auto length = shared + suffix;
+                    if (shared > previous_length || static_cast<size_t>(end - it) < suffix
+                        || static_cast<size_t>(out_end - out) < length + 1) {
+                        return false;
+                    }
+
+                    // Lengths of a short line fit a nibble, so instead of copying exactly its
+                    // bytes, which takes unpredictable branches, copy fixed-size chunks and let
+                    // the suffix and the next line overwrite what is copied past them.
+                    // Only the text of this block gets written, as other threads decode the rest.
+                    if (short_line && static_cast<size_t>(out_end - out) >= 2 * copy_width
+                        && static_cast<size_t>(data_end - it) >= copy_width) [[likely]] {
+                        // The chunk of the previous line may reach this one, so read it first
+                        uint8_t chunk[copy_width];
+                        std::memcpy(chunk, previous, copy_width);
+                        std::memcpy(out, chunk, copy_width);
+                        std::memcpy(out + shared, it, copy_width);
+                    } else {
+                        // A line never overlaps the previous one, since it starts right after it
+                        std::memcpy(out, previous, shared);
+                        std::memcpy(out + shared, it, suffix);
+                    }
+                    it += suffix;
+                    previous = out;
+                    previous_length = length;
+                    out += length;
+                    *out++ = '\n';
+                }
+
+                return it == end && out == out_end;
+            }
+
+            /// Decodes all the blocks into plain text, one LF after every line.
+            /// @param parallel_factor How many threads of utils::ThreadPool to decode on.
+            /// @returns The text, or an empty vector if any of the blocks is malformed.
+            std::vector<uint8_t> decode(int parallel_factor) const {
+                constexpr size_t tasks_per_thread = 4;
+
+                std::vector<uint8_t> text(header->text_size);
+                auto task_count = std::min<size_t>(
+                    block_count(),
+                    static_cast<size_t>(std::clamp(parallel_factor, 1, 64)) * tasks_per_thread);
+                std::atomic<bool> malformed{false};
+
+                auto decode_task = [&](size_t task) {
+                    auto first = block_count() * task / task_count;
+                    auto last = block_count() * (task + 1) / task_count;
+                    for (auto block = first; block < last; ++block) {
+                        if (!decode_block(block, text.data())) {
+                            malformed.store(true, std::memory_order_relaxed);
+                            return;
+                        }
+                    }
+                };
+
+                if (task_count > 1) {
+                    utils::ThreadPool::shared().parallel_for(task_count, decode_task);
+                } else if (task_count == 1) {
+                    decode_task(0);
+                }
+
+                if (malformed.load(std::memory_order_relaxed)) {
+                    utils::log::tag("front_coded").w("Front-coded dictionary block is malformed");
+                    return {};
+                }
+                return text;
+            }
+        };
+    }
+}
+
+#endif // CROSSWORD_HELPER_FRONT_CODED_HPP
@@ -0,0 +1,197 @@
+#ifndef CROSSWORD_HELPER_HOMOGRAPHS_HPP
+#define CROSSWORD_HELPER_HOMOGRAPHS_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/utf8.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::locale::Symbol;
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
+
+    /// Words that differ only in letters outside of the alphabet, e.g. xβz and xγz.
+    /// All such letters share a symbol (see locale::unknown), so these words share a trie node,
+    /// which holds just the last of them.
+    /// @details Every word with a letter outside of the alphabet gets recorded here, so that
+    /// the words sharing its node can be told apart. Lookups replace a word of such a node
+    /// with all of them (see expand). Dictionaries of the supported locales have none,
+    /// and then the only cost is the check of empty.
+    /// @tparam Alphabet The locale::Alphabet the words are keyed by.
+    template <typename Alphabet>
+    class Homographs final {
+    private:
+        struct Entry {
+            std::vector<Symbol> symbols;
+            StringHandle word;
+        };
+
+        /// Recorded words, sorted by their symbols, then by their case-folded letters.
+        std::vector<Entry> entries;
+        /// Number of the recorded words which share their symbols with an earlier entry.
+        size_t shared = 0;
+
+        /// Compares the case-folded letters of two words.
+        static int compare_letters(std::u8string_view a, std::u8string_view b) {
+            auto a_it = a.data();
+            auto a_end = a_it + a.length();
+            auto b_it = b.data();
+            auto b_end = b_it + b.length();
+
+            while (a_it < a_end && b_it < b_end) {
+                auto a_letter = utils::fold_case(utils::decode_codepoint(a_it, a_end));
+                auto b_letter = utils::fold_case(utils::decode_codepoint(b_it, b_end));
+                if (a_letter != b_letter) {
+                    return a_letter < b_letter ? -1 : 1;
+                }
+            }
+
+            return (a_it < a_end) - (b_it < b_end);
+        }
+
+        /// Finds the entries of the words spelled with the given symbols.
+        template <typename Entries>
+        static auto group_of(Entries& entries, const std::vector<Symbol>& symbols) {
+            return std::equal_range(entries.begin(), entries.end(), symbols,
+                                    [](const auto& a, const auto& b) {
+                                        return symbols_of(a) < symbols_of(b);
+                                    });
+        }
+
+        static const std::vector<Symbol>& symbols_of(const Entry& entry) noexcept {
+            return entry.symbols;
+        }
+
+        static const std::vector<Symbol>& symbols_of(const std::vector<Symbol>& symbols) noexcept {
+            return symbols;
+        }
+
+    public:
+        /// Records a word with letters outside of the alphabet.
+        /// A recorded word spelled with the same letters gets replaced, like in the trie.
+        /// @param symbols Symbols of the word, see Alphabet::encode_word.
+        void add(StringHandle word, const std::vector<Symbol>& symbols, const StringPool& pool) {
+            auto spelling = pool.get(word);
+            auto [first, last] = group_of(entries, symbols);
+            auto it = first;
+            while (it != last && compare_letters(pool.get(it->word), spelling) < 0) {
+                ++it;
+            }
+
+            if (it != last && compare_letters(pool.get(it->word), spelling) == 0) {
+                it->word = word;
+                return;
+            }
+
+            shared += first != last;
+            entries.insert(it, Entry{symbols, word});
+        }
+
+        /// Records the words of another index, added after the words of this one.
+        /// @param shift How much the handles of the other index moved (see StringPool::append).
+        void append(const Homographs& other, size_t shift, const StringPool& pool) {
+            for (const auto& entry : other.entries) {
+                add(static_cast<StringHandle>(entry.word + shift), entry.symbols, pool);
+            }
+        }
+
+        void clear() noexcept {
+            entries.clear();
+            entries.shrink_to_fit();
+            shared = 0;
+        }
+
+        /// Checks whether no two words share their symbols.
+        bool empty() const noexcept {
+            return shared == 0;
+        }
+
+        /// Number of the words no trie node holds, since another word took their node.
+        size_t hidden_count() const noexcept {
+            return shared;
+        }
+
+        size_t size_bytes() const noexcept {
+            auto size = entries.capacity() * sizeof(Entry);
+            for (const auto& entry : entries) {
+                size += entry.symbols.capacity();
+            }
+            return size;
+        }
+
+        /// Replaces every word of lookup results which shares its symbols with other words
+        /// by all of those words, ordered by their case-folded letters.
+        /// Each of them shares the node of the replaced word, so it matches the same patterns
+        /// as far as the symbols go.
+        void expand(std::vector<std::u8string_view>& results, const StringPool& pool) const {
+            if (empty()) [[likely]] {
+                return;
+            }
+
+            std::vector<std::u8string_view> expanded;
+            std::vector<Symbol> symbols;
+            expanded.reserve(results.size());
+            for (auto word : results) {
+                if (Alphabet::encode_word(word, symbols)) {
+                    expanded.push_back(word);
+                    continue;
+                }
+
+                auto [first, last] = group_of(entries, symbols);
+                if (first == last) {
+                    expanded.push_back(word);
+                    continue;
+                }
+                for (auto it = first; it != last; ++it) {
+                    expanded.push_back(pool.get(it->word));
+                }
+            }
+            results = std::move(expanded);
+        }
+
+        /// Finds the handle of a recorded word, spelled in any case.
+        /// @returns StringPool::no_string if the word has not been recorded.
+        StringHandle find(std::u8string_view word, const StringPool& pool) const {
+            std::vector<Symbol> symbols;
+            Alphabet::encode_word(word, symbols);
+            auto [first, last] = group_of(entries, symbols);
+            for (auto it = first; it != last; ++it) {
+                if (compare_letters(pool.get(it->word), word) == 0) {
+                    return it->word;
+                }
+            }
+            return StringPool::no_string;
+        }
+
+        /// Copies a word held by a trie node into another pool, along with the words
+        /// sharing its node, so that they all get consecutive handles in the order
+        /// the lookups return them in. The recorded handles get moved to the copies.
+        /// @returns Handle of the copy of the word.
+        StringHandle copy(StringHandle word, const StringPool& from, StringPool& to) {
+            auto spelling = from.get(word);
+            std::vector<Symbol> symbols;
+            if (Alphabet::encode_word(spelling, symbols)) {
+                return to.add(spelling);
+            }
+
+            auto [first, last] = group_of(entries, symbols);
+            auto copied = StringPool::no_string;
+            for (auto it = first; it != last; ++it) {
+                auto handle = to.add(from.get(it->word));
+                if (it->word == word) {
+                    copied = handle;
+                }
+                it->word = handle;
+            }
+            return copied != StringPool::no_string ? copied : to.add(spelling);
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_HOMOGRAPHS_HPP
@@ -1,13 +1,26 @@
 #ifndef CROSSWORD_HELPER_MISSING_LETTERS_HPP
 #define CROSSWORD_HELPER_MISSING_LETTERS_HPP
 
+#include "../locale/alphabet.hpp"
 #include "../memory/arena.hpp"
-#include "../utils/android.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/lines.hpp"
+#include "../utils/log.hpp"
 #include "../utils/utf8.hpp"
 #include "../word_node.hpp"
+#include "trie_compressor.hpp"
+#include "trie_minimizer.hpp"
+#include "homographs.hpp"
+#include "parallel_lookup.hpp"
+#include "pattern.hpp"
+#include "positional_index.hpp"
+#include "query_cache.hpp"
+#include "suffix_trie.hpp"
 #include "word_index.hpp"
+#include "word_scores.hpp"
 
 #include <algorithm>
+#include <charconv>
 #include <iterator>
 #include <thread>
 
@@ -15,32 +28,473 @@ namespace crossword::indexing {
 
     using namespace ::crossword::collections;
     using namespace ::crossword::utils;
+    using ::crossword::locale::Symbol;
     using ::crossword::memory::Arena;
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
 
     /// The 'missing letters' index stores words in a way
     /// that enables fast lookup of words that have some of the letters missing.
-    class MissingLettersIndex final : public WordIndex {
+    /// @tparam Alphabet The locale::Alphabet the words are keyed by.
+    template <typename Alphabet>
+    class BasicMissingLettersIndex final : public WordIndex {
+    public:
+        using alphabet_type = Alphabet;
+        using pattern_type = CompiledPattern<Alphabet>;
+
     private:
         std::unique_ptr<WordNode> root;
-        std::unique_ptr<Arena<WordNode>> arena_node;
-        std::unique_ptr<Arena<MapChunk<uint8_t, WordNode*>>> arena_map_chunk;
-        std::unique_ptr<Arena<std::u8string, false>> arena_string;
+        /// Arenas of all the nodes (except for the root) and their child maps.
+        std::unique_ptr<TrieArenas> arenas;
+        /// Copies of the words, referred to by the trie nodes.
+        StringPool string_pool;
+
+        /// Words of a minimized trie, ordered by their ordinals.
+        /// Empty until the index gets minimized.
+        std::vector<StringHandle> words_by_ordinal;
+        bool is_minimized;
+        bool is_compressed;
+        /// Whether the words are stored in collation order (see rank_words).
+        bool is_ranked;
+        /// Node and chunk counts of a minimized or compressed trie.
+        /// Nodes of a minimized trie are shared, so they cannot be counted by a traversal.
+        size_t frozen_node_count;
+        size_t frozen_chunk_count;
+
+        /// How lookups get split between threads.
+        ParallelLookupOptions parallel_lookup;
+
+        /// Trie of the words spelled backwards, for patterns ending in known letters.
+        /// Null until built, and dropped whenever more words are added.
+        std::unique_ptr<SuffixTrie<Alphabet>> suffixes;
+
+        /// Sets of words by their letters at every position, for patterns starting
+        /// with a wildcard. Null until built, and dropped whenever more words are added.
+        std::unique_ptr<PositionalIndex<Alphabet>> positions;
+
+        /// Complete results of recent lookups, see enable_query_cache. Null unless enabled.
+        std::unique_ptr<QueryCache> cache;
+
+        /// Scores of the words for lookup_best, see load_scores. Empty unless loaded,
+        /// and cleared whenever more words are added.
+        WordScores scores;
+
+        /// Words sharing a trie node, since they differ only in letters outside of the alphabet.
+        Homographs<Alphabet> homographs;
+
+        /// Reused between words to avoid allocating symbol storage every time.
+        std::vector<Symbol> word_symbols;
 
         /// Adds the word to the index.
-        /// @details It is assumed that the word pointer belongs to this indexes' arena_string.
-        inline void add(std::u8string* word_ptr) {
-            root->push_word(word_ptr, 0, arena_node.get(), arena_map_chunk.get());
+        /// @details It is assumed that the handle belongs to this indexes' string_pool.
+        inline void add(StringHandle handle, std::u8string_view word) {
+            auto all_known = Alphabet::encode_word(word, word_symbols);
+            root->push_word(handle, word_symbols, 0, arenas.get());
+            if (!all_known) [[unlikely]] {
+                homographs.add(handle, word_symbols, string_pool);
+            }
+        }
+
+        /// Finds the handle of a word stored in the index, spelled in any case,
+        /// like lookups find it (e.g. abakan finds Abakan).
+        /// @returns StringPool::no_string if the index does not hold the word.
+        StringHandle find_handle(std::u8string_view word) {
+            struct {
+                StringHandle handle = StringPool::no_string;
+
+                bool full() const noexcept {
+                    return handle != StringPool::no_string;
+                }
+
+                void push(StringHandle word) {
+                    handle = word;
+                }
+
+                bool descend(WordNode*, size_t, uint32_t, const Symbol*) const noexcept {
+                    return true;
+                }
+            } found;
+
+            auto all_known = Alphabet::encode_word(word, word_symbols);
+            if (minimized()) {
+                root->search<true>(found, *arenas, word_symbols, 0, 0, words_by_ordinal.data(),
+                                   nullptr);
+            } else {
+                root->search<false>(found, *arenas, word_symbols, 0, 0, nullptr, nullptr);
+            }
+
+            // All the letters outside of the alphabet share a symbol, so compare those letters
+            if (found.handle == StringPool::no_string || all_known) [[likely]] {
+                return found.handle;
+            }
+            return homographs.find(word, string_pool);
+        }
+
+        /// Maps a symbol to a digit of a shard key. Unknown symbols go after all the letters.
+        static constexpr size_t shard_digit(Symbol symbol) noexcept {
+            return std::min<size_t>(symbol, Alphabet::size + 1);
+        }
+
+        /// Counts the known symbols a pattern starts with.
+        template <typename It>
+        static size_t known_symbols(It begin, It end) noexcept {
+            auto first = std::find(begin, end, locale::wildcard);
+            return static_cast<size_t>(std::distance(begin, first));
+        }
+
+        /// Fewest known trailing symbols a pattern needs to be looked up in the suffix trie.
+        /// Matches in the suffix trie all get ranked, not just a page of them,
+        /// and a single letter leaves too many of them (e.g. *a).
+        static constexpr size_t min_known_suffix = 2;
+
+        /// Checks whether a pattern narrows down more levels of the suffix trie
+        /// than of the forward one, e.g. ....ość or .a.ość.
+        bool prefers_suffixes(const std::vector<Symbol>& pattern) const noexcept {
+            auto known_suffix = known_symbols(pattern.rbegin(), pattern.rend());
+            return suffixes != nullptr && known_suffix >= min_known_suffix
+                   && known_suffix > known_symbols(pattern.begin(), pattern.end());
+        }
+
+        /// Checks whether a pattern gets looked up in the positional index.
+        bool searches_positions(const std::vector<Symbol>& pattern) const noexcept {
+            return positions != nullptr && !pattern.empty() && pattern[0] == locale::wildcard;
+        }
+
+        /// Checks whether a pattern gets looked up in the suffix trie.
+        bool searches_suffixes(const std::vector<Symbol>& pattern) const noexcept {
+            return !searches_positions(pattern) && prefers_suffixes(pattern);
+        }
+
+        bool prefers_suffixes(const pattern_type& pattern) const noexcept {
+            auto known_suffix = pattern.known_suffix();
+            return suffixes != nullptr && known_suffix >= min_known_suffix
+                   && known_suffix > pattern.known_prefix();
+        }
+
+        bool searches_suffixes(const pattern_type& pattern) const noexcept {
+            return prefers_suffixes(pattern);
+        }
+
+        /// Most matches of a pattern lookup_best scores all at once, instead of bounding
+        /// the search of the forward trie.
+        static constexpr size_t max_scored_matches = 1024;
+
+        /// Scores all the matches of a pattern ending in known letters, as long as there are
+        /// few enough of them (see max_scored_matches). The suffix trie enumerates those faster
+        /// than the forward trie can rule out its subtrees, e.g. for .......ość.
+        /// @returns False if nothing got scored, since the pattern has too many matches
+        /// or does not end in enough known letters.
+        template <typename Pattern>
+        bool score_suffix_matches(ScoredResults& collector,
+                                  const Pattern& pattern,
+                                  const utils::CancellationToken* cancellation) const {
+            if (!prefers_suffixes(pattern)) {
+                return false;
+            }
+
+            std::vector<StringHandle> handles;
+            if (!suffixes->collect(handles, pattern, max_scored_matches, cancellation)) {
+                return false;
+            }
+            for (auto handle : handles) {
+                collector.push(handle);
+            }
+            return true;
+        }
+
+        /// Finds words by the symbols of a pattern, in the order of the trie.
+        void find_symbols(const std::vector<Symbol>& pattern,
+                          std::vector<std::u8string_view>& results,
+                          size_t limit,
+                          const Symbol* after,
+                          const utils::CancellationToken* cancellation) const {
+            if (searches_positions(pattern)) {
+                positions->find_words(results, pattern, limit, string_pool, after,
+                                      cancellation);
+                return;
+            }
+
+            if (searches_suffixes(pattern)) {
+                suffixes->find_words(results, pattern, limit, string_pool, after,
+                                     cancellation);
+                return;
+            }
+
+            if (minimized()) {
+                auto words = words_by_ordinal.data();
+                if (!find_words_parallel<true>(root.get(), *arenas, results, pattern, limit,
+                                               words, string_pool, after, parallel_lookup,
+                                               cancellation)) {
+                    root->find_words_by_ordinal(results, pattern, 0, limit, 0, words,
+                                                *arenas, string_pool, after, cancellation);
+                }
+            } else {
+                if (!find_words_parallel<false>(root.get(), *arenas, results, pattern, limit,
+                                                nullptr, string_pool, after,
+                                                parallel_lookup, cancellation)) {
+                    root->find_words(results, pattern, 0, limit, *arenas, string_pool, after,
+                                     cancellation);
+                }
+            }
+        }
+
+        /// Creates a symbol-based search function for Alphabet::lookup.
+        auto finder(const utils::CancellationToken* cancellation) const {
+            return [this, cancellation](const std::vector<Symbol>& pattern, auto& results,
+                                        size_t limit, const Symbol* after) {
+                find_symbols(pattern, results, limit, after, cancellation);
+                homographs.expand(results, string_pool);
+            };
+        }
+
+        /// Finds words matching a compiled pattern, in the order of the trie.
+        void match_pattern(const pattern_type& pattern,
+                           std::vector<std::u8string_view>& results,
+                           size_t limit,
+                           const std::vector<Symbol>& cursor,
+                           const utils::CancellationToken* cancellation) const {
+            auto after = cursor.empty() ? nullptr : &cursor;
+            if (searches_suffixes(pattern)) {
+                suffixes->match(results, pattern, limit, string_pool, after, cancellation);
+                return;
+            }
+
+            LimitedResults collector{results, limit, string_pool, cancellation};
+            if (minimized()) {
+                root->match<true>(collector, *arenas, pattern, pattern.start(), 0, 0,
+                                  words_by_ordinal.data(), after);
+            } else {
+                root->match<false>(collector, *arenas, pattern, pattern.start(), 0, 0,
+                                   nullptr, after);
+            }
+        }
+
+        /// Creates an automaton-based search function for CompiledPattern::lookup.
+        auto matcher(const utils::CancellationToken* cancellation) const {
+            return [this, cancellation](const pattern_type& pattern, auto& results, size_t limit,
+                                        const std::vector<Symbol>& cursor) {
+                match_pattern(pattern, results, limit, cursor, cancellation);
+                homographs.expand(results, string_pool);
+            };
+        }
+
+        /// Looks up a page of words, picking the search function the pattern needs.
+        /// Patterns of letters and dots only take the direct (and parallel) search.
+        /// @param cancellation Stops the search once cancelled, or null.
+        std::vector<std::u8string_view> search(const std::u8string& input,
+                                               const size_t max_results,
+                                               const std::vector<Symbol>& cursor,
+                                               std::vector<Symbol>* next_cursor,
+                                               const utils::CancellationToken* cancellation) const {
+            if (is_extended_pattern(input)) {
+                return pattern_type::lookup(input, max_results, cursor, next_cursor,
+                                            matcher(cancellation));
+            }
+            return Alphabet::lookup(input, max_results, cursor, next_cursor,
+                                    finder(cancellation));
+        }
+
+        /// Filters the cached results of a more general pattern, e.g. k.t for kot,
+        /// instead of searching the index. Only the positions the general pattern leaves out
+        /// get checked, so refining takes a byte comparison or two per cached word.
+        /// @details Patterns with letters outside of the alphabet are never refined,
+        /// since matching them takes more than their symbols.
+        /// @returns Null if no cached pattern generalizes the input.
+        std::shared_ptr<const CachedResults> refine(const std::u8string& input) const {
+            if (is_extended_pattern(input)) {
+                return nullptr;
+            }
+
+            std::vector<Symbol> pattern;
+            if (!Alphabet::encode_pattern(input, pattern) || pattern.empty()) {
+                return nullptr;
+            }
+
+            auto generalizes = [&](auto, const CachedResults& results) {
+                if (results.pattern.size() != pattern.size()) {
+                    return false;
+                }
+                for (size_t i = 0; i < pattern.size(); ++i) {
+                    auto general = results.pattern[i];
+                    if (general != locale::wildcard && general != pattern[i]) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            auto general = cache->find_smallest(generalizes);
+            if (general == nullptr) {
+                return nullptr;
+            }
+
+            std::vector<size_t> checked;
+            for (size_t i = 0; i < pattern.size(); ++i) {
+                if (general->pattern[i] == locale::wildcard && pattern[i] != locale::wildcard) {
+                    checked.push_back(i);
+                }
+            }
+
+            auto refined = std::make_shared<CachedResults>();
+            refined->pattern = pattern;
+            auto length = pattern.size();
+            for (size_t word = 0; word < general->words.size(); ++word) {
+                auto symbols = general->symbols.data() + word * length;
+                auto matches = std::all_of(checked.begin(), checked.end(),
+                                           [&](size_t i) { return symbols[i] == pattern[i]; });
+                if (matches) {
+                    refined->words.push_back(general->words[word]);
+                    refined->symbols.insert(refined->symbols.end(), symbols, symbols + length);
+                }
+            }
+            return refined;
+        }
+
+        /// Packs complete results of a lookup for the cache.
+        static std::shared_ptr<const CachedResults>
+        cached_results(const std::u8string& input,
+                       const std::vector<std::u8string_view>& words) {
+            auto cached = std::make_shared<CachedResults>();
+            cached->words = words;
+
+            // Only patterns of letters from the alphabet can be refined
+            if (!is_extended_pattern(input) && Alphabet::encode_pattern(input, cached->pattern)) {
+                std::vector<Symbol> symbols;
+                cached->symbols.reserve(words.size() * cached->pattern.size());
+                for (auto word : words) {
+                    Alphabet::encode_word(word, symbols);
+                    cached->symbols.insert(cached->symbols.end(), symbols.begin(), symbols.end());
+                }
+            } else {
+                cached->pattern.clear();
+            }
+            return cached;
+        }
+
+        /// Cuts the first page out of cached results, like a search would.
+        static std::vector<std::u8string_view> page_of(const CachedResults& cached,
+                                                       const size_t max_results,
+                                                       std::vector<Symbol>* next_cursor) {
+            auto limit = std::min(max_results, static_cast<size_t>(INT32_MAX - 1));
+            if (next_cursor != nullptr) {
+                ++limit;
+            }
+
+            auto count = std::min(limit, cached.words.size());
+            std::vector<std::u8string_view> results(cached.words.begin(),
+                                                    cached.words.begin() + count);
+            Alphabet::trim_page(results, max_results, {}, next_cursor);
+            return results;
+        }
+
+        /// Looks up a page of words, through the query cache if it is enabled.
+        /// @details A query all of whose results fit in a single page gets cached,
+        /// so that repeating it or filling in its dots does not search the index again.
+        /// Results of a cancelled search are incomplete, so they never get cached,
+        /// and neither do those of an empty page, which has no room to prove them complete.
+        std::vector<std::u8string_view> find(const std::u8string& input,
+                                             const size_t max_results,
+                                             const std::vector<Symbol>& cursor,
+                                             std::vector<Symbol>* next_cursor,
+                                             const utils::CancellationToken* cancellation) const {
+            if (cache == nullptr || !cursor.empty()) {
+                return search(input, max_results, cursor, next_cursor, cancellation);
+            }
+
+            auto cached = cache->get(input);
+            if (cached == nullptr) {
+                cached = refine(input);
+                if (cached != nullptr) {
+                    cache->put(input, cached);
+                }
+            }
+            if (cached != nullptr) {
+                return page_of(*cached, max_results, next_cursor);
+            }
+
+            std::vector<Symbol> more;
+            auto results = search(input, max_results, {}, &more, cancellation);
+            if (max_results > 0 && more.empty() && results.size() <= cache->max_results()
+                && !utils::CancellationToken::is_cancelled(cancellation)) {
+                cache->put(input, cached_results(input, results));
+            }
+            if (next_cursor != nullptr) {
+                *next_cursor = std::move(more);
+            }
+            return results;
         }
 
     public:
 
-        MissingLettersIndex() :
+        BasicMissingLettersIndex() :
             root(std::make_unique<WordNode>()),
-            arena_node(std::make_unique<Arena<WordNode>>()),
-            arena_map_chunk(std::make_unique<Arena<MapChunk<uint8_t, WordNode*>>>()),
-            arena_string(std::make_unique<Arena<std::u8string, false>>()) {}
+            arenas(std::make_unique<TrieArenas>()),
+            is_minimized(false),
+            is_compressed(false),
+            is_ranked(false),
+            frozen_node_count(0),
+            frozen_chunk_count(0) {}
+
+        ~BasicMissingLettersIndex() = default;
 
-        ~MissingLettersIndex() = default;
+        /// Number of distinct shard keys, i.e. of pairs of the first two symbols of a word.
+        static constexpr size_t shard_key_count = (Alphabet::size + 2) * (Alphabet::size + 2);
+
+        /// Keys a line by its first two symbols, in the order of the trie.
+        /// Words of different keys never share a node deeper than the second level,
+        /// so they can be built independently (see load_from_buffer_sharded_impl).
+        static size_t shard_key(const uint8_t* line, size_t length) {
+            auto it = reinterpret_cast<const char8_t*>(line);
+            auto end = it + length;
+
+            size_t key = 0;
+            for (auto i = 0; i < 2; ++i) {
+                auto symbol = it < end ? Alphabet::to_symbol(utils::decode_codepoint(it, end))
+                                       : locale::wildcard;
+                key = key * (Alphabet::size + 2) + shard_digit(symbol);
+            }
+
+            return key;
+        }
+
+        /// Adds a single line of a UTF-8 buffer to the index as a word.
+        /// The word is copied to the string pool, so the buffer can be freed afterwards.
+        /// The suffix trie no longer covers all the words, so it gets dropped.
+        void add_line(const uint8_t* line, size_t length) {
+            is_ranked = false;
+            scores.clear();
+            suffixes.reset();
+            positions.reset();
+            if (cache != nullptr) {
+                cache->clear();
+            }
+
+            auto word = std::u8string_view(reinterpret_cast<const char8_t*>(line), length);
+            auto handle = string_pool.add(word);
+            if (handle == StringPool::no_string) [[unlikely]] {
+                log::tag("MissingLettersIndex").w("Cannot store a word of %zu bytes", length);
+                return;
+            }
+
+            add(handle, word);
+        }
+
+        /// Moves the start of the (still empty) string pool to the provided offset.
+        /// @details Partial indexes loaded in parallel get disjoint offset ranges,
+        /// so that merging them does not have to relocate the word handles.
+        void start_words_at(size_t offset) noexcept {
+            string_pool.start_at(offset);
+        }
+
+        /// Reports how many bytes the words of this index take.
+        size_t word_storage_bytes() const noexcept {
+            return string_pool.size_bytes() + words_by_ordinal.size() * sizeof(StringHandle);
+        }
+
+        /// Exposes the words of this index, e.g. for serialization.
+        const StringPool& words() const noexcept {
+            return string_pool;
+        }
 
         /// Tries to merge this index with another index.
         /// @returns True if the merge was successful.
@@ -48,15 +502,41 @@ namespace crossword::indexing {
         /// or not enough memory is available.
         /// @details No matter the result, the other index is assumed to be in an invalid state.
         virtual bool merge(WordIndex* other) override {
-            auto other_index = dynamic_cast<MissingLettersIndex*>(other);
+            auto other_index = dynamic_cast<BasicMissingLettersIndex*>(other);
             if (other_index == nullptr) {
                 return false;
             }
 
-            root->merge(other_index->root.get(), arena_map_chunk.get());
-            arena_node->merge(other_index->arena_node.get());
-            arena_map_chunk->merge(other_index->arena_map_chunk.get());
-            arena_string->merge(other_index->arena_string.get());
+            // Nodes of a minimized or compressed trie cannot be modified in place
+            if (frozen() || other_index->frozen()) {
+                return false;
+            }
+
+            if (!string_pool.can_append(other_index->string_pool)) {
+                return false;
+            }
+
+            is_ranked = false;
+            scores.clear();
+            suffixes.reset();
+            positions.reset();
+            if (cache != nullptr) {
+                cache->clear();
+            }
+            auto shift = string_pool.append(other_index->string_pool);
+            if (shift != 0) {
+                other_index->root->relocate_words(shift, *other_index->arenas);
+            }
+            homographs.append(other_index->homographs, shift, string_pool);
+
+            // Nodes are referred to by indices, so the arenas have to be merged first.
+            // Nothing refers to the arenas of an empty trie, so they can be swapped instead
+            if (!root->has_children()) {
+                std::swap(arenas, other_index->arenas);
+            } else {
+                arenas->merge(other_index->arenas.get(), other_index->root.get());
+            }
+            root->merge(other_index->root.get(), arenas.get());
 
             return true;
         }
@@ -64,62 +544,490 @@ namespace crossword::indexing {
         /// Returns the set of words that match the provided pattern.
         /// The pattern is assumed to be a string of UTF-8 characters,
         /// where a dot . (0x2E) is considered to be any character.
+        /// Sets of letters, runs and length bounds are supported too (see CompiledPattern).
         /// @result The set of words that match the pattern.
         /// @param input The pattern to match.
         /// @param max_results The maximum number of results to return.
         virtual std::vector<std::u8string> lookup(const std::u8string& input,
                                                   const size_t max_results) const override {
-            std::vector<std::u8string> results;
-            root->find_words(results, input, 0, 0, max_results);
-            return results;
+            auto words = find(input, max_results, {}, nullptr, nullptr);
+            return {words.begin(), words.end()};
+        }
+
+        /// Returns a page of words that match the provided pattern, in alphabetical order.
+        /// The cursor holds alphabet symbols of the last word on the page,
+        /// so the next page starts right after that word without walking the trie again.
+        /// A cancelled lookup stops within a few visited nodes (see utils::CancellationToken).
+        virtual LookupPage lookup_page(const std::u8string& input,
+                                       const size_t max_results,
+                                       const std::vector<uint8_t>& cursor,
+                                       const utils::CancellationToken* cancellation = nullptr)
+            const override {
+            LookupPage page;
+            page.words = find(input, max_results, cursor, &page.cursor, cancellation);
+            return page;
+        }
+
+        /// Lets lookups fanning out from the root (patterns starting with a wildcard)
+        /// search the subtrees below the split depth on several threads.
+        /// The results stay exactly the same as those of a single-threaded lookup.
+        void set_parallel_lookup(const ParallelLookupOptions& options) noexcept {
+            parallel_lookup = options;
+        }
+
+        /// Checks whether the trie of this index has been minimized.
+        bool minimized() const noexcept {
+            return is_minimized;
+        }
+
+        /// Checks whether the trie of this index has been path-compressed.
+        bool compressed() const noexcept {
+            return is_compressed;
+        }
+
+        /// Checks whether words can no longer be added to this index.
+        bool frozen() const noexcept {
+            return minimized() || compressed();
+        }
+
+        /// Minimizes the trie of this index into a directed acyclic word graph,
+        /// sharing all the equivalent subtrees (e.g. common inflection suffixes).
+        /// The lookup results stay the same, but the index cannot be extended anymore.
+        void minimize() {
+            if (minimized()) {
+                return;
+            }
+
+            auto logger = log::tag("MissingLettersIndex");
+            auto nodes_before = node_count();
+
+            // The minimized graph gets allocated in fresh arenas,
+            // so that the old trie can be freed as a whole
+            auto new_arenas = std::make_unique<TrieArenas>();
+
+            TrieMinimizer minimizer(arenas.get(), new_arenas.get());
+            minimizer.minimize(root.get());
+
+            words_by_ordinal = minimizer.take_words();
+            is_minimized = true;
+            frozen_node_count = minimizer.node_count();
+            frozen_chunk_count = minimizer.map_chunk_count();
+            arenas = std::move(new_arenas);
+
+            logger.i("Minimized %zu nodes to %zu", nodes_before, frozen_node_count);
+        }
+
+        /// Compresses the trie of this index into a radix tree,
+        /// collapsing chains of single-child nodes (e.g. long word endings) into node labels.
+        /// The lookup results stay the same, but the index cannot be extended anymore.
+        /// @details A minimized index can be compressed as well, its nodes stay shared.
+        void compress() {
+            if (compressed()) {
+                return;
+            }
+
+            auto logger = log::tag("MissingLettersIndex");
+            auto nodes_before = node_count();
+
+            auto new_arenas = std::make_unique<TrieArenas>();
+
+            TrieCompressor compressor(arenas.get(), new_arenas.get(), minimized());
+            compressor.compress(root.get());
+
+            if (suffixes != nullptr) {
+                suffixes->compress();
+            }
+
+            is_compressed = true;
+            frozen_node_count = compressor.compressed_node_count();
+            frozen_chunk_count = compressor.map_chunk_count();
+            arenas = std::move(new_arenas);
+
+            logger.i("Compressed %zu nodes to %zu", nodes_before, frozen_node_count);
+        }
+
+        /// Stores the words in collation order, i.e. in the order of the trie,
+        /// so that the handle of a word doubles as its rank: comparing two handles
+        /// compares the words. Words no node refers to anymore (e.g. duplicates) get dropped.
+        /// @details Handles of the words change, so the suffix trie and the positional index
+        /// get dropped. Adding more words breaks the order again.
+        void rank_words() {
+            if (is_ranked) {
+                return;
+            }
+
+            auto logger = log::tag("MissingLettersIndex");
+            auto bytes_before = string_pool.size_bytes();
+
+            // Words sharing a node with the copied one follow it, in the order of lookups
+            StringPool ranked_pool;
+            auto copy = [&](StringHandle handle) {
+                if (homographs.empty()) [[likely]] {
+                    return ranked_pool.add(string_pool.get(handle));
+                }
+                return homographs.copy(handle, string_pool, ranked_pool);
+            };
+
+            // Ordinals of a minimized trie follow the order of the trie already
+            if (minimized()) {
+                for (auto& handle : words_by_ordinal) {
+                    handle = copy(handle);
+                }
+            } else {
+                root->renumber_words(copy, *arenas);
+            }
+
+            string_pool = std::move(ranked_pool);
+            is_ranked = true;
+            suffixes.reset();
+            positions.reset();
+            if (cache != nullptr) {
+                cache->clear();
+            }
+
+            logger.i("Ranked words in %zu bytes (%zu before)", string_pool.size_bytes(),
+                     bytes_before);
+        }
+
+        /// Checks whether the words are stored in collation order (see rank_words).
+        bool ranked() const noexcept {
+            return is_ranked;
+        }
+
+        /// Builds a trie of the words spelled backwards, which lookups of patterns ending
+        /// in more known letters than they start with (e.g. ...ość) go through.
+        /// It gets compressed along with the index, but it is never minimized.
+        /// @details The words get ranked first (see rank_words), so that the suffix trie
+        /// can return its matches in collation order, like the forward trie.
+        /// The trie shares the words of the index, but not its nodes,
+        /// so it takes about as much memory as the forward trie.
+        void build_suffix_trie() {
+            auto logger = log::tag("MissingLettersIndex");
+
+            rank_words();
+            if (cache != nullptr) {
+                cache->clear();
+            }
+
+            suffixes = std::make_unique<SuffixTrie<Alphabet>>();
+            suffixes->build(string_pool);
+            if (compressed()) {
+                suffixes->compress();
+            }
+
+            logger.i("Built a suffix trie of %zu words", word_count());
+        }
+
+        /// Checks whether this index has a trie of reversed words (see build_suffix_trie).
+        bool has_suffix_trie() const noexcept {
+            return suffixes != nullptr;
+        }
+
+        /// Builds sets of words by their letters at every position, which lookups
+        /// of patterns starting with a wildcard (e.g. .a.o.e..) go through instead of the trie.
+        /// They take precedence over the suffix trie and keep the results in trie order.
+        void build_positional_index() {
+            auto logger = log::tag("MissingLettersIndex");
+
+            if (cache != nullptr) {
+                cache->clear();
+            }
+
+            positions = std::make_unique<PositionalIndex<Alphabet>>();
+            positions->build(string_pool);
+
+            logger.i("Built a positional index of %zu words", word_count());
+        }
+
+        /// Checks whether this index has a positional index (see build_positional_index).
+        bool has_positional_index() const noexcept {
+            return positions != nullptr;
+        }
+
+        /// Loads scores of the words, e.g. their frequencies in a corpus, which lookup_best
+        /// returns the best words by. Every line of the UTF-8 buffer holds a word and its score
+        /// (a decimal number), separated by a tab. Words missing from the index are skipped,
+        /// and the words without a line score zero. A word spelled in another case than
+        /// the index keeps it in (e.g. abakan for Abakan) scores the kept spelling,
+        /// and the highest of its scores wins.
+        /// @details The words get ranked first (see rank_words), so that ties can be broken
+        /// in collation order, and every node caches the highest score below it.
+        /// @returns Number of the words that got a score.
+        size_t load_scores(const uint8_t* buffer, size_t length) {
+            auto logger = log::tag("MissingLettersIndex");
+
+            rank_words();
+
+            std::vector<std::pair<StringHandle, uint32_t>> entries;
+            size_t malformed = 0;
+            size_t missing = 0;
+            utils::for_each_line(buffer, 0, length, [&](const uint8_t* line, size_t line_length) {
+                auto text = std::string_view(reinterpret_cast<const char*>(line), line_length);
+                auto tab = text.rfind('\t');
+                if (tab == std::string_view::npos) {
+                    ++malformed;
+                    return;
+                }
+
+                uint32_t score = 0;
+                auto number = text.substr(tab + 1);
+                auto number_end = number.data() + number.size();
+                auto [end, error] = std::from_chars(number.data(), number_end, score);
+                if (error != std::errc() || end != number_end) {
+                    ++malformed;
+                    return;
+                }
+
+                auto word = std::u8string_view(reinterpret_cast<const char8_t*>(line), tab);
+                auto handle = find_handle(word);
+                if (handle == StringPool::no_string) {
+                    ++missing;
+                    return;
+                }
+                entries.emplace_back(handle, score);
+            });
+
+            scores.assign(std::move(entries));
+
+            // Nodes of a minimized trie are shared, so they cannot hold the scores of their paths
+            if (!minimized()) {
+                root->assign_scores([&](StringHandle word) { return scores.get(word); },
+                                    *arenas);
+            }
+
+            if (malformed > 0) {
+                logger.w("Skipped %zu malformed score lines", malformed);
+            }
+            logger.i("Scored %zu words, %zu more are not in the index", scores.size(), missing);
+            return scores.size();
+        }
+
+        /// Checks whether any of the words has a score (see load_scores).
+        bool scored() const noexcept {
+            return !scores.empty();
+        }
+
+        /// Returns the best-scored words matching the provided pattern, from the best
+        /// to the worst, e.g. the most frequent ones. Words of equal scores come in
+        /// alphabetical order, so an index without scores returns the same as lookup.
+        /// @details Subtrees that cannot beat the words found so far are skipped (see
+        /// ScoredResults), so an unselective pattern does not walk most of its matches.
+        /// Only the forward trie holds the scores of its subtrees, so the other structures
+        /// are used just for patterns with few matches (see score_suffix_matches).
+        /// Patterns with letters outside of the alphabet, which have to be verified
+        /// word by word, get all of their matches scored. So do all the patterns
+        /// of an index with homographs, which the scored trie nodes do not hold.
+        /// @param cancellation Stops the lookup once cancelled, or null.
+        std::vector<std::u8string> lookup_best(const std::u8string& input,
+                                               const size_t max_results,
+                                               const utils::CancellationToken* cancellation
+                                               = nullptr) const {
+            std::vector<std::u8string_view> results;
+            if (scores.empty()) {
+                results = find(input, max_results, {}, nullptr, cancellation);
+                return {results.begin(), results.end()};
+            }
+
+            ScoredResults collector{scores, max_results, !minimized(), cancellation};
+            auto words = minimized() ? words_by_ordinal.data() : nullptr;
+            auto exact = false;
+            if (is_extended_pattern(input)) {
+                pattern_type pattern;
+                if (!pattern_type::compile(input, pattern)) [[unlikely]] {
+                    log::tag("MissingLettersIndex").w("Malformed pattern");
+                    return {};
+                }
+
+                exact = pattern.exact() && homographs.empty();
+                if (exact && !score_suffix_matches(collector, pattern, cancellation)) {
+                    if (minimized()) {
+                        root->match<true>(collector, *arenas, pattern, pattern.start(), 0, 0,
+                                          words, nullptr);
+                    } else {
+                        root->match<false>(collector, *arenas, pattern, pattern.start(), 0, 0,
+                                           nullptr, nullptr);
+                    }
+                }
+            } else {
+                std::vector<Symbol> pattern;
+                exact = Alphabet::encode_pattern(input, pattern) && homographs.empty();
+                if (exact && !score_suffix_matches(collector, pattern, cancellation)) {
+                    if (minimized()) {
+                        root->search<true>(collector, *arenas, pattern, 0, 0, words, nullptr);
+                    } else {
+                        root->search<false>(collector, *arenas, pattern, 0, 0, nullptr, nullptr);
+                    }
+                }
+            }
+
+            if (!exact) {
+                auto matches = find(input, static_cast<size_t>(INT32_MAX), {}, nullptr,
+                                    cancellation);
+                for (auto word : matches) {
+                    collector.push(string_pool.handle_of(word));
+                }
+            }
+
+            collector.take(results, string_pool);
+            return {results.begin(), results.end()};
+        }
+
+        /// Caches the complete results of recent lookups, so that repeating a query
+        /// or filling in one of its dots (e.g. k.t, then kot) filters cached words
+        /// instead of searching the index again. Typing a pattern mostly does just that.
+        /// @param max_entries How many queries can be cached at once.
+        /// @param max_words How many results can be cached at once, across all the queries.
+        void enable_query_cache(size_t max_entries = 64, size_t max_words = 65536) {
+            cache = std::make_unique<QueryCache>(max_entries, max_words);
+        }
+
+        /// Stops caching lookup results and forgets the cached ones.
+        void disable_query_cache() {
+            cache.reset();
+        }
+
+        /// Exposes the root of the trie, e.g. for serialization.
+        WordNode* root_node() const noexcept {
+            return root.get();
+        }
+
+        /// Exposes the arenas the nodes of the trie are resolved from.
+        const TrieArenas& node_arenas() const noexcept {
+            return *arenas;
+        }
+
+        /// Counts the words stored in this index.
+        size_t word_count() const noexcept {
+            if (minimized()) {
+                return words_by_ordinal.size() + homographs.hidden_count();
+            }
+            return root->calculate_size(*arenas) + homographs.hidden_count();
+        }
+
+        /// Checks whether any words differ only in letters outside of the alphabet
+        /// (see Homographs). Only the lookups of this index can tell those apart.
+        bool has_homographs() const noexcept {
+            return !homographs.empty();
+        }
+
+        /// Reports how many bytes of child maps have been recycled while building the trie,
+        /// i.e. how much less memory it takes than if the outgrown maps were abandoned.
+        size_t reclaimed_bytes() const noexcept {
+            return arenas->chunks.reused_count() * sizeof(ChildChunk);
+        }
+
+        /// Reports how much memory this index takes and what takes it.
+        /// @details Nodes are counted in a single pass. An unfrozen trie is walked,
+        /// since merged tries leave some unreachable nodes behind in the arenas.
+        /// Nodes of a frozen trie are shared, but they all are reachable,
+        /// so its arenas are scanned instead.
+        virtual MemoryStats memory_stats() const override {
+            MemoryStats stats;
+            stats.arenas.push_back({"nodes", arenas->nodes.stats()});
+            stats.arenas.push_back({"chunks", arenas->chunks.stats()});
+            stats.other_bytes = sizeof(WordNode) + word_storage_bytes() + scores.size_bytes()
+                                + homographs.size_bytes();
+
+            size_t valid_nodes = 0;
+            auto count = [&](const WordNode& node) {
+                auto children = static_cast<size_t>(node.children.size);
+                if (stats.fan_out.size() <= children) {
+                    stats.fan_out.resize(children + 1, 0);
+                }
+                ++stats.fan_out[children];
+                ++stats.node_count;
+                stats.chunk_count += static_cast<size_t>(node.children.allocated_chunks);
+                valid_nodes += node.valid_word != StringPool::no_string ? 1 : 0;
+            };
+
+            if (frozen()) {
+                count(*root);
+                arenas->nodes.for_each(count);
+            } else {
+                std::vector<const WordNode*> stack{root.get()};
+                while (!stack.empty()) {
+                    auto node = stack.back();
+                    stack.pop_back();
+                    count(*node);
+                    for (const auto& entry : node->children.entries(&arenas->chunks)) {
+                        stack.push_back(arenas->node(entry.second));
+                    }
+                }
+            }
+
+            stats.word_count = (minimized() ? words_by_ordinal.size() : valid_nodes)
+                               + homographs.hidden_count();
+            if (suffixes != nullptr) {
+                suffixes->add_memory_stats(stats, false);
+            }
+            if (positions != nullptr) {
+                positions->add_memory_stats(stats);
+            }
+            if (cache != nullptr) {
+                stats.other_bytes += cache->size_bytes();
+            }
+            return stats;
+        }
+
+        /// Counts the trie nodes of this index, including the root.
+        size_t node_count() const noexcept {
+            if (frozen()) {
+                return frozen_node_count;
+            }
+            return root->count_nodes(*arenas);
+        }
+
+        /// Counts the child map chunks referenced by the trie nodes.
+        size_t chunk_count() const noexcept {
+            if (frozen()) {
+                return frozen_chunk_count;
+            }
+            return root->count_chunks(*arenas);
         }
 
         /// Parses lines from a UTF-8 encoded buffer and adds them to the index.
+        /// The words are copied, so the buffer does not have to outlive the index.
         /// @param buffer Pointer to the data buffer.
         /// @param start Index to start searching from.
         /// @param end Exclusive end index of buffer parsing.
         virtual void
         load_from_buffer(const uint8_t* buffer, const size_t start, const size_t end) override {
-            // Stores contents of the current line so far
-            std::vector<uint8_t> line_buffer;
-            line_buffer.reserve(128);
-
-            android::log::tag("load_from_buffer").i("Parsing %d bytes", end - start);
-
-            auto index = start;
-            while (index < end) {
-                // Read the buffer forward
-                auto byte = buffer[index++];
-                if (byte != '\n' && byte != '\r') {
-                    line_buffer.push_back(byte);
-                } else {
-                    // CRLF sequences and multiple line breaks are valid,
-                    // but since we control the input, we know that's pretty rare
-                    if (!line_buffer.empty()) [[likely]] {
-                        // Most of the words are short enough to be inlined
-                        auto word_ptr = arena_string->alloc();
-                        *word_ptr = std::u8string(line_buffer.begin(), line_buffer.end());
-                        line_buffer.clear();
-                        add(word_ptr);
-                    }
-                }
+            if (frozen()) [[unlikely]] {
+                log::tag("load_from_buffer").w("Cannot add words to a frozen index");
+                return;
             }
 
-            // In case the buffer did not end with a new line,
-            // push the remaining chars
-            if (!line_buffer.empty()) {
-                auto word_ptr = arena_string->alloc();
-                *word_ptr = std::u8string(line_buffer.begin(), line_buffer.end());
-                add(word_ptr);
-            }
+            log::tag("load_from_buffer").i("Parsing %zu bytes", end - start);
+
+            utils::for_each_line(buffer, start, end, [this](const uint8_t* line, size_t length) {
+                add_line(line, length);
+            });
         }
 
         virtual void load_from_buffer_parallel(const uint8_t* buffer,
                                                const int length,
                                                const int parallel_factor) override {
-            load_from_buffer_parallel_impl<MissingLettersIndex>(buffer, length, parallel_factor);
+            load_from_buffer_parallel_impl<BasicMissingLettersIndex>(buffer, length,
+                                                                     parallel_factor);
+        }
+
+        /// Loads the buffer in parallel, like load_from_buffer_parallel,
+        /// but every thread builds whole subtrees of the words starting with its letters,
+        /// so that the partial tries do not have to be merged node by node afterwards.
+        void load_from_buffer_sharded(const uint8_t* buffer,
+                                      const int length,
+                                      const int parallel_factor) {
+            if (frozen()) [[unlikely]] {
+                log::tag("load_from_buffer").w("Cannot add words to a frozen index");
+                return;
+            }
+
+            load_from_buffer_sharded_impl<BasicMissingLettersIndex>(buffer, length,
+                                                                    parallel_factor);
         }
     };
+
+    using MissingLettersIndex = BasicMissingLettersIndex<locale::pl_PL>;
 }
 
 #endif // CROSSWORD_HELPER_MISSING_LETTERS_HPP
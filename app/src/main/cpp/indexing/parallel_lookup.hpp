@@ -0,0 +1,187 @@
+#ifndef CROSSWORD_HELPER_PARALLEL_LOOKUP_HPP
+#define CROSSWORD_HELPER_PARALLEL_LOOKUP_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../utils/cancellation.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../word_node.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::locale::Symbol;
+
+    /// Configures how a single lookup gets split between threads.
+    struct ParallelLookupOptions {
+        /// How many threads (including the calling one) search a single lookup?
+        /// One disables the parallel mode. The threads are taken from utils::ThreadPool.
+        size_t thread_count = 1;
+        /// Pattern position at which the trie gets split into tasks.
+        /// Every matching node at that depth becomes a task of its own.
+        size_t split_depth = 2;
+    };
+
+    /// A part of a lookup that can be searched independently of the others.
+    /// @details Either a subtree to search, or a word found above the split depth.
+    struct LookupTask {
+        WordNode* node;
+        size_t index;
+        uint32_t ordinal;
+        const Symbol* after;
+        StringHandle word;
+    };
+
+    /// Collects the top of a lookup into tasks, instead of searching the subtrees below it.
+    struct FrontierResults {
+        std::vector<LookupTask>& tasks;
+        size_t split_depth;
+
+        constexpr bool full() const noexcept {
+            return false;
+        }
+
+        void push(StringHandle word) {
+            tasks.push_back({nullptr, 0, 0, nullptr, word});
+        }
+
+        bool descend(WordNode* child, size_t index, uint32_t ordinal, const Symbol* after) {
+            if (index < split_depth) {
+                return true;
+            }
+
+            tasks.push_back({child, index, ordinal, after, StringPool::no_string});
+            return false;
+        }
+    };
+
+    /// Collects the results of a single task.
+    /// Stops early once the tasks before it are known to fill the limit on their own,
+    /// or once the lookup gets cancelled.
+    struct TaskResults {
+        std::vector<std::u8string_view>& words;
+        size_t limit;
+        const StringPool& pool;
+        size_t task;
+        const std::atomic<size_t>& cutoff;
+        const utils::CancellationToken* cancellation;
+
+        bool full() const noexcept {
+            return words.size() >= limit || cutoff.load(std::memory_order_relaxed) <= task
+                   || utils::CancellationToken::is_cancelled(cancellation);
+        }
+
+        void push(StringHandle word) {
+            words.push_back(pool.get(word));
+        }
+
+        constexpr bool descend(WordNode*, size_t, uint32_t, const Symbol*) const noexcept {
+            return true;
+        }
+    };
+
+    /// Searches a trie on several threads, with the same results as WordNode::search.
+    /// @details The top of the trie (up to the split depth) is searched on the calling thread,
+    /// and every subtree below it becomes a task. Threads take the tasks in order, and every
+    /// task collects its words separately, so the results get concatenated in trie order.
+    /// The tasks share a budget: the number of results still missing after all the finished
+    /// tasks before the first unfinished one. A task never collects more than the budget
+    /// it has started with, and once the finished tasks fill the limit, all the later tasks
+    /// stop, without taking any results the serial search would not have returned.
+    /// A cancelled lookup stops all the tasks, and leaves the results incomplete.
+    /// @returns False if the lookup was not worth splitting; nothing has been searched then.
+    template <bool by_ordinal>
+    bool find_words_parallel(WordNode* root,
+                             const TrieArenas& arenas,
+                             std::vector<std::u8string_view>& vec,
+                             const std::vector<Symbol>& pattern,
+                             const size_t limit,
+                             const StringHandle* words,
+                             const StringPool& pool,
+                             const Symbol* after,
+                             const ParallelLookupOptions& options,
+                             const utils::CancellationToken* cancellation = nullptr) {
+        // Only patterns starting with a wildcard fan out enough to pay for the threads
+        if (options.thread_count < 2 || pattern.empty() || pattern[0] != locale::wildcard) {
+            return false;
+        }
+
+        std::vector<LookupTask> tasks;
+        FrontierResults frontier{tasks, std::max<size_t>(options.split_depth, 1)};
+        root->search<by_ordinal>(frontier, arenas, pattern, 0, 0, words, after);
+        if (tasks.size() < options.thread_count) {
+            return false;
+        }
+
+        std::vector<std::vector<std::u8string_view>> task_words(tasks.size());
+        std::vector<bool> task_done(tasks.size(), false);
+
+        std::atomic<size_t> next_task{0};
+        std::atomic<size_t> cutoff{tasks.size()};
+        std::atomic<size_t> budget{limit};
+
+        // Guards the bookkeeping of finished tasks
+        std::mutex done_mutex;
+        size_t settled = 0;
+        size_t settled_words = 0;
+
+        auto worker = [&]() {
+            while (true) {
+                auto i = next_task.fetch_add(1, std::memory_order_relaxed);
+                if (i >= cutoff.load(std::memory_order_relaxed)
+                    || utils::CancellationToken::is_cancelled(cancellation)) {
+                    return;
+                }
+
+                const auto& task = tasks[i];
+                auto& found = task_words[i];
+                if (task.node == nullptr) {
+                    found.push_back(pool.get(task.word));
+                } else {
+                    auto task_limit = budget.load(std::memory_order_relaxed);
+                    TaskResults results{found, task_limit, pool, i, cutoff, cancellation};
+                    task.node->template search<by_ordinal>(results, arenas, pattern, task.index,
+                                                           task.ordinal, words, task.after);
+                }
+
+                std::lock_guard lock(done_mutex);
+                task_done[i] = true;
+                while (settled < tasks.size() && task_done[settled]) {
+                    settled_words += task_words[settled].size();
+                    ++settled;
+                }
+
+                if (settled_words >= limit) {
+                    // Tasks after the settled ones cannot contribute anything anymore
+                    auto current_cutoff = cutoff.load(std::memory_order_relaxed);
+                    cutoff.store(std::min(settled, current_cutoff), std::memory_order_relaxed);
+                    budget.store(0, std::memory_order_relaxed);
+                } else {
+                    budget.store(limit - settled_words, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        // The calling thread works on the tasks too, instead of just waiting for them
+        auto& thread_pool = utils::ThreadPool::shared();
+        utils::TaskGroup group;
+        for (size_t i = 1; i < options.thread_count; ++i) {
+            thread_pool.submit(group, worker);
+        }
+        worker();
+        thread_pool.wait(group);
+
+        for (auto& found : task_words) {
+            auto count = std::min(found.size(), limit - std::min(vec.size(), limit));
+            vec.insert(vec.end(), found.begin(), found.begin() + static_cast<ptrdiff_t>(count));
+        }
+
+        return true;
+    }
+}
+
+#endif // CROSSWORD_HELPER_PARALLEL_LOOKUP_HPP
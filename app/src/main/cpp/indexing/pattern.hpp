@@ -0,0 +1,437 @@
+#ifndef CROSSWORD_HELPER_PATTERN_HPP
+#define CROSSWORD_HELPER_PATTERN_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../utils/log.hpp"
+#include "../utils/utf8.hpp"
+#include "../word_node.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::locale::Symbol;
+
+    /// Checks whether a pattern uses any syntax beyond letters and dots,
+    /// i.e. whether it has to be matched by a CompiledPattern.
+    inline bool is_extended_pattern(std::u8string_view pattern) {
+        return pattern.find_first_of(u8"[]*?{}") != std::u8string_view::npos;
+    }
+
+    /// A pattern compiled into a small nondeterministic automaton over alphabet symbols.
+    /// @details The syntax extends the one of Alphabet::encode_pattern:
+    /// - a letter matches itself (case-insensitively), a dot . matches any single letter,
+    /// - [abc] matches any of the listed letters, [^abc] any letter except the listed ones,
+    /// - * matches any run of letters (including none), ? matches one letter or none,
+    /// - a trailing {m,n} only accepts words of m to n letters ({m}, {m,} and {,n} work too).
+    /// Every position of the pattern is a state, and a set of states is a single bit mask,
+    /// so stepping the automaton by a symbol takes a few bitwise operations.
+    /// A trie walk steps the automaton once per edge, and skips every subtree
+    /// where no state is left, or where no word is long enough for any of the states.
+    /// @tparam Alphabet The locale::Alphabet the letters get mapped with.
+    template <typename Alphabet>
+    class CompiledPattern final {
+    public:
+        /// A set of states of the automaton: bit i stands for "about to match position i",
+        /// the bit after the last position stands for "the whole pattern has been matched".
+        using StateSet = uint64_t;
+
+        /// Most positions a pattern can have. One bit of StateSet is taken by the final state.
+        static constexpr size_t max_positions = 63;
+
+        /// Marks the absence of an upper length bound.
+        static constexpr size_t unbounded = SIZE_MAX;
+
+    private:
+        /// How many times can the letter of a position repeat?
+        enum class Repeat : uint8_t {
+            once,
+            optional,
+            any,
+        };
+
+        struct Position {
+            Repeat repeat;
+            /// Whether the position matches everything except the listed letters.
+            bool negated;
+            /// Letters listed in the pattern.
+            std::u32string letters;
+            /// Listed letters that are not a part of the alphabet, case-folded.
+            /// They all share the unknown symbol, so matches have to be verified.
+            std::u32string unknown_letters;
+        };
+
+        std::vector<Position> positions;
+        /// States that consume each symbol, indexed by the symbol.
+        std::array<StateSet, 256> consumers{};
+        /// States that stay put after consuming a symbol (the * runs).
+        StateSet loops = 0;
+        /// States that can be skipped without consuming anything (the * and ? runs).
+        StateSet skips = 0;
+        StateSet initial = 0;
+        StateSet final_state = 0;
+        /// The only symbol a state consumes, or the wildcard if there are more of them.
+        std::vector<Symbol> single_symbols;
+        /// Remaining word lengths every state can still accept, as a WordNode::length_mask.
+        std::vector<uint32_t> state_lengths;
+        size_t min_length = 0;
+        size_t max_length = unbounded;
+        bool is_exact = true;
+
+        /// Maps a range of remaining lengths to the bits of a WordNode::length_mask.
+        static constexpr uint32_t length_range(size_t min, size_t max) noexcept {
+            if (min > max) {
+                return 0;
+            }
+            auto low = std::min<size_t>(min, 31);
+            auto high = std::min<size_t>(max, 31);
+            auto up_to_high = high == 31 ? UINT32_MAX : (uint32_t{1} << (high + 1)) - 1;
+            return up_to_high & ~((uint32_t{1} << low) - 1);
+        }
+
+        /// Adds all the states reachable by skipping optional positions.
+        StateSet closure(StateSet states) const noexcept {
+            while (true) {
+                auto next = states | ((states & skips) << 1);
+                if (next == states) {
+                    return states;
+                }
+                states = next;
+            }
+        }
+
+        /// Moves the states that have just consumed a symbol to their next positions.
+        StateSet advance(StateSet consumed) const noexcept {
+            return closure(((consumed & ~loops) << 1) | (consumed & loops));
+        }
+
+        /// Collects the states that consume a codepoint outside of the alphabet.
+        StateSet unknown_consumers(char32_t codepoint) const {
+            StateSet states = 0;
+            for (size_t i = 0; i < positions.size(); ++i) {
+                const auto& letters = positions[i].unknown_letters;
+                auto listed = letters.find(codepoint) != std::u32string::npos;
+                if (listed != positions[i].negated) {
+                    states |= StateSet{1} << i;
+                }
+            }
+            return states;
+        }
+
+        /// Parses the digits of a length bound.
+        /// @returns False if there are none, or the bound does not fit.
+        static bool parse_bound(const char8_t*& it, const char8_t* end, size_t& bound) {
+            size_t value = 0;
+            auto digits = 0;
+            while (it < end && *it >= u8'0' && *it <= u8'9') {
+                value = value * 10 + static_cast<size_t>(*it - u8'0');
+                if (++digits > 4) {
+                    return false;
+                }
+                ++it;
+            }
+            if (digits > 0) {
+                bound = value;
+            }
+            return digits > 0;
+        }
+
+        /// Parses a trailing {m,n}, where the opening brace has been consumed already.
+        bool parse_length_bounds(const char8_t* it, const char8_t* end) {
+            auto has_min = parse_bound(it, end, min_length);
+            if (it < end && *it == u8',') {
+                ++it;
+                parse_bound(it, end, max_length);
+            } else if (has_min) {
+                max_length = min_length;
+            } else {
+                return false;
+            }
+
+            return it + 1 == end && *it == u8'}' && min_length <= max_length;
+        }
+
+        /// Adds a position matching a single letter, or a set of letters.
+        void add_position(Repeat repeat, bool negated, const std::u32string& letters) {
+            auto state = StateSet{1} << positions.size();
+            Position position{repeat, negated, letters, {}};
+
+            std::array<bool, 256> listed{};
+            for (auto letter : letters) {
+                auto symbol = Alphabet::to_symbol(letter);
+                listed[symbol] = true;
+                if (symbol == locale::unknown) {
+                    position.unknown_letters.push_back(utils::fold_case(letter));
+                }
+            }
+
+            auto symbol_count = 0;
+            auto single = locale::wildcard;
+            for (size_t symbol = 1; symbol <= Alphabet::size; ++symbol) {
+                if (listed[symbol] != negated) {
+                    consumers[symbol] |= state;
+                    single = static_cast<Symbol>(symbol);
+                    ++symbol_count;
+                }
+            }
+
+            // Unknown codepoints all share a symbol, so unless none of them can match,
+            // words following that symbol have to be verified codepoint by codepoint
+            if (negated || !position.unknown_letters.empty()) {
+                consumers[locale::unknown] |= state;
+                is_exact &= position.unknown_letters.empty();
+                symbol_count = 2;
+            }
+
+            if (repeat == Repeat::any) {
+                loops |= state;
+            }
+            if (repeat != Repeat::once) {
+                skips |= state;
+            }
+
+            positions.push_back(std::move(position));
+            single_symbols.push_back(symbol_count == 1 ? single : locale::wildcard);
+        }
+
+        /// Checks whether a position fans out to any letter, or to a varying number of them.
+        static bool fans_out(const Position& position) noexcept {
+            return position.repeat != Repeat::once || position.negated;
+        }
+
+        /// Fills the tables derived from the positions, once all of them have been added.
+        void finish() {
+            initial = closure(1);
+            final_state = StateSet{1} << positions.size();
+
+            state_lengths.assign(positions.size() + 1, length_range(0, 0));
+            size_t min_rest = 0;
+            size_t max_rest = 0;
+            for (auto i = positions.size(); i-- > 0;) {
+                auto repeat = positions[i].repeat;
+                min_rest += repeat == Repeat::once ? 1 : 0;
+                if (max_rest != unbounded) {
+                    max_rest = repeat == Repeat::any ? unbounded : max_rest + 1;
+                }
+                state_lengths[i] = length_range(min_rest, max_rest);
+            }
+        }
+
+    public:
+        /// Compiles a pattern (see the class description for the syntax).
+        /// @returns False if the pattern is malformed or has too many positions.
+        static bool compile(std::u8string_view source, CompiledPattern& pattern) {
+            pattern = CompiledPattern();
+
+            auto it = source.data();
+            auto end = it + source.length();
+            while (it < end) {
+                if (pattern.positions.size() == max_positions) {
+                    return false;
+                }
+
+                auto codepoint = utils::decode_codepoint(it, end);
+                switch (codepoint) {
+                case U'.':
+                    pattern.add_position(Repeat::once, true, {});
+                    break;
+                case U'*':
+                    pattern.add_position(Repeat::any, true, {});
+                    break;
+                case U'?':
+                    pattern.add_position(Repeat::optional, true, {});
+                    break;
+                case U'[': {
+                    auto negated = it < end && *it == u8'^';
+                    if (negated) {
+                        ++it;
+                    }
+
+                    std::u32string letters;
+                    auto closed = false;
+                    while (it < end && !closed) {
+                        auto letter = utils::decode_codepoint(it, end);
+                        if (letter == U']') {
+                            closed = true;
+                        } else {
+                            letters.push_back(letter);
+                        }
+                    }
+                    if (!closed || letters.empty()) {
+                        return false;
+                    }
+                    pattern.add_position(Repeat::once, negated, letters);
+                    break;
+                }
+                case U'{':
+                    if (!pattern.parse_length_bounds(it, end)) {
+                        return false;
+                    }
+                    it = end;
+                    break;
+                case U']':
+                case U'}':
+                    return false;
+                default:
+                    pattern.add_position(Repeat::once, false, std::u32string(1, codepoint));
+                    break;
+                }
+            }
+
+            pattern.finish();
+            return true;
+        }
+
+        /// Compiles the same pattern for words spelled backwards (see SuffixTrie).
+        CompiledPattern reversed() const {
+            CompiledPattern pattern;
+            for (auto it = positions.rbegin(); it != positions.rend(); ++it) {
+                pattern.add_position(it->repeat, it->negated, it->letters);
+            }
+            pattern.min_length = min_length;
+            pattern.max_length = max_length;
+            pattern.finish();
+            return pattern;
+        }
+
+        /// Counts the leading positions that match a single letter of a limited set,
+        /// i.e. how many trie levels the pattern narrows down before it starts to fan out.
+        size_t known_prefix() const noexcept {
+            auto first = std::find_if(positions.begin(), positions.end(), fans_out);
+            return static_cast<size_t>(first - positions.begin());
+        }
+
+        /// Counts the trailing positions that match a single letter of a limited set.
+        size_t known_suffix() const noexcept {
+            auto first = std::find_if(positions.rbegin(), positions.rend(), fans_out);
+            return static_cast<size_t>(first - positions.rbegin());
+        }
+
+        /// States of the automaton before matching any symbol.
+        StateSet start() const noexcept {
+            return initial;
+        }
+
+        /// Steps the automaton by a symbol. An empty set means that no word can match anymore.
+        StateSet step(StateSet states, Symbol symbol) const noexcept {
+            return advance(states & consumers[symbol]);
+        }
+
+        /// Checks whether a word of the provided length ending in these states matches.
+        bool accepts(StateSet states, size_t length) const noexcept {
+            return (states & final_state) != 0 && length >= min_length && length <= max_length;
+        }
+
+        /// Lengths the rest of a word can have, after its first length symbols have brought
+        /// the automaton to these states. Laid out like WordNode::length_mask,
+        /// so that a node without any word of these lengths below it can be skipped.
+        uint32_t remaining_lengths(StateSet states, size_t length) const noexcept {
+            if (length > max_length) {
+                return 0;
+            }
+
+            uint32_t lengths = 0;
+            for (auto rest = states; rest != 0; rest &= rest - 1) {
+                lengths |= state_lengths[static_cast<size_t>(std::countr_zero(rest))];
+            }
+
+            auto min_rest = min_length > length ? min_length - length : 0;
+            auto max_rest = max_length == unbounded ? unbounded : max_length - length;
+            return lengths & length_range(min_rest, max_rest);
+        }
+
+        /// The only symbol the states can consume, or the wildcard if there are more of them.
+        /// A single symbol can be looked up among the children, instead of trying them all.
+        Symbol only_symbol(StateSet states) const noexcept {
+            auto symbol = locale::wildcard;
+            for (auto rest = states & ~final_state; rest != 0; rest &= rest - 1) {
+                auto single = single_symbols[static_cast<size_t>(std::countr_zero(rest))];
+                auto conflicting = symbol != locale::wildcard && single != symbol;
+                if (single == locale::wildcard || conflicting) {
+                    return locale::wildcard;
+                }
+                symbol = single;
+            }
+            return symbol;
+        }
+
+        /// Checks whether the symbols matched in a trie are enough to tell a match.
+        /// If not, the pattern lists letters outside of the alphabet,
+        /// and the matched words have to be verified (see matches).
+        bool exact() const noexcept {
+            return is_exact;
+        }
+
+        /// Checks whether a word matches the pattern, comparing case-folded codepoints.
+        bool matches(std::u8string_view word) const {
+            auto states = initial;
+            size_t length = 0;
+
+            auto it = word.data();
+            auto end = it + word.length();
+            while (it < end && states != 0) {
+                auto codepoint = utils::decode_codepoint(it, end);
+                auto symbol = Alphabet::to_symbol(codepoint);
+                auto consumed = symbol != locale::unknown
+                                    ? consumers[symbol]
+                                    : unknown_consumers(utils::fold_case(codepoint));
+                states = advance(states & consumed);
+                ++length;
+            }
+
+            return it == end && accepts(states, length);
+        }
+
+        /// Looks up a page of words matching the pattern, like Alphabet::lookup does.
+        /// @param find Function taking the compiled pattern, the result vector, the limit
+        ///             and the symbols of the word to resume after (or an empty vector).
+        /// @details The cursor holds the symbols of the last word of the previous page,
+        /// whatever its length. Malformed patterns do not match anything.
+        template <typename F>
+        static std::vector<std::u8string_view> lookup(const std::u8string& source,
+                                                      const size_t max_results,
+                                                      const std::vector<Symbol>& cursor,
+                                                      std::vector<Symbol>* next_cursor,
+                                                      F&& find) {
+            std::vector<std::u8string_view> results;
+
+            CompiledPattern pattern;
+            if (!compile(source, pattern)) [[unlikely]] {
+                utils::log::tag("CompiledPattern").w("Malformed pattern");
+                if (next_cursor != nullptr) {
+                    next_cursor->clear();
+                }
+                return results;
+            }
+
+            auto limit = std::min(max_results, static_cast<size_t>(INT32_MAX - 1));
+            if (next_cursor != nullptr) {
+                ++limit;
+            }
+
+            if (pattern.exact()) [[likely]] {
+                find(pattern, results, limit, cursor);
+            } else {
+                find(pattern, results, static_cast<size_t>(INT32_MAX), cursor);
+                std::erase_if(results, [&](const auto& word) { return !pattern.matches(word); });
+            }
+
+            Alphabet::trim_page(results, max_results, cursor, next_cursor);
+            return results;
+        }
+
+        template <typename F>
+        static std::vector<std::u8string_view>
+        lookup(const std::u8string& source, const size_t max_results, F&& find) {
+            return lookup(source, max_results, {}, nullptr, std::forward<F>(find));
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_PATTERN_HPP
@@ -0,0 +1,411 @@
+#ifndef CROSSWORD_HELPER_POSITIONAL_INDEX_HPP
+#define CROSSWORD_HELPER_POSITIONAL_INDEX_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/cancellation.hpp"
+#include "../utils/thread_pool.hpp"
+#include "word_index.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace crossword::indexing {
+
+    using ::crossword::locale::Symbol;
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
+
+    namespace detail {
+
+        /// Dense bitmaps are padded to a multiple of this many words,
+        /// so that and_bitmaps can always load a whole block.
+        constexpr size_t bitmap_padding_words = 4;
+
+#if defined(__AVX2__)
+        /// How many 64-bit words does and_bitmaps combine at once?
+        constexpr size_t bitmap_block_words = 4;
+
+        /// Intersects a block of bitmap_block_words words of several bitmaps.
+        inline void and_bitmaps(const uint64_t* const* bitmaps,
+                                size_t count,
+                                size_t word,
+                                uint64_t* out) {
+            auto load = [&](size_t i) {
+                return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bitmaps[i] + word));
+            };
+            auto block = load(0);
+            for (size_t i = 1; i < count; ++i) {
+                block = _mm256_and_si256(block, load(i));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), block);
+        }
+#elif defined(__SSE2__)
+        constexpr size_t bitmap_block_words = 2;
+
+        inline void and_bitmaps(const uint64_t* const* bitmaps,
+                                size_t count,
+                                size_t word,
+                                uint64_t* out) {
+            auto load = [&](size_t i) {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bitmaps[i] + word));
+            };
+            auto block = load(0);
+            for (size_t i = 1; i < count; ++i) {
+                block = _mm_and_si128(block, load(i));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), block);
+        }
+#elif defined(__ARM_NEON)
+        constexpr size_t bitmap_block_words = 2;
+
+        inline void and_bitmaps(const uint64_t* const* bitmaps,
+                                size_t count,
+                                size_t word,
+                                uint64_t* out) {
+            auto block = vld1q_u64(bitmaps[0] + word);
+            for (size_t i = 1; i < count; ++i) {
+                block = vandq_u64(block, vld1q_u64(bitmaps[i] + word));
+            }
+            vst1q_u64(out, block);
+        }
+#else
+        // No vector instructions, a word at a time
+        constexpr size_t bitmap_block_words = 1;
+
+        inline void and_bitmaps(const uint64_t* const* bitmaps,
+                                size_t count,
+                                size_t word,
+                                uint64_t* out) {
+            auto block = bitmaps[0][word];
+            for (size_t i = 1; i < count; ++i) {
+                block &= bitmaps[i][word];
+            }
+            *out = block;
+        }
+#endif
+
+        static_assert(bitmap_padding_words % bitmap_block_words == 0);
+    }
+
+    /// Sets of words by their letters at every position, for every word length.
+    /// A pattern of letters and wildcards is the intersection of the sets of its letters,
+    /// so its cost depends on how many letters are known, not on where the wildcards are.
+    /// That is where a trie struggles: .a.o.e.. fans out over every first letter, and so on.
+    /// @details Words of the same length are numbered in the order of their symbols,
+    /// so the results come in the same order as from a forward trie.
+    /// A set is either a sorted array of word numbers or a bitmap of all the words
+    /// of its length, whichever is smaller. Bitmaps are intersected a vector at a time,
+    /// arrays drive the intersection if any of them is involved.
+    /// Like SuffixTrie, it refers to the words of a StringPool owned by someone else.
+    /// @tparam Alphabet The locale::Alphabet the words are keyed by.
+    template <typename Alphabet>
+    class PositionalIndex final {
+    private:
+        /// Words of a single length containing a letter at a position.
+        struct WordSet {
+            /// Offset of the set in the bitmaps or the ids of its group.
+            uint32_t offset;
+            /// Number of words in the set.
+            uint32_t count;
+            bool dense;
+        };
+
+        /// Words of a single length and the sets of their letters.
+        struct LengthGroup {
+            /// Words by their numbers, in the order of their symbols.
+            std::vector<StringHandle> words;
+            /// Sets of every symbol at every position, see set_index.
+            std::vector<WordSet> sets;
+            /// Words of every dense set, bitmap_words words each.
+            std::vector<uint64_t> bitmaps;
+            /// Words of every sparse set, in ascending order.
+            std::vector<uint32_t> ids;
+            /// Length of a bitmap of this group, padded to detail::bitmap_padding_words.
+            size_t bitmap_words = 0;
+        };
+
+        /// Number of distinct symbols a word can have. Unknown ones go after all the letters.
+        static constexpr size_t symbol_count = Alphabet::size + 1;
+
+        /// Groups of words by their length in symbols.
+        std::vector<LengthGroup> groups;
+
+        static constexpr size_t set_index(size_t position, Symbol symbol) noexcept {
+            return position * symbol_count + std::min<size_t>(symbol, symbol_count) - 1;
+        }
+
+        /// Numbers and indexes the words of a single length.
+        /// @param handles Words of the length, in the order of the pool.
+        static void build_group(LengthGroup& group,
+                                size_t length,
+                                const std::vector<StringHandle>& handles,
+                                const StringPool& words) {
+            std::vector<Symbol> symbols;
+            std::vector<Symbol> word;
+            symbols.reserve(handles.size() * length);
+            for (auto handle : handles) {
+                Alphabet::encode_word(words.get(handle), word);
+                symbols.insert(symbols.end(), word.begin(), word.end());
+            }
+
+            auto word_symbols = [&](size_t i) { return symbols.begin() + i * length; };
+            std::vector<uint32_t> order(handles.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return std::lexicographical_compare(word_symbols(a), word_symbols(a) + length,
+                                                    word_symbols(b), word_symbols(b) + length);
+            });
+
+            // Words spelled the same keep the last one, like in a trie
+            std::vector<uint32_t> unique;
+            for (size_t i = 0; i < order.size(); ++i) {
+                auto next = i + 1;
+                if (next < order.size()
+                    && std::equal(word_symbols(order[i]), word_symbols(order[i]) + length,
+                                  word_symbols(order[next]))) {
+                    continue;
+                }
+                unique.push_back(order[i]);
+            }
+
+            group.words.resize(unique.size());
+            group.sets.assign(length * symbol_count, {0, 0, false});
+            for (size_t id = 0; id < unique.size(); ++id) {
+                group.words[id] = handles[unique[id]];
+                for (size_t position = 0; position < length; ++position) {
+                    ++group.sets[set_index(position, word_symbols(unique[id])[position])].count;
+                }
+            }
+
+            auto padding = detail::bitmap_padding_words;
+            group.bitmap_words = (unique.size() + 63) / 64;
+            group.bitmap_words = (group.bitmap_words + padding - 1) / padding * padding;
+
+            size_t bitmap_count = 0;
+            size_t id_count = 0;
+            for (auto& set : group.sets) {
+                auto sparse_bytes = set.count * sizeof(uint32_t);
+                set.dense = sparse_bytes >= group.bitmap_words * sizeof(uint64_t);
+                if (set.dense) {
+                    set.offset = static_cast<uint32_t>(bitmap_count++ * group.bitmap_words);
+                } else {
+                    set.offset = static_cast<uint32_t>(id_count);
+                    id_count += set.count;
+                }
+            }
+
+            group.bitmaps.assign(bitmap_count * group.bitmap_words, 0);
+            group.ids.resize(id_count);
+            std::vector<uint32_t> filled(group.sets.size(), 0);
+            for (size_t id = 0; id < unique.size(); ++id) {
+                for (size_t position = 0; position < length; ++position) {
+                    auto index = set_index(position, word_symbols(unique[id])[position]);
+                    const auto& set = group.sets[index];
+                    if (set.dense) {
+                        group.bitmaps[set.offset + id / 64] |= uint64_t{1} << (id % 64);
+                    } else {
+                        group.ids[set.offset + filled[index]++] = static_cast<uint32_t>(id);
+                    }
+                }
+            }
+        }
+
+        /// Finds the number of the first word after the provided symbols.
+        static uint32_t first_after(const LengthGroup& group,
+                                    const Symbol* after,
+                                    size_t length,
+                                    const StringPool& words) {
+            std::vector<Symbol> symbols;
+            auto begin = group.words.begin();
+            auto it = std::upper_bound(begin, group.words.end(), after,
+                                       [&](const Symbol* key, StringHandle handle) {
+                                           Alphabet::encode_word(words.get(handle), symbols);
+                                           return std::lexicographical_compare(
+                                               key, key + length, symbols.begin(), symbols.end());
+                                       });
+            return static_cast<uint32_t>(it - begin);
+        }
+
+        /// Pushes the words of the intersection of sparse sets (the first one being
+        /// the smallest) and dense bitmaps, starting with the first number.
+        static void intersect_sparse(std::vector<std::u8string_view>& vec,
+                                     const LengthGroup& group,
+                                     const std::vector<const WordSet*>& sets,
+                                     uint32_t first,
+                                     size_t limit,
+                                     const StringPool& words,
+                                     const utils::CancellationToken* cancellation) {
+            auto ids_of = [&](const WordSet* set) { return group.ids.data() + set->offset; };
+            std::vector<const uint32_t*> cursors;
+            for (auto set : sets) {
+                cursors.push_back(set->dense ? nullptr : ids_of(set));
+            }
+
+            auto driver_end = ids_of(sets[0]) + sets[0]->count;
+            auto driver = std::lower_bound(ids_of(sets[0]), driver_end, first);
+            for (; driver != driver_end && vec.size() < limit; ++driver) {
+                if (utils::CancellationToken::is_cancelled(cancellation)) {
+                    return;
+                }
+
+                auto id = *driver;
+                auto matches = true;
+                for (size_t i = 1; i < sets.size() && matches; ++i) {
+                    auto set = sets[i];
+                    if (set->dense) {
+                        auto word = group.bitmaps[set->offset + id / 64];
+                        matches = (word >> (id % 64)) & 1;
+                    } else {
+                        auto end = ids_of(set) + set->count;
+                        cursors[i] = std::lower_bound(cursors[i], end, id);
+                        matches = cursors[i] != end && *cursors[i] == id;
+                    }
+                }
+
+                if (matches) {
+                    vec.push_back(words.get(group.words[id]));
+                }
+            }
+        }
+
+        /// Pushes the words of the intersection of dense bitmaps, starting with the first number.
+        static void intersect_dense(std::vector<std::u8string_view>& vec,
+                                    const LengthGroup& group,
+                                    const std::vector<const WordSet*>& sets,
+                                    uint32_t first,
+                                    size_t limit,
+                                    const StringPool& words,
+                                    const utils::CancellationToken* cancellation) {
+            std::vector<const uint64_t*> bitmaps;
+            for (auto set : sets) {
+                bitmaps.push_back(group.bitmaps.data() + set->offset);
+            }
+
+            constexpr auto block_words = detail::bitmap_block_words;
+            uint64_t block[block_words];
+            size_t start = first / 64 / block_words * block_words;
+            for (auto word = start; word < group.bitmap_words; word += block_words) {
+                if (utils::CancellationToken::is_cancelled(cancellation)) {
+                    return;
+                }
+
+                detail::and_bitmaps(bitmaps.data(), bitmaps.size(), word, block);
+                for (size_t i = 0; i < block_words; ++i) {
+                    auto base = (word + i) * 64;
+                    auto bits = block[i];
+                    if (base + 64 <= first) {
+                        continue;
+                    }
+                    if (base < first) {
+                        bits &= ~uint64_t{0} << (first - base);
+                    }
+
+                    while (bits != 0) {
+                        auto id = base + static_cast<size_t>(std::countr_zero(bits));
+                        vec.push_back(words.get(group.words[id]));
+                        if (vec.size() >= limit) {
+                            return;
+                        }
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+    public:
+
+        /// Indexes all the words of a pool, replacing whatever was indexed before.
+        /// @details Every word length gets indexed on its own, on the shared thread pool.
+        void build(const StringPool& words) {
+            std::vector<std::vector<StringHandle>> by_length;
+            std::vector<Symbol> symbols;
+            words.for_each([&](StringHandle handle, std::u8string_view word) {
+                Alphabet::encode_word(word, symbols);
+                auto length = symbols.size();
+                if (by_length.size() <= length) {
+                    by_length.resize(length + 1);
+                }
+                by_length[length].push_back(handle);
+            });
+
+            groups.clear();
+            groups.resize(by_length.size());
+            utils::ThreadPool::shared().parallel_for(groups.size(), [&](size_t length) {
+                build_group(groups[length], length, by_length[length], words);
+            });
+        }
+
+        /// Finds words matching a pattern of letters and wildcards, in the order of a trie.
+        /// @param after Symbols of the word to resume after, or null.
+        /// @param cancellation Stops the search once cancelled, or null.
+        void find_words(std::vector<std::u8string_view>& vec,
+                        const std::vector<Symbol>& pattern,
+                        const size_t limit,
+                        const StringPool& words,
+                        const Symbol* after,
+                        const utils::CancellationToken* cancellation = nullptr) const {
+            auto length = pattern.size();
+            if (length >= groups.size() || vec.size() >= limit) {
+                return;
+            }
+
+            const auto& group = groups[length];
+            auto first = after != nullptr ? first_after(group, after, length, words) : 0;
+
+            std::vector<const WordSet*> sets;
+            for (size_t position = 0; position < length; ++position) {
+                if (pattern[position] == locale::wildcard) {
+                    continue;
+                }
+                const auto& set = group.sets[set_index(position, pattern[position])];
+                if (set.count == 0) {
+                    return;
+                }
+                sets.push_back(&set);
+            }
+
+            if (sets.empty()) {
+                for (auto id = first; id < group.words.size() && vec.size() < limit; ++id) {
+                    if (utils::CancellationToken::is_cancelled(cancellation)) {
+                        return;
+                    }
+                    vec.push_back(words.get(group.words[id]));
+                }
+                return;
+            }
+
+            // Sparse sets are smaller than the dense ones, so the smallest set drives
+            std::sort(sets.begin(), sets.end(),
+                      [](const WordSet* a, const WordSet* b) { return a->count < b->count; });
+            if (sets[0]->dense) {
+                intersect_dense(vec, group, sets, first, limit, words, cancellation);
+            } else {
+                intersect_sparse(vec, group, sets, first, limit, words, cancellation);
+            }
+        }
+
+        /// Adds the memory taken by the sets to the stats of the index they belong to.
+        void add_memory_stats(MemoryStats& stats) const {
+            stats.other_bytes += groups.capacity() * sizeof(LengthGroup);
+            for (const auto& group : groups) {
+                stats.other_bytes += group.words.capacity() * sizeof(StringHandle)
+                                     + group.sets.capacity() * sizeof(WordSet)
+                                     + group.bitmaps.capacity() * sizeof(uint64_t)
+                                     + group.ids.capacity() * sizeof(uint32_t);
+            }
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_POSITIONAL_INDEX_HPP
@@ -0,0 +1,582 @@
+#ifndef CROSSWORD_HELPER_PREBUILT_HPP
+#define CROSSWORD_HELPER_PREBUILT_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/log.hpp"
+#include "../word_node.hpp"
+#include "pattern.hpp"
+#include "word_index.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::locale::Symbol;
+
+    /// Layout of a prebuilt, pointer-free missing letters index.
+    /// @details The whole index is a single blob that can be mapped straight from a file.
+    /// Every reference inside of it is an offset, so it does not need any fix-ups after loading.
+    /// Nodes are stored in breadth-first order, with the root at index 0.
+    /// Node children are stored in a compressed sparse row layout:
+    /// the edges of node n are [nodes[n].first_edge, nodes[n + 1].first_edge),
+    /// sorted by their keys. The node table has one extra sentinel entry for that purpose.
+    /// Edge keys are symbols of the alphabet recorded in the header.
+    namespace prebuilt {
+
+        static_assert(std::endian::native == std::endian::little,
+                      "Prebuilt indexes are stored in little endian byte order");
+
+        constexpr char magic[4] = {'X', 'W', 'D', 'I'};
+        constexpr uint32_t version = 3;
+
+        /// Marks a node that does not represent a valid word.
+        constexpr uint32_t no_word = UINT32_MAX;
+
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            /// Identifier of the alphabet the edge keys are symbols of.
+            uint32_t alphabet;
+            /// Number of nodes, not counting the sentinel.
+            uint32_t node_count;
+            uint32_t edge_count;
+            /// Offset of the node table, Node[node_count + 1].
+            uint32_t nodes_offset;
+            /// Offset of the edge target table, uint32_t[edge_count].
+            uint32_t edge_targets_offset;
+            /// Offset of the edge key table, uint8_t[edge_count].
+            uint32_t edge_keys_offset;
+            /// Offset of the word table.
+            /// Each word is stored as a single length byte followed by its UTF-8 bytes.
+            uint32_t words_offset;
+            uint32_t words_size;
+            /// Total size of the blob, in bytes.
+            uint32_t total_size;
+        };
+
+        struct Node {
+            /// Offset of the word in the word table, or no_word.
+            uint32_t word;
+            /// Index of the first outgoing edge.
+            uint32_t first_edge;
+            /// Lengths of the words in the subtree of the node (see WordNode::length_bit).
+            uint32_t length_mask;
+        };
+
+        static_assert(sizeof(Header) == 44, "Prebuilt index header must be 44 bytes in size");
+        static_assert(sizeof(Node) == 12, "Prebuilt index node must be 12 bytes in size");
+
+        /// Rounds the offset up to the next multiple of 4.
+        constexpr size_t align4(size_t offset) {
+            return (offset + 3) & ~static_cast<size_t>(3);
+        }
+
+        /// Serializes a trie into the prebuilt format.
+        /// @param root Root node of the trie. The trie must not be minimized nor compressed.
+        /// @param arenas Arenas the nodes of the trie are resolved from.
+        /// @param pool Words of the trie. It has the layout of the word table already,
+        /// so it gets copied as a whole.
+        /// @param alphabet Identifier of the alphabet the trie is keyed by.
+        /// @returns The serialized blob, or an empty vector if the trie is too big to serialize.
+        inline std::vector<uint8_t> serialize(WordNode* root,
+                                              const TrieArenas& arenas,
+                                              const memory::StringPool& pool,
+                                              uint32_t alphabet) {
+            auto logger = utils::log::tag("prebuilt");
+
+            // Nodes of a minimized trie do not point to their own words.
+            // Nodes of a scored trie share the field with their highest scores,
+            // which the prebuilt format has no room for either
+            if (root->word_count > 0) {
+                logger.w("Minimized or scored tries cannot be serialized");
+                return {};
+            }
+
+            std::vector<WordNode*> queue{root};
+            std::vector<Node> nodes;
+            std::vector<uint32_t> edge_targets;
+            std::vector<uint8_t> edge_keys;
+            std::vector<std::pair<uint8_t, NodeIndex>> children;
+
+            // Number the nodes in breadth-first order.
+            // Children are numbered as soon as their parent is visited,
+            // so the edge ranges end up increasing together with node indexes
+            for (size_t i = 0; i < queue.size(); ++i) {
+                auto node = queue[i];
+
+                // The format has one letter per edge
+                if (node->label[0] != 0) [[unlikely]] {
+                    logger.w("Compressed tries cannot be serialized");
+                    return {};
+                }
+
+                auto word = no_word;
+                if (node->valid()) {
+                    word = static_cast<uint32_t>(node->valid_word - pool.begin_offset());
+                }
+
+                nodes.push_back(
+                    {word, static_cast<uint32_t>(edge_targets.size()), node->length_mask});
+
+                children.clear();
+                for (const auto& entry : node->children.entries(&arenas.chunks)) {
+                    children.push_back(entry);
+                }
+                std::sort(children.begin(), children.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                for (const auto& [key, child] : children) {
+                    edge_keys.push_back(key);
+                    edge_targets.push_back(static_cast<uint32_t>(queue.size()));
+                    queue.push_back(arenas.node(child));
+                }
+            }
+
+            // Sentinel, so that the edge range of the last node can be calculated
+            nodes.push_back({no_word, static_cast<uint32_t>(edge_targets.size()), 0});
+
+            auto nodes_offset = align4(sizeof(Header));
+            auto edge_targets_offset = nodes_offset + nodes.size() * sizeof(Node);
+            auto edge_keys_offset = edge_targets_offset + edge_targets.size() * sizeof(uint32_t);
+            auto words_offset = edge_keys_offset + edge_keys.size();
+            auto total_size = align4(words_offset + pool.size_bytes());
+            if (total_size > UINT32_MAX) [[unlikely]] {
+                logger.w("Index too big to serialize: %zu bytes", total_size);
+                return {};
+            }
+
+            Header header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.alphabet = alphabet;
+            header.node_count = static_cast<uint32_t>(nodes.size() - 1);
+            header.edge_count = static_cast<uint32_t>(edge_targets.size());
+            header.nodes_offset = static_cast<uint32_t>(nodes_offset);
+            header.edge_targets_offset = static_cast<uint32_t>(edge_targets_offset);
+            header.edge_keys_offset = static_cast<uint32_t>(edge_keys_offset);
+            header.words_offset = static_cast<uint32_t>(words_offset);
+            header.words_size = static_cast<uint32_t>(pool.size_bytes());
+            header.total_size = static_cast<uint32_t>(total_size);
+
+            std::vector<uint8_t> blob(total_size, 0);
+            std::memcpy(blob.data(), &header, sizeof(Header));
+            std::memcpy(blob.data() + nodes_offset, nodes.data(), nodes.size() * sizeof(Node));
+            std::memcpy(blob.data() + edge_targets_offset, edge_targets.data(),
+                        edge_targets.size() * sizeof(uint32_t));
+            std::memcpy(blob.data() + edge_keys_offset, edge_keys.data(), edge_keys.size());
+            std::memcpy(blob.data() + words_offset, pool.data(), pool.size_bytes());
+
+            logger.i("Serialized %u nodes and %u edges into %zu bytes", header.node_count,
+                     header.edge_count, total_size);
+            return blob;
+        }
+    }
+
+    /// A read-only missing letters index that serves lookups straight from a prebuilt blob.
+    /// @details Loading does not parse or copy anything, it only validates the header
+    /// and the references inside the tables.
+    /// The buffer has to outlive the index; use retain() to tie its owner to the index.
+    /// @tparam Alphabet The locale::Alphabet the blob has been built with.
+    template <typename Alphabet>
+    class BasicPrebuiltIndex final : public WordIndex {
+    public:
+        using alphabet_type = Alphabet;
+        using pattern_type = CompiledPattern<Alphabet>;
+
+    private:
+        const prebuilt::Header* header;
+        const prebuilt::Node* nodes;
+        const uint32_t* edge_targets;
+        const uint8_t* edge_keys;
+        const uint8_t* words;
+
+        /// Returns a view of a word in the word table.
+        inline std::u8string_view word_at(uint32_t offset) const {
+            auto length = words[offset];
+            auto chars = reinterpret_cast<const char8_t*>(words + offset + 1);
+            return std::u8string_view(chars, length);
+        }
+
+        /// Finds the child of the node following an edge with the provided key.
+        /// @returns Index of the child node, or 0 if there is no such edge.
+        inline uint32_t find_child(uint32_t node, uint8_t key) const noexcept {
+            auto first = edge_keys + nodes[node].first_edge;
+            auto last = edge_keys + nodes[node + 1].first_edge;
+            auto it = std::lower_bound(first, last, key);
+            if (it == last || *it != key) {
+                return 0;
+            }
+            return edge_targets[it - edge_keys];
+        }
+
+        /// Find words matching a provided pattern.
+        /// This mirrors WordNode::find_words, but walks the prebuilt node table.
+        void find_words(std::vector<std::u8string_view>& vec,
+                        const std::vector<Symbol>& pattern,
+                        const uint32_t node,
+                        const size_t index,
+                        const size_t limit,
+                        const Symbol* after,
+                        const utils::CancellationToken* cancellation) const {
+            // The result vector is full, or nobody waits for it anymore
+            if (limit <= vec.size() || utils::CancellationToken::is_cancelled(cancellation)) {
+                return;
+            }
+
+            // No word of the pattern's length down there? Do not even look
+            if ((nodes[node].length_mask & WordNode::length_bit(pattern.size() - index)) == 0) {
+                return;
+            }
+
+            // We have reached the end of the pattern!
+            // If this node represents a valid word, add it to the result vector
+            // (unless it is the very word to resume after)
+            if (index == pattern.size()) {
+                if (nodes[node].word != prebuilt::no_word && after == nullptr) {
+                    vec.push_back(word_at(nodes[node].word));
+                }
+                return;
+            }
+
+            auto symbol = pattern[index];
+            if (symbol == locale::wildcard) {
+                auto first_edge = nodes[node].first_edge;
+                auto last_edge = nodes[node + 1].first_edge;
+
+                // Edges are sorted, so skip straight to the path of the cursor
+                if (after != nullptr) {
+                    auto first = edge_keys + first_edge;
+                    auto last = edge_keys + last_edge;
+                    auto it = std::lower_bound(first, last, after[index]);
+                    first_edge = static_cast<uint32_t>(it - edge_keys);
+                    if (it != last && *it == after[index]) {
+                        find_words(vec, pattern, edge_targets[first_edge], index + 1, limit,
+                                   after, cancellation);
+                        ++first_edge;
+                    }
+                }
+
+                for (auto edge = first_edge; edge < last_edge; ++edge) {
+                    find_words(vec, pattern, edge_targets[edge], index + 1, limit, nullptr,
+                               cancellation);
+                }
+                return;
+            }
+
+            if (after != nullptr && symbol != after[index]) {
+                if (symbol < after[index]) {
+                    return;
+                }
+                after = nullptr;
+            }
+
+            auto child = find_child(node, symbol);
+            if (child != 0) {
+                find_words(vec, pattern, child, index + 1, limit, after, cancellation);
+            }
+        }
+
+        /// Find words accepted by a compiled pattern.
+        /// This mirrors WordNode::match, but walks the prebuilt node table.
+        void match_words(std::vector<std::u8string_view>& vec,
+                         const pattern_type& pattern,
+                         const typename pattern_type::StateSet states,
+                         const uint32_t node,
+                         const size_t length,
+                         const size_t limit,
+                         const std::vector<Symbol>* after,
+                         const utils::CancellationToken* cancellation) const {
+            if (limit <= vec.size() || utils::CancellationToken::is_cancelled(cancellation)) {
+                return;
+            }
+
+            if ((nodes[node].length_mask & pattern.remaining_lengths(states, length)) == 0) {
+                return;
+            }
+
+            // On the path of the cursor, this is either the cursor word or one of its prefixes
+            if (nodes[node].word != prebuilt::no_word && after == nullptr
+                && pattern.accepts(states, length)) {
+                vec.push_back(word_at(nodes[node].word));
+            }
+
+            if (after != nullptr && length == after->size()) {
+                after = nullptr;
+            }
+
+            auto only = pattern.only_symbol(states);
+            if (only != locale::wildcard) {
+                if (after != nullptr && only != (*after)[length]) {
+                    if (only < (*after)[length]) {
+                        return;
+                    }
+                    after = nullptr;
+                }
+
+                auto child = find_child(node, only);
+                if (child != 0) {
+                    match_words(vec, pattern, pattern.step(states, only), child, length + 1,
+                                limit, after, cancellation);
+                }
+                return;
+            }
+
+            auto first_edge = nodes[node].first_edge;
+            auto last_edge = nodes[node + 1].first_edge;
+
+            // Edges are sorted, so skip straight to the path of the cursor
+            if (after != nullptr) {
+                auto first = edge_keys + first_edge;
+                auto last = edge_keys + last_edge;
+                auto it = std::lower_bound(first, last, (*after)[length]);
+                first_edge = static_cast<uint32_t>(it - edge_keys);
+                if (it != last && *it == (*after)[length]) {
+                    auto next_states = pattern.step(states, *it);
+                    if (next_states != 0) {
+                        match_words(vec, pattern, next_states, edge_targets[first_edge],
+                                    length + 1, limit, after, cancellation);
+                    }
+                    ++first_edge;
+                }
+            }
+
+            for (auto edge = first_edge; edge < last_edge; ++edge) {
+                auto next_states = pattern.step(states, edge_keys[edge]);
+                if (next_states != 0) {
+                    match_words(vec, pattern, next_states, edge_targets[edge], length + 1, limit,
+                                nullptr, cancellation);
+                }
+            }
+        }
+
+        /// Checks that every reference inside the tables stays within the blob, in a single pass,
+        /// so that lookups do not have to. The header has been checked already.
+        /// @details Edges have to lead to nodes numbered after their sources, as they are in
+        /// breadth-first order, so walks always end. No path can be longer than a word can,
+        /// so they do not recurse any deeper than lookups of a built index do.
+        static bool validate_tables(const prebuilt::Header& header, const uint8_t* data) {
+            auto table_nodes = reinterpret_cast<const prebuilt::Node*>(data + header.nodes_offset);
+            auto table_targets = reinterpret_cast<const uint32_t*>(data
+                                                                   + header.edge_targets_offset);
+            auto table_keys = data + header.edge_keys_offset;
+            auto table_words = data + header.words_offset;
+
+            if (table_nodes[0].first_edge != 0
+                || table_nodes[header.node_count].first_edge != header.edge_count) {
+                return false;
+            }
+
+            std::vector<uint8_t> depths(header.node_count, 0);
+            for (uint32_t node = 0; node < header.node_count; ++node) {
+                auto first_edge = table_nodes[node].first_edge;
+                auto last_edge = table_nodes[node + 1].first_edge;
+                if (first_edge > last_edge) {
+                    return false;
+                }
+
+                auto word = table_nodes[node].word;
+                if (word != prebuilt::no_word
+                    && (word >= header.words_size
+                        || size_t{word} + 1 + table_words[word] > header.words_size)) {
+                    return false;
+                }
+
+                for (auto edge = first_edge; edge < last_edge; ++edge) {
+                    auto target = table_targets[edge];
+                    if (target <= node || target >= header.node_count
+                        || depths[node] >= memory::StringPool::max_length
+                        || (edge > first_edge && table_keys[edge - 1] >= table_keys[edge])) {
+                        return false;
+                    }
+                    auto depth = static_cast<uint8_t>(depths[node] + 1);
+                    depths[target] = std::max(depths[target], depth);
+                }
+            }
+            return true;
+        }
+
+        /// Creates a symbol-based search function for Alphabet::lookup.
+        auto finder(const utils::CancellationToken* cancellation) const {
+            return [this, cancellation](const auto& pattern, auto& results, size_t limit,
+                                        const Symbol* after) {
+                if (valid()) {
+                    find_words(results, pattern, 0, 0, limit, after, cancellation);
+                }
+            };
+        }
+
+        /// Creates an automaton-based search function for CompiledPattern::lookup.
+        auto matcher(const utils::CancellationToken* cancellation) const {
+            return [this, cancellation](const pattern_type& pattern, auto& results, size_t limit,
+                                        const std::vector<Symbol>& cursor) {
+                if (valid()) {
+                    auto after = cursor.empty() ? nullptr : &cursor;
+                    match_words(results, pattern, pattern.start(), 0, 0, limit, after,
+                                cancellation);
+                }
+            };
+        }
+
+        /// Looks up a page of words, picking the search function the pattern needs.
+        std::vector<std::u8string_view> find(const std::u8string& input,
+                                             const size_t max_results,
+                                             const std::vector<Symbol>& cursor,
+                                             std::vector<Symbol>* next_cursor,
+                                             const utils::CancellationToken* cancellation) const {
+            if (is_extended_pattern(input)) {
+                return pattern_type::lookup(input, max_results, cursor, next_cursor,
+                                            matcher(cancellation));
+            }
+            return Alphabet::lookup(input, max_results, cursor, next_cursor,
+                                    finder(cancellation));
+        }
+
+    public:
+        BasicPrebuiltIndex() :
+            header(nullptr),
+            nodes(nullptr),
+            edge_targets(nullptr),
+            edge_keys(nullptr),
+            words(nullptr) {}
+
+        ~BasicPrebuiltIndex() = default;
+
+        /// Checks whether a valid blob has been loaded.
+        constexpr inline bool valid() const noexcept {
+            return header != nullptr;
+        }
+
+        /// Prebuilt indexes are immutable and cannot be merged.
+        virtual bool merge([[maybe_unused]] WordIndex* other) override {
+            return false;
+        }
+
+        /// Returns the set of words that match the provided pattern.
+        /// The pattern is assumed to be a string of UTF-8 characters,
+        /// where a dot . (0x2E) is considered to be any character.
+        /// Sets of letters, runs and length bounds are supported too (see CompiledPattern).
+        /// @result The set of words that match the pattern.
+        /// @param input The pattern to match.
+        /// @param max_results The maximum number of results to return.
+        virtual std::vector<std::u8string> lookup(const std::u8string& input,
+                                                  const size_t max_results) const override {
+            auto words = find(input, max_results, {}, nullptr, nullptr);
+            return {words.begin(), words.end()};
+        }
+
+        /// Returns a page of words that match the provided pattern, in alphabetical order.
+        virtual LookupPage lookup_page(const std::u8string& input,
+                                       const size_t max_results,
+                                       const std::vector<uint8_t>& cursor,
+                                       const utils::CancellationToken* cancellation = nullptr)
+            const override {
+            LookupPage page;
+            page.words = find(input, max_results, cursor, &page.cursor, cancellation);
+            return page;
+        }
+
+        /// Reports how much memory this index takes and what takes it.
+        /// All of it is the mapped blob, which has no arenas.
+        virtual MemoryStats memory_stats() const override {
+            MemoryStats stats;
+            if (!valid()) {
+                return stats;
+            }
+
+            stats.other_bytes = header->total_size;
+            stats.node_count = header->node_count;
+            for (uint32_t node = 0; node < header->node_count; ++node) {
+                auto children = static_cast<size_t>(nodes[node + 1].first_edge
+                                                    - nodes[node].first_edge);
+                if (stats.fan_out.size() <= children) {
+                    stats.fan_out.resize(children + 1, 0);
+                }
+                ++stats.fan_out[children];
+                stats.word_count += nodes[node].word != prebuilt::no_word ? 1 : 0;
+            }
+            return stats;
+        }
+
+        /// Attaches the index to a prebuilt blob. Nothing gets copied.
+        /// If the blob is malformed, the index stays invalid (see validate_tables).
+        /// @param buffer Pointer to the data buffer, aligned to at least 4 bytes.
+        /// @param start Index the blob starts at.
+        /// @param end Exclusive end index of the blob.
+        virtual void
+        load_from_buffer(const uint8_t* buffer, const size_t start, const size_t end) override {
+            auto logger = utils::log::tag("PrebuiltIndex");
+            auto data = buffer + start;
+            auto length = end - start;
+
+            if (reinterpret_cast<uintptr_t>(data) % alignof(prebuilt::Header) != 0) {
+                logger.w("Prebuilt index buffer is misaligned");
+                return;
+            }
+
+            if (length < sizeof(prebuilt::Header)) {
+                logger.w("Prebuilt index is too short: %zu bytes", length);
+                return;
+            }
+
+            auto candidate = reinterpret_cast<const prebuilt::Header*>(data);
+            if (std::memcmp(candidate->magic, prebuilt::magic, sizeof(prebuilt::magic)) != 0
+                || candidate->version != prebuilt::version) {
+                logger.w("Unknown prebuilt index format");
+                return;
+            }
+
+            if (candidate->alphabet != Alphabet::id) {
+                logger.w("Prebuilt index uses a different alphabet");
+                return;
+            }
+
+            auto nodes_end = static_cast<uint64_t>(candidate->nodes_offset)
+                             + (static_cast<uint64_t>(candidate->node_count) + 1)
+                                   * sizeof(prebuilt::Node);
+            auto targets_end = static_cast<uint64_t>(candidate->edge_targets_offset)
+                               + static_cast<uint64_t>(candidate->edge_count) * sizeof(uint32_t);
+            auto keys_end = static_cast<uint64_t>(candidate->edge_keys_offset)
+                            + candidate->edge_count;
+            auto words_end = static_cast<uint64_t>(candidate->words_offset)
+                             + candidate->words_size;
+            if (candidate->total_size > length || candidate->node_count == 0
+                || candidate->nodes_offset % alignof(prebuilt::Node) != 0
+                || candidate->edge_targets_offset % alignof(uint32_t) != 0
+                || nodes_end > candidate->total_size || targets_end > candidate->total_size
+                || keys_end > candidate->total_size || words_end > candidate->total_size) {
+                logger.w("Prebuilt index is corrupted");
+                return;
+            }
+
+            if (!validate_tables(*candidate, data)) {
+                logger.w("Prebuilt index is corrupted");
+                return;
+            }
+
+            header = candidate;
+            nodes = reinterpret_cast<const prebuilt::Node*>(data + header->nodes_offset);
+            edge_targets = reinterpret_cast<const uint32_t*>(data + header->edge_targets_offset);
+            edge_keys = data + header->edge_keys_offset;
+            words = data + header->words_offset;
+
+            logger.i("Mapped prebuilt index with %u nodes", header->node_count);
+        }
+
+        /// Prebuilt indexes are not parsed, so there is nothing to parallelize.
+        virtual void
+        load_from_buffer_parallel(const uint8_t* buffer,
+                                  const int length,
+                                  [[maybe_unused]] const int parallel_factor) override {
+            load_from_buffer(buffer, 0, static_cast<size_t>(length));
+        }
+    };
+
+    using PrebuiltIndex = BasicPrebuiltIndex<locale::pl_PL>;
+}
+
+#endif // CROSSWORD_HELPER_PREBUILT_HPP
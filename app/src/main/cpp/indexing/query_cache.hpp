@@ -0,0 +1,136 @@
+#ifndef CROSSWORD_HELPER_QUERY_CACHE_HPP
+#define CROSSWORD_HELPER_QUERY_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace crossword::indexing {
+
+    /// All the results of a lookup, in the order the index returns them.
+    struct CachedResults {
+        /// Views of the words stored in the index.
+        std::vector<std::u8string_view> words;
+        /// Symbols of a pattern of letters and wildcards, or empty for other patterns.
+        std::vector<uint8_t> pattern;
+        /// Symbols of every word, back to back, if the pattern has any.
+        /// Words of such a pattern are all as long as the pattern.
+        std::vector<uint8_t> symbols;
+    };
+
+    /// A size-bounded cache of complete lookup results, evicting the least recently used ones.
+    /// @details Results are shared, so a lookup can keep reading them after they get evicted.
+    /// The cache is locked internally, since lookups of a single index may run concurrently.
+    class QueryCache final {
+    private:
+        struct Entry {
+            std::u8string query;
+            std::shared_ptr<const CachedResults> results;
+        };
+
+        /// Entries from the most to the least recently used.
+        std::list<Entry> entries;
+        std::unordered_map<std::u8string_view, std::list<Entry>::iterator> by_query;
+        /// Words of all the entries.
+        size_t word_count = 0;
+
+        size_t max_entries;
+        size_t max_words;
+
+        mutable std::mutex mutex;
+
+        void evict_over_limits() {
+            while (!entries.empty()
+                   && (entries.size() > max_entries || word_count > max_words)) {
+                auto& last = entries.back();
+                word_count -= last.results->words.size();
+                by_query.erase(last.query);
+                entries.pop_back();
+            }
+        }
+
+    public:
+        /// Creates an empty cache.
+        /// @param max_entries How many queries can be cached at once.
+        /// @param max_words How many results can be cached at once, across all the queries.
+        explicit QueryCache(size_t max_entries = 64, size_t max_words = 65536) :
+            max_entries(max_entries), max_words(max_words) {}
+
+        /// Most results a single query can have to be cached.
+        size_t max_results() const noexcept {
+            return max_words / 16;
+        }
+
+        /// Finds the results of a query and marks them as the most recently used.
+        /// @returns Null if the query is not cached.
+        std::shared_ptr<const CachedResults> get(const std::u8string& query) {
+            std::lock_guard lock(mutex);
+            auto it = by_query.find(query);
+            if (it == by_query.end()) {
+                return nullptr;
+            }
+
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->results;
+        }
+
+        /// Finds the cached results with the fewest words whose query satisfies the predicate.
+        /// @returns Null if no cached query satisfies the predicate.
+        template <typename P>
+        std::shared_ptr<const CachedResults> find_smallest(P&& predicate) const {
+            std::lock_guard lock(mutex);
+            std::shared_ptr<const CachedResults> smallest;
+            for (const auto& entry : entries) {
+                if ((smallest == nullptr || entry.results->words.size() < smallest->words.size())
+                    && predicate(std::u8string_view(entry.query), *entry.results)) {
+                    smallest = entry.results;
+                }
+            }
+            return smallest;
+        }
+
+        /// Caches the results of a query as the most recently used ones,
+        /// replacing what was cached for it before.
+        void put(const std::u8string& query, std::shared_ptr<const CachedResults> results) {
+            std::lock_guard lock(mutex);
+            auto it = by_query.find(query);
+            if (it != by_query.end()) {
+                auto entry = it->second;
+                word_count -= entry->results->words.size();
+                by_query.erase(it);
+                entries.erase(entry);
+            }
+
+            word_count += results->words.size();
+            entries.push_front({query, std::move(results)});
+            by_query.emplace(entries.front().query, entries.begin());
+            evict_over_limits();
+        }
+
+        /// Forgets all the cached results, e.g. once the words they refer to change.
+        void clear() {
+            std::lock_guard lock(mutex);
+            by_query.clear();
+            entries.clear();
+            word_count = 0;
+        }
+
+        /// Reports how many bytes the cached results take.
+        size_t size_bytes() const {
+            std::lock_guard lock(mutex);
+            auto bytes = word_count * sizeof(std::u8string_view);
+            for (const auto& entry : entries) {
+                bytes += sizeof(Entry) + sizeof(CachedResults) + entry.query.capacity()
+                         + entry.results->pattern.capacity() + entry.results->symbols.capacity();
+            }
+            return bytes;
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_QUERY_CACHE_HPP
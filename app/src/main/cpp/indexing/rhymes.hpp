@@ -0,0 +1,124 @@
+#ifndef CROSSWORD_HELPER_RHYMES_HPP
+#define CROSSWORD_HELPER_RHYMES_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/lines.hpp"
+#include "../utils/log.hpp"
+#include "suffix_trie.hpp"
+#include "word_index.hpp"
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
+
+    /// The rhyme index finds words sharing an ending with the looked up word,
+    /// the ones sharing the longest ending first (see SuffixTrie::rhymes).
+    /// @details The words are stored in a trie of reversed words, which gets rebuilt
+    /// as a whole whenever more words are loaded.
+    /// @tparam Alphabet The locale::Alphabet the words are keyed by.
+    template <typename Alphabet>
+    class BasicRhymeIndex final : public WordIndex {
+    public:
+        using alphabet_type = Alphabet;
+
+    private:
+        /// Copies of the words, referred to by the trie nodes.
+        StringPool string_pool;
+        SuffixTrie<Alphabet> suffixes;
+
+    public:
+        BasicRhymeIndex() = default;
+        ~BasicRhymeIndex() = default;
+
+        /// Rhyme indexes are built from all their words at once and cannot be merged.
+        virtual bool merge([[maybe_unused]] WordIndex* other) override {
+            return false;
+        }
+
+        /// Returns words rhyming with the provided one, the best rhymes first.
+        /// @param input The word to find rhymes of.
+        /// @param max_results The maximum number of results to return.
+        virtual std::vector<std::u8string> lookup(const std::u8string& input,
+                                                  const size_t max_results) const override {
+            auto words = suffixes.rhymes(input, max_results, {}, nullptr, string_pool);
+            return {words.begin(), words.end()};
+        }
+
+        /// Returns a page of words rhyming with the provided one.
+        /// The cursor holds the length of the ending shared by the last word on the page
+        /// and the reversed symbols of that word.
+        virtual LookupPage lookup_page(const std::u8string& input,
+                                       const size_t max_results,
+                                       const std::vector<uint8_t>& cursor,
+                                       const utils::CancellationToken* cancellation = nullptr)
+            const override {
+            LookupPage page;
+            page.words = suffixes.rhymes(input, max_results, cursor, &page.cursor, string_pool,
+                                         cancellation);
+            return page;
+        }
+
+        /// Collapses chains of single-child nodes of the trie, which takes less memory.
+        void compress() {
+            suffixes.compress();
+        }
+
+        /// Reports how much memory this index takes and what takes it.
+        virtual MemoryStats memory_stats() const override {
+            MemoryStats stats;
+            stats.other_bytes = string_pool.size_bytes();
+            suffixes.add_memory_stats(stats, true);
+            return stats;
+        }
+
+        /// Parses lines from a UTF-8 encoded buffer and adds them to the index.
+        /// The words are copied, so the buffer does not have to outlive the index.
+        /// @details The trie gets rebuilt from all the words of the index on the shared pool.
+        /// Copying the words counts as parsing, and building the trie of all of them
+        /// as merging (see LoadStats). Nothing gets partitioned.
+        virtual void
+        load_from_buffer(const uint8_t* buffer, const size_t start, const size_t end) override {
+            auto parse_start = std::chrono::steady_clock::now();
+            auto compress_after = suffixes.compressed();
+
+            utils::for_each_line(buffer, start, end, [this](const uint8_t* line, size_t length) {
+                auto word = std::u8string_view(reinterpret_cast<const char8_t*>(line), length);
+                if (string_pool.add(word) == StringPool::no_string) [[unlikely]] {
+                    utils::log::tag("RhymeIndex").w("Cannot store a word of %zu bytes", length);
+                }
+            });
+
+            auto build_start = std::chrono::steady_clock::now();
+            suffixes.build(string_pool);
+            if (compress_after) {
+                suffixes.compress();
+            }
+            auto build_end = std::chrono::steady_clock::now();
+
+            load_stats.chunk_count = 1;
+            load_stats.partition_time = std::chrono::nanoseconds{0};
+            load_stats.parse_time = build_start - parse_start;
+            load_stats.merge_time = build_end - build_start;
+        }
+
+        /// Copying the words is cheap, so only the trie gets built in parallel,
+        /// by the last letters of the words (see SuffixTrie::build).
+        virtual void
+        load_from_buffer_parallel(const uint8_t* buffer,
+                                  const int length,
+                                  [[maybe_unused]] const int parallel_factor) override {
+            load_from_buffer(buffer, 0, static_cast<size_t>(length));
+        }
+    };
+
+    using RhymeIndex = BasicRhymeIndex<locale::pl_PL>;
+}
+
+#endif // CROSSWORD_HELPER_RHYMES_HPP
@@ -0,0 +1,502 @@
+#ifndef CROSSWORD_HELPER_SUFFIX_TRIE_HPP
+#define CROSSWORD_HELPER_SUFFIX_TRIE_HPP
+
+#include "../locale/alphabet.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/cancellation.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/utf8.hpp"
+#include "../word_node.hpp"
+#include "pattern.hpp"
+#include "trie_compressor.hpp"
+#include "word_index.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::locale::Symbol;
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
+
+    /// Collects the words with the lowest collation ranks found by WordNode::search,
+    /// up to a limit, so that they come out sorted whatever order they are found in.
+    /// @details Ranks are the handles of a pool stored in collation order
+    /// (see BasicMissingLettersIndex::rank_words). The lowest ranks are kept in a bounded
+    /// max-heap, so the whole search has to be walked, unless it gets cancelled.
+    struct RankedResults {
+        /// Max-heap of the lowest ranks found so far.
+        std::vector<StringHandle> ranks;
+        size_t limit;
+        /// Lowest rank to collect, e.g. the one right after the cursor of the previous page.
+        StringHandle first;
+        const utils::CancellationToken* cancellation;
+
+        bool full() const noexcept {
+            return utils::CancellationToken::is_cancelled(cancellation);
+        }
+
+        void push(StringHandle word) {
+            if (word < first || limit == 0) {
+                return;
+            }
+
+            if (ranks.size() < limit) {
+                ranks.push_back(word);
+                std::push_heap(ranks.begin(), ranks.end());
+            } else if (word < ranks.front()) {
+                std::pop_heap(ranks.begin(), ranks.end());
+                ranks.back() = word;
+                std::push_heap(ranks.begin(), ranks.end());
+            }
+        }
+
+        template <typename Cursor>
+        constexpr bool descend(WordNode*, size_t, uint32_t, const Cursor*) const noexcept {
+            return true;
+        }
+
+        /// Appends the collected words to the vector, in the order of their ranks.
+        void take(std::vector<std::u8string_view>& vec, const StringPool& pool) {
+            std::sort_heap(ranks.begin(), ranks.end());
+            for (auto rank : ranks) {
+                vec.push_back(pool.get(rank));
+            }
+            ranks.clear();
+        }
+    };
+
+    /// A trie of words spelled backwards, one symbol per codepoint.
+    /// @details End-anchored patterns (e.g. ......ość) fan out over every letter of the
+    /// forward trie before reaching a known one, but they are prefix lookups in this trie.
+    /// Words sharing an ending share a subtree as well, which makes finding rhymes cheap.
+    /// Nodes refer to the words of a StringPool owned by someone else (e.g. an index),
+    /// so the words are not stored twice. The trie walks words in the order of their reversed
+    /// symbols, but pattern lookups return them in the collation order of their ranks.
+    /// @tparam Alphabet The locale::Alphabet the words are keyed by.
+    template <typename Alphabet>
+    class SuffixTrie final {
+    private:
+        std::unique_ptr<WordNode> root;
+        std::unique_ptr<TrieArenas> arenas;
+        bool is_compressed;
+
+        /// An automaton accepting every word, to collect whole subtrees with WordNode::match.
+        struct AnyWord {
+            using StateSet = uint8_t;
+
+            static constexpr StateSet start() noexcept {
+                return 1;
+            }
+
+            static constexpr StateSet step(StateSet, Symbol) noexcept {
+                return 1;
+            }
+
+            static constexpr bool accepts(StateSet, size_t) noexcept {
+                return true;
+            }
+
+            static constexpr uint32_t remaining_lengths(StateSet, size_t) noexcept {
+                return UINT32_MAX;
+            }
+
+            static constexpr Symbol only_symbol(StateSet) noexcept {
+                return locale::wildcard;
+            }
+        };
+
+        /// Words sharing an ending of the same length with a looked up word.
+        struct RhymeLevel {
+            WordNode* node;
+            /// Number of symbols matched before the children of the node.
+            size_t depth;
+            /// Length of the shared ending, in symbols.
+            size_t shared;
+            /// Child leading to the deeper levels, or the wildcard if there is none.
+            Symbol skipped;
+        };
+
+        /// Maps the last symbol of a word to its build shard.
+        /// Unknown codepoints go after all the letters.
+        static constexpr size_t shard_of(Symbol symbol) noexcept {
+            return std::min<size_t>(symbol, Alphabet::size + 1);
+        }
+
+        /// Finds the symbol of the last codepoint of a (non-empty) word.
+        static Symbol last_symbol(std::u8string_view word) {
+            auto begin = word.data();
+            auto end = begin + word.length();
+            auto last = end - 1;
+            while (last > begin && utils::codepoint_is_continuation(*last)) {
+                --last;
+            }
+            return Alphabet::to_symbol(utils::decode_codepoint(last, end));
+        }
+
+        /// Lists the levels of rhymes of a word, from the longest shared ending to the shortest.
+        std::vector<RhymeLevel> rhyme_levels(const std::vector<Symbol>& key) const {
+            std::vector<RhymeLevel> levels;
+
+            auto node = root.get();
+            size_t depth = 0;
+            while (true) {
+                size_t label_length = 0;
+                size_t matched = 0;
+                for (; label_length < WordNode::label_capacity; ++label_length) {
+                    auto symbol = node->label[label_length];
+                    if (symbol == 0) {
+                        break;
+                    }
+                    auto position = depth + label_length;
+                    auto matches = position < key.size() && symbol == key[position];
+                    if (matched == label_length && matches) {
+                        ++matched;
+                    }
+                }
+
+                // Words below a label diverging from the key all share the same ending
+                if (matched < label_length) {
+                    auto shared = depth + matched;
+                    levels.push_back({node, depth + label_length, shared, locale::wildcard});
+                    break;
+                }
+
+                depth += label_length;
+                auto end = node->children.end(&arenas->chunks);
+                auto child = depth < key.size() ? node->children.find(key[depth], &arenas->chunks)
+                                                : end;
+                if (child == end) {
+                    levels.push_back({node, depth, depth, locale::wildcard});
+                    break;
+                }
+
+                levels.push_back({node, depth, depth, key[depth]});
+                node = arenas->node(child.get_element().second);
+                ++depth;
+            }
+
+            std::reverse(levels.begin(), levels.end());
+            return levels;
+        }
+
+        /// Finds the handle of a word by its symbols, spelled forwards.
+        /// @returns StringPool::no_string if the trie does not hold such a word.
+        StringHandle find_handle(const Symbol* symbols, size_t length) const {
+            auto node = root.get();
+            size_t matched = 0;
+            while (true) {
+                for (size_t i = 0; i < WordNode::label_capacity && node->label[i] != 0; ++i) {
+                    if (matched == length || node->label[i] != symbols[length - 1 - matched]) {
+                        return StringPool::no_string;
+                    }
+                    ++matched;
+                }
+
+                if (matched == length) {
+                    return node->valid_word;
+                }
+
+                auto child = node->children.find(symbols[length - 1 - matched], &arenas->chunks);
+                if (child == node->children.end(&arenas->chunks)) {
+                    return StringPool::no_string;
+                }
+                node = arenas->node(child.get_element().second);
+                ++matched;
+            }
+        }
+
+        /// Finds the lowest rank a page resuming after the provided word can start with.
+        /// A cursor word the trie does not hold (i.e. of another index) leaves nothing to collect.
+        StringHandle first_rank_after(const Symbol* after, size_t length) const {
+            if (after == nullptr) {
+                return 0;
+            }
+
+            auto handle = find_handle(after, length);
+            return handle == StringPool::no_string ? StringPool::no_string : handle + 1;
+        }
+
+    public:
+        SuffixTrie() :
+            root(std::make_unique<WordNode>()),
+            arenas(std::make_unique<TrieArenas>()),
+            is_compressed(false) {}
+
+        /// Builds the trie from all the words of a pool, replacing whatever it held before.
+        /// @details Words are split by their last letter, every letter gets built into a trie
+        /// of its own on the shared thread pool, and the tries are stitched at their roots.
+        /// Words spelled the same keep the last one, like in a forward trie.
+        void build(const StringPool& words) {
+            struct Shard {
+                std::vector<StringHandle> words;
+                std::unique_ptr<WordNode> root;
+                std::unique_ptr<TrieArenas> arenas;
+            };
+
+            std::vector<Shard> shards(Alphabet::size + 2);
+            words.for_each([&](StringHandle handle, std::u8string_view word) {
+                shards[shard_of(last_symbol(word))].words.push_back(handle);
+            });
+
+            auto& thread_pool = utils::ThreadPool::shared();
+            thread_pool.parallel_for(shards.size(), [&](size_t i) {
+                auto& shard = shards[i];
+                shard.root = std::make_unique<WordNode>();
+                shard.arenas = std::make_unique<TrieArenas>();
+
+                std::vector<Symbol> symbols;
+                for (auto handle : shard.words) {
+                    Alphabet::encode_word(words.get(handle), symbols);
+                    std::reverse(symbols.begin(), symbols.end());
+                    shard.root->push_word(handle, symbols, 0, shard.arenas.get());
+                }
+            });
+
+            root = std::make_unique<WordNode>();
+            arenas = std::make_unique<TrieArenas>();
+            is_compressed = false;
+
+            // Shards do not share any child of the root, so this only links them
+            for (auto& shard : shards) {
+                if (!root->has_children()) {
+                    std::swap(arenas, shard.arenas);
+                } else {
+                    arenas->merge(shard.arenas.get(), shard.root.get());
+                }
+                root->merge(shard.root.get(), arenas.get());
+            }
+        }
+
+        /// Collapses chains of single-child nodes, like BasicMissingLettersIndex::compress.
+        void compress() {
+            if (is_compressed) {
+                return;
+            }
+
+            auto new_arenas = std::make_unique<TrieArenas>();
+            TrieCompressor compressor(arenas.get(), new_arenas.get(), false);
+            compressor.compress(root.get());
+            arenas = std::move(new_arenas);
+            is_compressed = true;
+        }
+
+        /// Checks whether the trie has been path-compressed.
+        bool compressed() const noexcept {
+            return is_compressed;
+        }
+
+        /// Finds the words of the lowest ranks matching a pattern of letters and wildcards,
+        /// spelled forwards, in the order of their ranks.
+        /// @param words Pool of the words, stored in collation order (see RankedResults).
+        /// @param after Symbols of the word to resume after, or null.
+        /// @param cancellation Stops the search once cancelled, or null.
+        void find_words(std::vector<std::u8string_view>& vec,
+                        const std::vector<Symbol>& pattern,
+                        const size_t limit,
+                        const StringPool& words,
+                        const Symbol* after,
+                        const utils::CancellationToken* cancellation = nullptr) const {
+            std::vector<Symbol> reversed(pattern.rbegin(), pattern.rend());
+            RankedResults results{{}, limit, first_rank_after(after, pattern.size()),
+                                  cancellation};
+            root->search<false>(results, *arenas, reversed, 0, 0, nullptr, nullptr);
+            results.take(vec, words);
+        }
+
+        /// Finds the words of the lowest ranks accepted by a compiled pattern,
+        /// spelled forwards, in the order of their ranks.
+        /// @param words Pool of the words, stored in collation order (see RankedResults).
+        /// @param after Symbols of the word to resume after, or null.
+        /// @param cancellation Stops the search once cancelled, or null.
+        void match(std::vector<std::u8string_view>& vec,
+                   const CompiledPattern<Alphabet>& pattern,
+                   const size_t limit,
+                   const StringPool& words,
+                   const std::vector<Symbol>* after,
+                   const utils::CancellationToken* cancellation = nullptr) const {
+            auto reversed = pattern.reversed();
+            auto first = after != nullptr ? first_rank_after(after->data(), after->size()) : 0;
+            RankedResults results{{}, limit, first, cancellation};
+            root->match<false>(results, *arenas, reversed, reversed.start(), 0, 0, nullptr,
+                               nullptr);
+            results.take(vec, words);
+        }
+
+        /// Collects the handles of the words matching a pattern of letters and wildcards
+        /// (spelled forwards) or a compiled pattern, in no particular order, as long as
+        /// there are at most `limit` of them. E.g. to score all the matches of a selective
+        /// pattern, instead of bounding the search of the forward trie.
+        /// @returns False if more words match, or the lookup got cancelled.
+        template <typename Pattern>
+        bool collect(std::vector<StringHandle>& handles,
+                     const Pattern& pattern,
+                     const size_t limit,
+                     const utils::CancellationToken* cancellation = nullptr) const {
+            struct {
+                std::vector<StringHandle>& handles;
+                size_t limit;
+                const utils::CancellationToken* cancellation;
+
+                bool full() const noexcept {
+                    return handles.size() > limit
+                           || utils::CancellationToken::is_cancelled(cancellation);
+                }
+
+                void push(StringHandle word) {
+                    handles.push_back(word);
+                }
+
+                bool descend(WordNode*, size_t, uint32_t, const Symbol*) const noexcept {
+                    return true;
+                }
+
+                bool descend(WordNode*, size_t, uint32_t, const std::vector<Symbol>*)
+                    const noexcept {
+                    return true;
+                }
+            } results{handles, limit, cancellation};
+
+            handles.clear();
+            if constexpr (std::is_same_v<Pattern, std::vector<Symbol>>) {
+                std::vector<Symbol> reversed(pattern.rbegin(), pattern.rend());
+                root->search<false>(results, *arenas, reversed, 0, 0, nullptr, nullptr);
+            } else {
+                auto reversed = pattern.reversed();
+                root->match<false>(results, *arenas, reversed, reversed.start(), 0, 0, nullptr,
+                                   nullptr);
+            }
+            return !results.full();
+        }
+
+        /// Finds the rhymes of a word: other words sharing an ending with it,
+        /// the ones sharing the longest ending first. Words ending in the same letter only
+        /// are the weakest rhymes; words without any shared letter are not rhymes at all.
+        /// @param cursor Cursor of the previous page of the same word, or empty for the first one:
+        /// the length of the ending shared by its last word, followed by its reversed symbols.
+        /// @param next_cursor If not null, receives the cursor of this page,
+        ///                    or is cleared if there are no more results after this page.
+        /// @param cancellation Stops the search once cancelled, or null.
+        std::vector<std::u8string_view>
+        rhymes(std::u8string_view word,
+               const size_t max_results,
+               const std::vector<Symbol>& cursor,
+               std::vector<Symbol>* next_cursor,
+               const StringPool& words,
+               const utils::CancellationToken* cancellation = nullptr) const {
+            std::vector<std::u8string_view> results;
+
+            std::vector<Symbol> key;
+            Alphabet::encode_word(word, key);
+            std::reverse(key.begin(), key.end());
+
+            auto limit = std::min(max_results, static_cast<size_t>(INT32_MAX - 1));
+            if (next_cursor != nullptr) {
+                ++limit;
+            }
+
+            auto resume_shared = cursor.empty() ? SIZE_MAX : static_cast<size_t>(cursor[0]);
+            std::vector<Symbol> resume_after(cursor.begin() + (cursor.empty() ? 0 : 1),
+                                             cursor.end());
+
+            LimitedResults collector{results, limit, words, cancellation};
+            std::vector<std::pair<size_t, size_t>> level_ends;
+            for (const auto& level : rhyme_levels(key)) {
+                if (level.shared == 0 || level.shared > resume_shared || collector.full()) {
+                    continue;
+                }
+
+                auto after = level.shared == resume_shared ? &resume_after : nullptr;
+                auto node = level.node;
+
+                // The word spelled by the path of the level comes first,
+                // unless it is the very word rhymes are looked for
+                auto own_word = level.depth == key.size() && level.shared == key.size();
+                if (after == nullptr && node->valid() && !own_word) {
+                    collector.push(node->valid_word);
+                }
+                if (after != nullptr && after->size() <= level.depth) {
+                    after = nullptr;
+                }
+
+                for (const auto& [symbol, child_index] : node->children.entries(&arenas->chunks)) {
+                    if (symbol == level.skipped) {
+                        continue;
+                    }
+                    if (after != nullptr && symbol < (*after)[level.depth]) {
+                        continue;
+                    }
+
+                    auto child_after = after != nullptr && symbol == (*after)[level.depth]
+                                           ? after
+                                           : nullptr;
+                    AnyWord any;
+                    arenas->node(child_index)->template match<false>(
+                        collector, *arenas, any, any.start(), level.depth + 1, 0, nullptr,
+                        child_after);
+                    after = nullptr;
+                }
+
+                level_ends.emplace_back(results.size(), level.shared);
+            }
+
+            if (next_cursor != nullptr) {
+                next_cursor->clear();
+                if (results.size() > max_results && max_results > 0) {
+                    // Find the level of the last word of the page
+                    auto last = std::find_if(level_ends.begin(), level_ends.end(),
+                                             [&](const auto& end) {
+                                                 return end.first >= max_results;
+                                             });
+                    next_cursor->push_back(static_cast<Symbol>(last->second));
+                    std::vector<Symbol> symbols;
+                    Alphabet::encode_word(results[max_results - 1], symbols);
+                    next_cursor->insert(next_cursor->end(), symbols.rbegin(), symbols.rend());
+                } else if (results.size() > max_results) {
+                    // An empty page does not move the cursor
+                    *next_cursor = cursor;
+                }
+            }
+
+            if (results.size() > max_results) {
+                results.resize(max_results);
+            }
+            return results;
+        }
+
+        /// Adds the memory taken by the trie to the stats of the index it belongs to.
+        /// @param count_nodes Whether to walk the trie, counting its nodes and their fan-out.
+        void add_memory_stats(MemoryStats& stats, bool count_nodes) const {
+            stats.arenas.push_back({"suffix nodes", arenas->nodes.stats()});
+            stats.arenas.push_back({"suffix chunks", arenas->chunks.stats()});
+            stats.other_bytes += sizeof(WordNode);
+            if (!count_nodes) {
+                return;
+            }
+
+            std::vector<const WordNode*> stack{root.get()};
+            while (!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+
+                auto children = static_cast<size_t>(node->children.size);
+                if (stats.fan_out.size() <= children) {
+                    stats.fan_out.resize(children + 1, 0);
+                }
+                ++stats.fan_out[children];
+                ++stats.node_count;
+                stats.chunk_count += static_cast<size_t>(node->children.allocated_chunks);
+                stats.word_count += node->valid_word != StringPool::no_string ? 1 : 0;
+                for (const auto& entry : node->children.entries(&arenas->chunks)) {
+                    stack.push_back(arenas->node(entry.second));
+                }
+            }
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_SUFFIX_TRIE_HPP
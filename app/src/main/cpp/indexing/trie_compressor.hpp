@@ -0,0 +1,113 @@
+#ifndef CROSSWORD_HELPER_TRIE_COMPRESSOR_HPP
+#define CROSSWORD_HELPER_TRIE_COMPRESSOR_HPP
+
+#include "../word_node.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace crossword::indexing {
+
+    /// Turns a trie into a radix tree,
+    /// by collapsing chains of single-child nodes into labels of their first nodes.
+    /// @details Below the first few levels, most of the nodes have exactly one child,
+    /// so a lookup chases a pointer per letter of every long word. A compressed node
+    /// holds up to WordNode::label_capacity letters, so longer chains take several nodes.
+    /// The surviving nodes are copied to fresh arenas, so that the old ones can be freed.
+    class TrieCompressor final {
+    private:
+        const TrieArenas* source;
+        TrieArenas* target;
+
+        /// Should shared nodes (of a minimized trie) stay shared?
+        bool shared;
+
+        /// Maps nodes of the original graph to their compressed copies.
+        /// Only used if the nodes are shared.
+        std::unordered_map<WordNode*, NodeIndex> copies;
+
+        size_t node_count;
+        size_t chunk_count;
+
+        /// Compresses the children of the source node and attaches them to the target node.
+        /// The order of the children is kept, so that word ordinals stay the same.
+        void compress_children(WordNode* target_node, WordNode* source_node) {
+            std::vector<std::pair<uint8_t, NodeIndex>> children;
+            children.reserve(source_node->children.size);
+            for (const auto& [key, child] : source_node->children.entries(&source->chunks)) {
+                children.emplace_back(key, compress_node(source->node(child)));
+            }
+            chunk_count += target->copy_children(target_node, children);
+        }
+
+        /// Compresses the subtree of the node.
+        /// @returns The compressed copy of that subtree, allocated in the target arenas.
+        NodeIndex compress_node(WordNode* node) {
+            if (shared) {
+                auto copy = copies.find(node);
+                if (copy != copies.end()) {
+                    return copy->second;
+                }
+            }
+
+            auto copy_index = target->nodes.alloc_index();
+            auto copy = target->node(copy_index);
+            ++node_count;
+
+            // Follow the chain for as long as the label has room for it
+            auto end = node;
+            size_t length = 0;
+            while (length < WordNode::label_capacity && !end->valid()
+                   && end->children.size == 1) {
+                auto [key, child] = end->children.entry_at(0, &source->chunks);
+                copy->label[length++] = key;
+                end = source->node(child);
+            }
+
+            // The length mask is counted from the start of the chain, so it stays the same
+            copy->length_mask = node->length_mask;
+
+            // Nodes of a chain are not valid, so the ordinal of its end stays the same
+            copy->valid_word = end->valid_word;
+            copy->word_count = end->word_count;
+            compress_children(copy, end);
+
+            if (shared) {
+                copies.emplace(node, copy_index);
+            }
+
+            return copy_index;
+        }
+
+    public:
+        /// Creates a compressor that will allocate the tree in the target arenas.
+        /// @param source The arenas of the trie to compress.
+        /// @param shared Whether the trie has been minimized and its nodes are shared.
+        TrieCompressor(const TrieArenas* source, TrieArenas* target, bool shared) :
+            source(source),
+            target(target),
+            shared(shared),
+            node_count(0),
+            chunk_count(0) {}
+
+        /// Compresses the trie under the root.
+        /// The root node itself is kept in place and never gets a label,
+        /// but its children get replaced, so every other node of the original trie
+        /// is unreachable afterwards.
+        void compress(WordNode* root) {
+            compress_children(root, root);
+        }
+
+        /// Reports how many nodes the compressed tree has, including the root.
+        size_t compressed_node_count() const noexcept {
+            return node_count + 1;
+        }
+
+        /// Reports how many map chunks the compressed tree has allocated.
+        size_t map_chunk_count() const noexcept {
+            return chunk_count;
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_TRIE_COMPRESSOR_HPP
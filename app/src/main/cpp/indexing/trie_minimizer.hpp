@@ -0,0 +1,126 @@
+#ifndef CROSSWORD_HELPER_TRIE_MINIMIZER_HPP
+#define CROSSWORD_HELPER_TRIE_MINIMIZER_HPP
+
+#include "../word_node.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace crossword::indexing {
+
+    /// Turns a trie into a directed acyclic word graph (DAWG),
+    /// by replacing all equivalent subtrees with a single shared copy.
+    /// @details Two subtrees are equivalent if they accept the same set of suffixes.
+    /// Shared nodes cannot point to a single word, so the minimized graph counts words
+    /// in every subtree instead (see WordNode::find_words_by_ordinal).
+    /// The surviving nodes are copied to fresh arenas, so that the old ones can be freed.
+    class TrieMinimizer final {
+    private:
+        TrieArenas* source;
+        TrieArenas* target;
+
+        /// Maps a node signature (terminal flag + label + outgoing edges) to its canonical node.
+        std::unordered_map<std::string, NodeIndex> registry;
+
+        /// All the words of the trie, in depth-first order.
+        std::vector<StringHandle> words;
+
+        size_t chunk_count;
+
+        /// Minimizes the subtree of the node.
+        /// @returns The canonical copy of that subtree, allocated in the target arenas.
+        NodeIndex canonicalize(WordNode* node) {
+            // Words are collected in pre-order, which is the order of their ordinals
+            if (node->valid()) {
+                words.push_back(node->valid_word);
+            }
+
+            node->children.sort_by_key(&source->chunks);
+
+            std::vector<std::pair<uint8_t, NodeIndex>> children;
+            children.reserve(node->children.size);
+
+            std::string signature;
+            signature.reserve(1 + WordNode::label_capacity
+                              + node->children.size * (1 + sizeof(NodeIndex)));
+            signature.push_back(node->valid() ? 1 : 0);
+            signature.append(reinterpret_cast<const char*>(node->label),
+                             WordNode::label_capacity);
+
+            uint32_t word_count = node->valid() ? 1 : 0;
+            for (const auto& [key, child] : node->children.entries(&source->chunks)) {
+                auto canonical_child = canonicalize(source->node(child));
+                word_count += target->node(canonical_child)->word_count;
+                children.emplace_back(key, canonical_child);
+
+                // Canonical children are unique, so their indices identify them
+                signature.push_back(static_cast<char>(key));
+                signature.append(reinterpret_cast<const char*>(&canonical_child),
+                                 sizeof(NodeIndex));
+            }
+
+            auto [entry, inserted] = registry.try_emplace(std::move(signature), 0);
+            if (inserted) {
+                auto copy_index = target->nodes.alloc_index();
+                auto copy = target->node(copy_index);
+                copy->valid_word = node->valid_word;
+                copy->word_count = word_count;
+                copy->length_mask = node->length_mask;
+                std::copy_n(node->label, WordNode::label_capacity, copy->label);
+                chunk_count += target->copy_children(copy, children);
+                entry->second = copy_index;
+            }
+
+            return entry->second;
+        }
+
+    public:
+        /// Creates a minimizer that will allocate the graph in the target arenas.
+        /// @param source The arenas of the trie to minimize.
+        TrieMinimizer(TrieArenas* source, TrieArenas* target) :
+            source(source),
+            target(target),
+            chunk_count(0) {}
+
+        /// Minimizes the trie under the root.
+        /// The root node itself is kept in place, but its children get replaced,
+        /// so every other node of the original trie is unreachable afterwards.
+        void minimize(WordNode* root) {
+            if (root->valid()) {
+                words.push_back(root->valid_word);
+            }
+
+            root->children.sort_by_key(&source->chunks);
+
+            std::vector<std::pair<uint8_t, NodeIndex>> children;
+            uint32_t word_count = root->valid() ? 1 : 0;
+            for (const auto& [key, child] : root->children.entries(&source->chunks)) {
+                auto canonical_child = canonicalize(source->node(child));
+                word_count += target->node(canonical_child)->word_count;
+                children.emplace_back(key, canonical_child);
+            }
+
+            root->word_count = word_count;
+            chunk_count += target->copy_children(root, children);
+        }
+
+        /// Takes the words of the minimized trie, ordered by their ordinals.
+        std::vector<StringHandle> take_words() {
+            return std::move(words);
+        }
+
+        /// Reports how many distinct nodes the graph has, including the root.
+        size_t node_count() const noexcept {
+            return registry.size() + 1;
+        }
+
+        /// Reports how many map chunks the graph has allocated.
+        size_t map_chunk_count() const noexcept {
+            return chunk_count;
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_TRIE_MINIMIZER_HPP
@@ -1,15 +1,68 @@
 #ifndef CROSSWORD_HELPER_WORD_INDEX_HPP
 #define CROSSWORD_HELPER_WORD_INDEX_HPP
 
-#include "../utils/android.hpp"
+#include "../memory/arena.hpp"
+#include "../memory/string_pool.hpp"
+#include "../utils/cancellation.hpp"
+#include "../utils/lines.hpp"
+#include "../utils/log.hpp"
+#include "../utils/thread_pool.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <concepts>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <thread>
+#include <string_view>
 #include <vector>
 
 namespace crossword::indexing {
 
+    /// Describes how the last parallel load of an index went.
+    struct LoadStats {
+        /// How many chunks was the buffer split into?
+        int chunk_count = 0;
+        /// Wall time spent bucketing lines by their keys. Only spent by sharded loads.
+        std::chrono::nanoseconds partition_time{0};
+        /// Wall time spent parsing chunks into partial indexes.
+        std::chrono::nanoseconds parse_time{0};
+        /// Wall time spent merging partial indexes together.
+        std::chrono::nanoseconds merge_time{0};
+    };
+
+    /// Memory taken by a single arena of an index.
+    struct ArenaUsage {
+        /// What does the arena hold, e.g. "nodes".
+        const char* name;
+        memory::ArenaStats stats;
+    };
+
+    /// Describes how much memory an index takes and what takes it.
+    struct MemoryStats {
+        /// Arenas of the index, in no particular order.
+        std::vector<ArenaUsage> arenas;
+        /// Bytes taken outside of the arenas, e.g. by stored words or hash tables.
+        size_t other_bytes = 0;
+        /// Nodes reachable in the trie of the index, including the root. Zero without a trie.
+        size_t node_count = 0;
+        /// Child map chunks referenced by the reachable nodes.
+        size_t chunk_count = 0;
+        /// Words stored in the index.
+        size_t word_count = 0;
+        /// Reachable nodes by their number of children: fan_out[n] nodes have n children.
+        std::vector<size_t> fan_out;
+    };
+
+    /// A page of lookup results.
+    struct LookupPage {
+        /// Views of the words stored in the index, valid for as long as the index is.
+        std::vector<std::u8string_view> words;
+        /// Opaque position after the last word of this page, to resume the lookup from.
+        /// Empty if there are no more results.
+        std::vector<uint8_t> cursor;
+    };
+
     /// A word index implements a specific algorithm and data structure
     /// for storing words and retrieving them depending on the input.
     /// @details For example, a "rhyme" index would reverse the words before storing them
@@ -35,7 +88,21 @@ namespace crossword::indexing {
         virtual std::vector<std::u8string> lookup(const std::u8string& input,
                                                   const size_t max_results) const = 0;
 
+        /// Looks up a page of matching words in an index.
+        /// Consecutive pages do not repeat words and together yield all the lookup results.
+        /// @param input The word to look up.
+        /// @param max_results The maximum number of results on this page.
+        /// @param cursor Cursor of the previous page of the same input, or empty for the first one.
+        /// @param cancellation Stops the lookup once cancelled, or null.
+        /// The page of a cancelled lookup is incomplete, and must be discarded.
+        virtual LookupPage lookup_page(const std::u8string& input,
+                                       const size_t max_results,
+                                       const std::vector<uint8_t>& cursor,
+                                       const utils::CancellationToken* cancellation = nullptr)
+            const = 0;
+
         /// Reads the provided buffer and adds the contents to this index.
+        /// Indexes may keep views of the buffer, so it has to outlive them (see retain).
         /// @param buffer The UTF8 buffer to read from.
         /// @param start Index to start searching from.
         /// @param end Exclusive end index of buffer parsing.
@@ -47,64 +114,107 @@ namespace crossword::indexing {
                                                const int parallel_factor)
             = 0;
 
+        /// Ties the lifetime of the loaded buffer's owner (e.g. a mapped asset) to this index.
+        /// Indexes keep views of the words in the buffer, instead of copying them out.
+        void retain(std::shared_ptr<const void> owner) {
+            buffer_owner = std::move(owner);
+        }
+
+        /// Reports how much memory this index takes and what takes it.
+        /// @details Walks the whole index, so it is meant for diagnostics, not for hot paths.
+        virtual MemoryStats memory_stats() const = 0;
+
+        /// Reports how the last parallel load of this index went.
+        const LoadStats& last_load_stats() const noexcept {
+            return load_stats;
+        }
+
     protected:
 
-        template <class T>
-        requires std::is_base_of_v<WordIndex, T>
-        void load_from_buffer_parallel_impl(const uint8_t* buffer,
-                                            const int length,
-                                            const int parallel_factor) {
-            // Clamp thread_count to prevent anomalies
-            auto thread_count = std::clamp(parallel_factor, 1, 32);
+        LoadStats load_stats;
 
-            std::vector<std::thread> threads;
-            std::vector<std::unique_ptr<T>> partial_indexes;
-            auto logger = utils::android::log::tag("WordIndex");
+        /// Keeps the memory backing the loaded words alive.
+        std::shared_ptr<const void> buffer_owner;
 
-            auto indices = std::make_unique<int[]>(thread_count);
-            indices[0] = 0;
+        /// Splits the buffer into chunks of about equal size, which start at line boundaries.
+        /// @returns Start offsets of the chunks. Every chunk ends where the next one starts,
+        /// the last one ends with the buffer.
+        static std::vector<int>
+        split_into_chunks(const uint8_t* buffer, const int length, const int chunk_count) {
+            std::vector<int> starts(chunk_count, length);
+            starts[0] = 0;
 
-            // Split the buffer into chunks
-            for (int i = 1; i < thread_count; i++) {
+            for (int i = 1; i < chunk_count; i++) {
                 // Since we do not know the word length distribution,
                 // we start from the equal-sized segments
-                int candidate = i * length / thread_count;
+                // (in 64 bits, since the product overflows an int for big buffers)
+                auto segment_start = static_cast<int>(int64_t{i} * length / chunk_count);
+                int candidate = std::max(segment_start, starts[i - 1]);
 
                 // CR and LF cannot be in later bytes of the codepoint,
                 // so break on any of them
                 while (candidate < length) {
                     auto curr_byte = buffer[candidate++];
                     if (curr_byte == '\n' || curr_byte == '\r') {
-                        indices[i] = candidate;
+                        starts[i] = candidate;
                         break;
                     }
                 }
             }
 
-            logger.i("Split buffer to %d chunks", thread_count);
+            return starts;
+        }
 
-            // Spawn a thread for every chunk
-            for (auto i = 0; i < thread_count; i++) {
-                int start = indices[i];
-                int end = length;
-                if (i < (thread_count - 1)) {
-                    end = indices[i + 1];
-                }
+        /// Picks how many chunks to split a buffer into.
+        /// @details There are several chunks per thread, so that the threads which finish
+        /// early (e.g. on faster cores) steal the remaining ones, instead of waiting idle
+        /// for the slowest chunk. Chunks are never too small to be worth a task though.
+        static int chunk_count_for(const int length, const int parallel_factor) {
+            constexpr int min_chunk_length = 64 * 1024;
+            constexpr int chunks_per_thread = 4;
 
-                // Each thread gets their own partial index,
-                // because merging them should be cheaper than locking
-                // and making other threads' caches dirty
-                auto index = std::make_unique<T>();
-                threads.emplace_back(&WordIndex::load_from_buffer, index.get(), buffer, start, end);
-                partial_indexes.push_back(std::move(index));
-            }
+            auto max_chunks = std::clamp(parallel_factor, 1, 64) * chunks_per_thread;
+            return std::clamp(length / min_chunk_length, 1, max_chunks);
+        }
+
+        template <class T>
+        requires std::is_base_of_v<WordIndex, T>
+        void load_from_buffer_parallel_impl(const uint8_t* buffer,
+                                            const int length,
+                                            const int parallel_factor) {
+            auto chunk_count = chunk_count_for(length, parallel_factor);
+            auto& pool = utils::ThreadPool::shared();
+            auto logger = utils::log::tag("WordIndex");
+
+            // Split the buffer into chunks
+            auto indices = split_into_chunks(buffer, length, chunk_count);
+            indices.push_back(length);
+
+            logger.i("Split buffer to %d chunks", chunk_count);
+            auto parse_start = std::chrono::steady_clock::now();
+
+            // Each chunk gets its own partial index,
+            // because merging them should be cheaper than locking
+            // and making other threads' caches dirty
+            std::vector<std::unique_ptr<T>> partial_indexes;
+            for (auto i = 0; i < chunk_count; i++) {
+                partial_indexes.push_back(std::make_unique<T>());
 
-            // Wait until parsing finishes
-            for (auto& thread : threads) {
-                thread.join();
+                // A chunk never stores more bytes of words than it spans in the buffer,
+                // so starting at the chunk offsets keeps the stored words disjoint
+                if constexpr (requires(T& index) { index.start_words_at(size_t{}); }) {
+                    partial_indexes.back()->start_words_at(static_cast<size_t>(indices[i]));
+                }
             }
 
-            logger.i("Successfully loaded index on %d threads", thread_count);
+            pool.parallel_for(partial_indexes.size(), [&](size_t i) {
+                auto start = static_cast<size_t>(indices[i]);
+                auto end = static_cast<size_t>(indices[i + 1]);
+                partial_indexes[i]->load_from_buffer(buffer, start, end);
+            });
+
+            auto merge_start = std::chrono::steady_clock::now();
+            logger.i("Successfully loaded index on %zu threads", pool.thread_count());
 
             // Merge the results.
             // It's pretty cheap as long as the input was at-least k-sorted
@@ -112,7 +222,154 @@ namespace crossword::indexing {
                 this->merge(index.get());
             }
 
-            logger.i("Successfully merged %d indexes", thread_count);
+            auto merge_end = std::chrono::steady_clock::now();
+            logger.i("Successfully merged %d indexes", chunk_count);
+
+            load_stats.chunk_count = chunk_count;
+            load_stats.partition_time = std::chrono::nanoseconds{0};
+            load_stats.parse_time = merge_start - parse_start;
+            load_stats.merge_time = merge_end - merge_start;
+        }
+
+        /// Loads the buffer in parallel, building disjoint ranges of keys independently.
+        /// @tparam T Index type, which provides:
+        /// - static constexpr size_t shard_key_count,
+        /// - static size_t shard_key(const uint8_t* line, size_t length),
+        ///   which is monotonic in the order of the index (e.g. the first letters of a word),
+        /// - void add_line(const uint8_t* line, size_t length).
+        /// @details Lines are first sorted by their keys (in parallel, by buffer chunks),
+        /// then the words of every key range are built into a shard of their own.
+        /// The shards do not overlap below the keyed levels, so merging them only stitches
+        /// their top nodes together, instead of walking the whole tries on a single thread.
+        /// Words of the same key are added in the order of the buffer, as in a serial load.
+        template <class T>
+        requires std::is_base_of_v<WordIndex, T>
+        void load_from_buffer_sharded_impl(const uint8_t* buffer,
+                                           const int length,
+                                           const int parallel_factor) {
+            // Offset and length of a line in the buffer
+            using Line = std::pair<uint32_t, uint32_t>;
+            constexpr auto key_count = T::shard_key_count;
+
+            /// Lines of a chunk, sorted by their keys.
+            struct ChunkLines {
+                std::vector<Line> lines;
+                /// Where the lines of every key start, followed by the number of lines.
+                std::vector<uint32_t> key_starts;
+            };
+
+            auto chunk_count = chunk_count_for(length, parallel_factor);
+            auto& pool = utils::ThreadPool::shared();
+            auto logger = utils::log::tag("WordIndex");
+
+            auto chunk_starts = split_into_chunks(buffer, length, chunk_count);
+            chunk_starts.push_back(length);
+
+            auto partition_start = std::chrono::steady_clock::now();
+
+            std::vector<ChunkLines> chunks(chunk_count);
+            pool.parallel_for(chunks.size(), [&](size_t i) {
+                std::vector<Line> lines;
+                std::vector<uint32_t> keys;
+                auto start = static_cast<size_t>(chunk_starts[i]);
+                auto end = static_cast<size_t>(chunk_starts[i + 1]);
+                utils::for_each_line(buffer, start, end, [&](const uint8_t* line, size_t n) {
+                    lines.emplace_back(static_cast<uint32_t>(line - buffer),
+                                       static_cast<uint32_t>(n));
+                    keys.push_back(static_cast<uint32_t>(T::shard_key(line, n)));
+                });
+
+                // Counting sort keeps the buffer order within every key
+                auto& chunk = chunks[i];
+                chunk.key_starts.assign(key_count + 1, 0);
+                for (auto key : keys) {
+                    ++chunk.key_starts[key + 1];
+                }
+                for (size_t key = 0; key < key_count; key++) {
+                    chunk.key_starts[key + 1] += chunk.key_starts[key];
+                }
+
+                auto next = chunk.key_starts;
+                chunk.lines.resize(lines.size());
+                for (size_t line = 0; line < lines.size(); line++) {
+                    chunk.lines[next[keys[line]]++] = lines[line];
+                }
+            });
+
+            // Split the keys into contiguous ranges of about the same number of lines.
+            // There are as many ranges as chunks, so that idle threads can steal them too
+            std::vector<size_t> key_lines(key_count, 0);
+            size_t total_lines = 0;
+            for (const auto& chunk : chunks) {
+                for (size_t key = 0; key < key_count; key++) {
+                    key_lines[key] += chunk.key_starts[key + 1] - chunk.key_starts[key];
+                }
+                total_lines += chunk.lines.size();
+            }
+
+            std::vector<size_t> range_ends;
+            size_t lines_so_far = 0;
+            for (size_t key = 0; key < key_count; key++) {
+                lines_so_far += key_lines[key];
+                auto shards_done = range_ends.size() + 1;
+                if (shards_done < static_cast<size_t>(chunk_count)
+                    && lines_so_far * chunk_count >= shards_done * total_lines) {
+                    range_ends.push_back(key + 1);
+                }
+            }
+            range_ends.push_back(key_count);
+
+            auto build_start = std::chrono::steady_clock::now();
+            logger.i("Partitioned %zu lines to %zu key ranges", total_lines, range_ends.size());
+
+            // Build every key range into its own shard
+            std::vector<std::unique_ptr<T>> shards;
+            size_t shard_offset = 0;
+            for (size_t i = 0; i < range_ends.size(); i++) {
+                shards.push_back(std::make_unique<T>());
+
+                // Stored words of every shard directly follow those of the previous one
+                if constexpr (requires(T& index) { index.start_words_at(size_t{}); }) {
+                    shards.back()->start_words_at(shard_offset);
+                    auto range_start = i > 0 ? range_ends[i - 1] : 0;
+                    for (const auto& chunk : chunks) {
+                        auto first = chunk.lines.begin() + chunk.key_starts[range_start];
+                        auto last = chunk.lines.begin() + chunk.key_starts[range_ends[i]];
+                        for (auto line = first; line != last; ++line) {
+                            shard_offset += memory::StringPool::stored_size(line->second);
+                        }
+                    }
+                }
+            }
+
+            pool.parallel_for(shards.size(), [&](size_t i) {
+                auto range_start = i > 0 ? range_ends[i - 1] : 0;
+                for (auto key = range_start; key < range_ends[i]; key++) {
+                    for (const auto& chunk : chunks) {
+                        auto first = chunk.lines.begin() + chunk.key_starts[key];
+                        auto last = chunk.lines.begin() + chunk.key_starts[key + 1];
+                        for (auto line = first; line != last; ++line) {
+                            shards[i]->add_line(buffer + line->first, line->second);
+                        }
+                    }
+                }
+            });
+
+            auto merge_start = std::chrono::steady_clock::now();
+
+            // The shards are disjoint, so this only links their subtrees to the root
+            for (auto& shard : shards) {
+                this->merge(shard.get());
+            }
+
+            auto merge_end = std::chrono::steady_clock::now();
+            logger.i("Stitched %zu shards built on %zu threads", shards.size(),
+                     pool.thread_count());
+
+            load_stats.chunk_count = chunk_count;
+            load_stats.partition_time = build_start - partition_start;
+            load_stats.parse_time = merge_start - build_start;
+            load_stats.merge_time = merge_end - merge_start;
         }
     };
 }
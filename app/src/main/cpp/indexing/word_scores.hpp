@@ -0,0 +1,134 @@
+#ifndef CROSSWORD_HELPER_WORD_SCORES_HPP
+#define CROSSWORD_HELPER_WORD_SCORES_HPP
+
+#include "../memory/string_pool.hpp"
+#include "../utils/cancellation.hpp"
+#include "../word_node.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace crossword::indexing {
+
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
+
+    /// Scores of the words of an index, e.g. their frequencies in a corpus.
+    /// Words without a score score zero.
+    /// @details Scores are kept in an array sorted by word handles, so only the scored words
+    /// take memory (8 bytes each), and finding a score takes a binary search.
+    class WordScores final {
+    private:
+        std::vector<std::pair<StringHandle, uint32_t>> by_word;
+
+    public:
+        /// Replaces all the scores. A word scored more than once keeps its highest score.
+        void assign(std::vector<std::pair<StringHandle, uint32_t>> scores) {
+            std::sort(scores.begin(), scores.end());
+
+            // Equal handles are sorted by their scores, so the highest one comes last
+            auto last = std::unique(scores.rbegin(), scores.rend(), [](auto& a, auto& b) {
+                return a.first == b.first;
+            });
+            scores.erase(scores.begin(), last.base());
+            scores.shrink_to_fit();
+            by_word = std::move(scores);
+        }
+
+        /// Forgets all the scores, e.g. once the handles they refer to change.
+        void clear() noexcept {
+            by_word.clear();
+            by_word.shrink_to_fit();
+        }
+
+        /// Checks whether no word has a score.
+        bool empty() const noexcept {
+            return by_word.empty();
+        }
+
+        /// Number of the scored words.
+        size_t size() const noexcept {
+            return by_word.size();
+        }
+
+        /// Finds the score of a word.
+        uint32_t get(StringHandle word) const noexcept {
+            auto it = std::lower_bound(by_word.begin(), by_word.end(), word,
+                                       [](const auto& entry, auto handle) {
+                                           return entry.first < handle;
+                                       });
+            return it != by_word.end() && it->first == word ? it->second : 0;
+        }
+
+        /// Reports how many bytes the scores take.
+        size_t size_bytes() const noexcept {
+            return by_word.capacity() * sizeof(by_word[0]);
+        }
+    };
+
+    /// Collects the best-scored words found by WordNode::search or WordNode::match, up to
+    /// a limit. Words of equal scores come in collation order.
+    /// @details The best words found so far are kept in a bounded min-heap. Once it is full,
+    /// subtrees whose highest score (see WordNode::max_score) cannot beat the worst of them
+    /// are skipped without visiting them, so frequent words of an unselective pattern turn
+    /// up after a small part of its matches. The words have to be stored in collation order
+    /// (see BasicMissingLettersIndex::rank_words): the trie is walked in that order, so
+    /// a later word never wins a tie, and subtrees of equal scores get skipped as well.
+    struct ScoredResults {
+        /// A word and its score.
+        using Entry = std::pair<uint32_t, StringHandle>;
+
+        const WordScores& scores;
+        size_t limit;
+        /// Whether the nodes hold the highest scores of their subtrees.
+        /// Nodes of a minimized trie do not, so all of its matches get scored.
+        bool bounded;
+        const utils::CancellationToken* cancellation = nullptr;
+        /// Min-heap of the best words found so far, with the worst one at the front.
+        std::vector<Entry> best{};
+
+        /// Orders words from the best to the worst.
+        static bool better(const Entry& a, const Entry& b) noexcept {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        }
+
+        bool full() const noexcept {
+            return utils::CancellationToken::is_cancelled(cancellation);
+        }
+
+        void push(StringHandle word) {
+            if (limit == 0) {
+                return;
+            }
+
+            Entry entry{scores.get(word), word};
+            if (best.size() < limit) {
+                best.push_back(entry);
+                std::push_heap(best.begin(), best.end(), better);
+            } else if (better(entry, best.front())) {
+                std::pop_heap(best.begin(), best.end(), better);
+                best.back() = entry;
+                std::push_heap(best.begin(), best.end(), better);
+            }
+        }
+
+        template <typename Cursor>
+        bool descend(WordNode* child, size_t, uint32_t, const Cursor*) const noexcept {
+            return !bounded || best.size() < limit || child->max_score > best.front().first;
+        }
+
+        /// Appends the collected words to the vector, from the best to the worst.
+        void take(std::vector<std::u8string_view>& vec, const StringPool& pool) {
+            std::sort_heap(best.begin(), best.end(), better);
+            for (const auto& [score, word] : best) {
+                vec.push_back(pool.get(word));
+            }
+            best.clear();
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_WORD_SCORES_HPP
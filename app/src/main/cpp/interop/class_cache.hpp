@@ -0,0 +1,72 @@
+#ifndef CROSSWORD_HELPER_CLASS_CACHE_HPP
+#define CROSSWORD_HELPER_CLASS_CACHE_HPP
+
+#include <jni.h>
+
+namespace interop {
+
+    /// Java classes and methods used by the native code.
+    /// @details They are resolved once in JNI_OnLoad, instead of on every call:
+    /// FindClass is slow and on threads attached later, it would not even see the app classes.
+    struct ClassCache {
+        jclass string_class = nullptr;
+        jclass native_shared_pointer_class = nullptr;
+        jmethodID native_shared_pointer_ctor = nullptr;
+        jclass arena_memory_stats_class = nullptr;
+        jmethodID arena_memory_stats_ctor = nullptr;
+        jclass index_memory_stats_class = nullptr;
+        jmethodID index_memory_stats_ctor = nullptr;
+    };
+
+    /// Returns the process-wide class cache.
+    inline ClassCache& class_cache() {
+        static ClassCache cache;
+        return cache;
+    }
+
+    /// Finds a class and pins it with a global reference.
+    /// @returns The global reference, or null if the class does not exist.
+    inline jclass find_global_class(JNIEnv* env, const char* name) {
+        auto local = env->FindClass(name);
+        if (local == nullptr) {
+            return nullptr;
+        }
+
+        auto global = static_cast<jclass>(env->NewGlobalRef(local));
+        env->DeleteLocalRef(local);
+        return global;
+    }
+
+    /// Resolves all the classes and methods of the class cache.
+    /// @returns False if any of them could not be found.
+    inline bool init_class_cache(JNIEnv* env) {
+        auto& cache = class_cache();
+
+        cache.string_class = find_global_class(env, "java/lang/String");
+        cache.native_shared_pointer_class
+            = find_global_class(env, "xyz/lukasz/xword/interop/NativeSharedPointer");
+        cache.arena_memory_stats_class
+            = find_global_class(env, "xyz/lukasz/xword/search/ArenaMemoryStats");
+        cache.index_memory_stats_class
+            = find_global_class(env, "xyz/lukasz/xword/search/IndexMemoryStats");
+        if (cache.string_class == nullptr || cache.native_shared_pointer_class == nullptr
+            || cache.arena_memory_stats_class == nullptr
+            || cache.index_memory_stats_class == nullptr) {
+            return false;
+        }
+
+        cache.native_shared_pointer_ctor
+            = env->GetMethodID(cache.native_shared_pointer_class, "<init>", "(J)V");
+        cache.arena_memory_stats_ctor
+            = env->GetMethodID(cache.arena_memory_stats_class, "<init>",
+                               "(Ljava/lang/String;JJJJ)V");
+        cache.index_memory_stats_ctor
+            = env->GetMethodID(cache.index_memory_stats_class, "<init>",
+                               "([Lxyz/lukasz/xword/search/ArenaMemoryStats;JJJJ[J)V");
+        return cache.native_shared_pointer_ctor != nullptr
+               && cache.arena_memory_stats_ctor != nullptr
+               && cache.index_memory_stats_ctor != nullptr;
+    }
+}
+
+#endif // CROSSWORD_HELPER_CLASS_CACHE_HPP
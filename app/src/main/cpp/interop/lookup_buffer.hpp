@@ -0,0 +1,56 @@
+#ifndef CROSSWORD_HELPER_LOOKUP_BUFFER_HPP
+#define CROSSWORD_HELPER_LOOKUP_BUFFER_HPP
+
+#include "../indexing/word_index.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace interop {
+
+    using ::crossword::indexing::LookupPage;
+
+    /// Writes a lookup page to a buffer shared with Java (a direct ByteBuffer),
+    /// so that the whole page crosses JNI at once, without creating any Java objects.
+    /// @details The layout, in native byte order:
+    /// int32 word count (n), int32 cursor length (c),
+    /// int32 offsets[n + 1] of the words, relative to the start of the word bytes,
+    /// uint8 cursor[c], and then the UTF-8 bytes of all the words, back to back.
+    /// Mirrored by LookupPage.fromBuffer on the Kotlin side.
+    /// @returns Size of the page in bytes. If it exceeds the capacity, nothing has been written.
+    inline size_t write_lookup_page(const LookupPage& page, uint8_t* buffer, size_t capacity) {
+        size_t word_bytes = 0;
+        for (const auto& word : page.words) {
+            word_bytes += word.size();
+        }
+
+        auto header_size = 2 * sizeof(int32_t);
+        auto offsets_size = (page.words.size() + 1) * sizeof(int32_t);
+        auto total_size = header_size + offsets_size + page.cursor.size() + word_bytes;
+        if (total_size > capacity || buffer == nullptr) {
+            return total_size;
+        }
+
+        int32_t counts[2] = {static_cast<int32_t>(page.words.size()),
+                             static_cast<int32_t>(page.cursor.size())};
+        std::memcpy(buffer, counts, header_size);
+
+        auto offsets = buffer + header_size;
+        auto cursor = offsets + offsets_size;
+        auto words = cursor + page.cursor.size();
+        std::memcpy(cursor, page.cursor.data(), page.cursor.size());
+
+        int32_t offset = 0;
+        for (size_t i = 0; i < page.words.size(); ++i) {
+            const auto& word = page.words[i];
+            std::memcpy(offsets + i * sizeof(int32_t), &offset, sizeof(int32_t));
+            std::memcpy(words + offset, word.data(), word.size());
+            offset += static_cast<int32_t>(word.size());
+        }
+        std::memcpy(offsets + page.words.size() * sizeof(int32_t), &offset, sizeof(int32_t));
+
+        return total_size;
+    }
+}
+
+#endif // CROSSWORD_HELPER_LOOKUP_BUFFER_HPP
@@ -0,0 +1,55 @@
+#ifndef CROSSWORD_HELPER_MEMORY_STATS_HPP
+#define CROSSWORD_HELPER_MEMORY_STATS_HPP
+
+#include "../indexing/word_index.hpp"
+#include "class_cache.hpp"
+
+#include <jni.h>
+#include <vector>
+
+namespace interop {
+
+    using ::crossword::indexing::MemoryStats;
+
+    /// Creates an IndexMemoryStats object describing the memory of an index.
+    /// @returns The object, or null if a Java exception is pending.
+    inline jobject to_java_memory_stats(JNIEnv* env, const MemoryStats& stats) {
+        const auto& cache = class_cache();
+
+        auto arena_count = static_cast<jsize>(stats.arenas.size());
+        auto arenas = env->NewObjectArray(arena_count, cache.arena_memory_stats_class, nullptr);
+        if (arenas == nullptr) {
+            return nullptr;
+        }
+
+        for (jsize i = 0; i < arena_count; ++i) {
+            const auto& arena = stats.arenas[static_cast<size_t>(i)];
+            auto name = env->NewStringUTF(arena.name);
+            auto object = env->NewObject(cache.arena_memory_stats_class,
+                                         cache.arena_memory_stats_ctor, name,
+                                         static_cast<jlong>(arena.stats.segment_count),
+                                         static_cast<jlong>(arena.stats.reserved_bytes),
+                                         static_cast<jlong>(arena.stats.used_bytes),
+                                         static_cast<jlong>(arena.stats.released_bytes));
+            env->SetObjectArrayElement(arenas, i, object);
+            env->DeleteLocalRef(object);
+            env->DeleteLocalRef(name);
+        }
+
+        std::vector<jlong> fan_out(stats.fan_out.begin(), stats.fan_out.end());
+        auto fan_out_array = env->NewLongArray(static_cast<jsize>(fan_out.size()));
+        if (fan_out_array == nullptr) {
+            return nullptr;
+        }
+        env->SetLongArrayRegion(fan_out_array, 0, static_cast<jsize>(fan_out.size()),
+                                fan_out.data());
+
+        return env->NewObject(cache.index_memory_stats_class, cache.index_memory_stats_ctor,
+                              arenas, static_cast<jlong>(stats.other_bytes),
+                              static_cast<jlong>(stats.node_count),
+                              static_cast<jlong>(stats.chunk_count),
+                              static_cast<jlong>(stats.word_count), fan_out_array);
+    }
+}
+
+#endif // CROSSWORD_HELPER_MEMORY_STATS_HPP
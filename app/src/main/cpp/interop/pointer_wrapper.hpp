@@ -1,7 +1,7 @@
 #ifndef CROSSWORD_HELPER_POINTER_WRAPPER_HPP
 #define CROSSWORD_HELPER_POINTER_WRAPPER_HPP
 
-#include "objects.hpp"
+#include "class_cache.hpp"
 
 #include <jni.h>
 #include <memory>
@@ -16,8 +16,18 @@ namespace interop {
     jobject wrap_shared_ptr(JNIEnv* env, std::shared_ptr<T>&& ptr) {
         std::shared_ptr<T>* new_pointer = new std::shared_ptr<T>();
         new_pointer->swap(ptr);
-        return interop::construct(env, "xyz/lukasz/xword/interop/NativeSharedPointer",
-                                  reinterpret_cast<jlong>(new_pointer));
+        const auto& cache = class_cache();
+        return env->NewObject(cache.native_shared_pointer_class, cache.native_shared_pointer_ctor,
+                              reinterpret_cast<jlong>(new_pointer));
+    }
+
+    /// Creates a Java NativeSharedPointer proxy object that does not point to anything.
+    /// @returns Java NativeSharedPointer object.
+    /// @param env JNI environment.
+    inline jobject null_shared_ptr(JNIEnv* env) {
+        const auto& cache = class_cache();
+        return env->NewObject(cache.native_shared_pointer_class, cache.native_shared_pointer_ctor,
+                              static_cast<jlong>(0));
     }
 
     /// Unwraps Java NativeSharedPointer object into a std::shared_ptr<T>.
@@ -0,0 +1,272 @@
+#ifndef CROSSWORD_HELPER_ALPHABET_HPP
+#define CROSSWORD_HELPER_ALPHABET_HPP
+
+#include "../utils/utf8.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace crossword::locale {
+
+    /// A letter of an alphabet, encoded as a small integer.
+    using Symbol = uint8_t;
+
+    /// Matches any single symbol in a pattern. Never assigned to a letter.
+    constexpr Symbol wildcard = 0;
+
+    /// Stands for every codepoint that is not a part of the alphabet.
+    constexpr Symbol unknown = UINT8_MAX;
+
+    /// Checks whether a word matches a pattern, comparing case-folded codepoints.
+    /// A dot . (0x2E) in the pattern matches any single codepoint.
+    inline bool pattern_matches(std::u8string_view word, std::u8string_view pattern) {
+        auto word_it = word.data();
+        auto word_end = word_it + word.length();
+        auto pattern_it = pattern.data();
+        auto pattern_end = pattern_it + pattern.length();
+
+        while (word_it < word_end && pattern_it < pattern_end) {
+            auto expected = utils::decode_codepoint(pattern_it, pattern_end);
+            auto actual = utils::decode_codepoint(word_it, word_end);
+            if (expected != U'.' && utils::fold_case(expected) != utils::fold_case(actual)) {
+                return false;
+            }
+        }
+
+        return word_it == word_end && pattern_it == pattern_end;
+    }
+
+    /// Maps the letters of a locale to dense symbols, so that every letter,
+    /// no matter how many bytes its UTF-8 representation takes, is a single trie level.
+    /// @tparam Letters Type with a static constexpr std::u32string_view letters member,
+    ///                 listing lowercase letters of the alphabet in their collation order.
+    /// @details Letters are case-folded before mapping, so upper- and lowercase letters
+    /// share a symbol. Symbols are assigned in the order of the letters, starting from 1.
+    template <typename Letters>
+    class Alphabet final {
+    private:
+        /// Codepoints below this limit are mapped with a direct lookup table.
+        static constexpr char32_t table_limit = 0x180;
+
+        static constexpr std::array<Symbol, table_limit> build_table() {
+            std::array<Symbol, table_limit> table{};
+            table.fill(unknown);
+            for (size_t i = 0; i < Letters::letters.size(); ++i) {
+                auto letter = Letters::letters[i];
+                if (letter < table_limit) {
+                    table[letter] = static_cast<Symbol>(i + 1);
+                }
+            }
+            return table;
+        }
+
+        static constexpr uint32_t build_id() {
+            uint32_t hash = 2166136261u;
+            for (auto letter : Letters::letters) {
+                hash ^= static_cast<uint32_t>(letter);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        static constexpr std::array<Symbol, table_limit> table = build_table();
+
+        /// Finds where a page of results ends, so that words of equal symbols (which differ
+        /// only in letters outside of the alphabet) do not get split by the cursor,
+        /// which could not tell them apart. Such words end the page early, unless they start it,
+        /// and then the page gets longer instead.
+        static size_t page_end(const std::vector<std::u8string_view>& results,
+                               const size_t max_results) {
+            std::vector<Symbol> last;
+            std::vector<Symbol> other;
+            encode_word(results[max_results - 1], last);
+            auto shares_symbols = [&](size_t i) {
+                encode_word(results[i], other);
+                return other == last;
+            };
+
+            if (!shares_symbols(max_results)) [[likely]] {
+                return max_results;
+            }
+
+            auto start = max_results - 1;
+            while (start > 0 && shares_symbols(start - 1)) {
+                --start;
+            }
+            if (start > 0) {
+                return start;
+            }
+
+            auto end = max_results + 1;
+            while (end < results.size() && shares_symbols(end)) {
+                ++end;
+            }
+            return end;
+        }
+
+    public:
+        static_assert(Letters::letters.size() < unknown, "Alphabet has too many letters");
+
+        /// Number of letters in the alphabet.
+        static constexpr size_t size = Letters::letters.size();
+
+        /// Identifies the alphabet, e.g. in serialized indexes.
+        static constexpr uint32_t id = build_id();
+
+        /// Maps a codepoint to its symbol, or to the unknown symbol.
+        static constexpr Symbol to_symbol(char32_t codepoint) {
+            auto folded = utils::fold_case(codepoint);
+            if (folded < table_limit) [[likely]] {
+                return table[folded];
+            }
+
+            auto position = Letters::letters.find(folded);
+            if (position == std::u32string_view::npos) {
+                return unknown;
+            }
+            return static_cast<Symbol>(position + 1);
+        }
+
+        /// Maps a symbol back to its (lowercase) letter.
+        static constexpr char32_t to_codepoint(Symbol symbol) {
+            if (symbol == wildcard || symbol > size) {
+                return U'\uFFFD';
+            }
+            return Letters::letters[symbol - 1];
+        }
+
+        /// Encodes a word as a sequence of symbols.
+        /// @returns False if any of the codepoints is not a part of the alphabet.
+        static bool encode_word(std::u8string_view word, std::vector<Symbol>& symbols) {
+            symbols.clear();
+
+            auto all_known = true;
+            auto it = word.data();
+            auto end = it + word.length();
+            while (it < end) {
+                auto symbol = to_symbol(utils::decode_codepoint(it, end));
+                all_known &= symbol != unknown;
+                symbols.push_back(symbol);
+            }
+
+            return all_known;
+        }
+
+        /// Encodes a pattern as a sequence of symbols, where a dot . (0x2E) becomes a wildcard.
+        /// @returns False if any of the codepoints is not a part of the alphabet.
+        static bool encode_pattern(const std::u8string& pattern, std::vector<Symbol>& symbols) {
+            symbols.clear();
+
+            auto all_known = true;
+            auto it = pattern.data();
+            auto end = it + pattern.length();
+            while (it < end) {
+                auto codepoint = utils::decode_codepoint(it, end);
+                auto symbol = codepoint == U'.' ? wildcard : to_symbol(codepoint);
+                all_known &= symbol != unknown;
+                symbols.push_back(symbol);
+            }
+
+            return all_known;
+        }
+
+        /// Looks up a pattern using the provided symbol-based search function.
+        /// The results are views of the words stored in the searched index.
+        /// All codepoints outside of the alphabet share a single symbol,
+        /// so if the pattern contains any of them, the results have to be verified.
+        /// @param find Function taking the encoded pattern, the result vector, the limit
+        ///             and the symbols of the word to resume after (or null).
+        template <typename F>
+        static std::vector<std::u8string_view>
+        lookup(const std::u8string& pattern, const size_t max_results, F&& find) {
+            return lookup(pattern, max_results, {}, nullptr, std::forward<F>(find));
+        }
+
+        /// Looks up a page of results, in the order of their symbols.
+        /// @param cursor Symbols of the last word of the previous page, or empty for the first one.
+        ///               A cursor of a different pattern yields no results.
+        /// @param next_cursor If not null, receives symbols of the last word of this page,
+        ///                    or is cleared if there are no more results after this page.
+        template <typename F>
+        static std::vector<std::u8string_view> lookup(const std::u8string& pattern,
+                                                      const size_t max_results,
+                                                      const std::vector<Symbol>& cursor,
+                                                      std::vector<Symbol>* next_cursor,
+                                                      F&& find) {
+            std::vector<Symbol> symbols;
+            std::vector<std::u8string_view> results;
+
+            auto all_known = encode_pattern(pattern, symbols);
+            if (!cursor.empty() && cursor.size() != symbols.size()) [[unlikely]] {
+                if (next_cursor != nullptr) {
+                    next_cursor->clear();
+                }
+                return results;
+            }
+
+            auto after = cursor.empty() ? nullptr : cursor.data();
+
+            // Look for one more word than needed to know if there is another page
+            auto limit = std::min(max_results, static_cast<size_t>(INT32_MAX - 1));
+            if (next_cursor != nullptr) {
+                ++limit;
+            }
+
+            if (all_known) [[likely]] {
+                find(symbols, results, limit, after);
+            } else {
+                find(symbols, results, static_cast<size_t>(INT32_MAX), after);
+                std::erase_if(results,
+                              [&](const auto& word) { return !pattern_matches(word, pattern); });
+            }
+
+            trim_page(results, max_results, cursor, next_cursor);
+            return results;
+        }
+
+        /// Cuts the results of a lookup down to a page and points the next cursor past it.
+        /// @param results Results of the lookup, with one more than max_results requested
+        ///                if the next cursor is needed, to know whether there is another page.
+        /// @details Words of equal symbols stay on the same page (see page_end),
+        /// so a page may come out a few words shorter or longer than max_results.
+        static void trim_page(std::vector<std::u8string_view>& results,
+                              const size_t max_results,
+                              const std::vector<Symbol>& cursor,
+                              std::vector<Symbol>* next_cursor) {
+            if (next_cursor != nullptr) {
+                next_cursor->clear();
+                if (results.size() > max_results && max_results > 0) {
+                    results.resize(page_end(results, max_results));
+                    encode_word(results.back(), *next_cursor);
+                } else if (results.size() > max_results) {
+                    // An empty page does not move the cursor
+                    *next_cursor = cursor;
+                    results.clear();
+                }
+                return;
+            }
+
+            if (results.size() > max_results) {
+                results.resize(max_results);
+            }
+        }
+
+    };
+
+    namespace letters {
+
+        struct Polish {
+            static constexpr std::u32string_view letters = U"aąbcćdeęfghijklłmnńoópqrsśtuvwxyzźż";
+        };
+    }
+
+    /// Alphabet of the pl_PL dictionary.
+    /// Besides the Polish letters, it also includes q, v and x found in loanwords.
+    using pl_PL = Alphabet<letters::Polish>;
+}
+
+#endif // CROSSWORD_HELPER_ALPHABET_HPP
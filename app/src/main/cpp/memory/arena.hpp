@@ -1,6 +1,7 @@
 #ifndef CROSSWORD_HELPER_ARENA_HPP
 #define CROSSWORD_HELPER_ARENA_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <memory>
@@ -58,6 +59,21 @@ namespace crossword::memory {
             return used + n <= size;
         }
 
+        /// Returns how many slots this segment has.
+        constexpr inline size_t capacity() const noexcept {
+            return size;
+        }
+
+        /// Returns how many slots have been allocated in this segment.
+        constexpr inline size_t used_count() const noexcept {
+            return used;
+        }
+
+        /// Returns the object at the provided slot.
+        inline T* at(size_t offset) const noexcept {
+            return data.get() + offset;
+        }
+
         /// Allocates a single object.
         /// This method does NOT check whether the segment is full.
         inline T* alloc() {
@@ -84,15 +100,48 @@ namespace crossword::memory {
     static_assert(sizeof(ArenaSegment<int>) == 3 * sizeof(void*),
                   "ArenaSegment has to be 3 pointers in size");
 
+    /// Describes how much memory an Arena takes.
+    struct ArenaStats {
+        /// How many segments does the arena have?
+        size_t segment_count = 0;
+        /// Bytes taken by all the slots of the segments.
+        size_t reserved_bytes = 0;
+        /// Bytes taken by the allocated slots, including the released ones.
+        /// The rest of the reserved bytes is either not allocated yet, or has been skipped
+        /// at the end of a segment, because an array did not fit there.
+        size_t used_bytes = 0;
+        /// Bytes taken by the released slots, which wait to be reused (see Arena::release_index).
+        size_t released_bytes = 0;
+    };
+
+    /// Refers to an object allocated in an Arena, as a 32-bit alternative to a pointer.
+    /// @details The upper bits select a segment, the lower ones a slot inside of it.
+    using ArenaIndex = uint32_t;
+
     template <typename T, bool value_init = true>
     class Arena {
+    public:
+        /// Marks the absence of an object.
+        static constexpr ArenaIndex no_index = UINT32_MAX;
+
     private:
+        /// How many bits of an index select a slot inside of a segment?
+        static constexpr int segment_bits = 14;
+
+        /// Runs longer than this are not recycled.
+        static constexpr size_t max_free_run = 32;
+
         const size_t min_size = 512;
-        const size_t typical_size = 16384;
+        static constexpr size_t typical_size = size_t{1} << segment_bits;
 
         std::vector<ArenaSegment<T, value_init>> segments;
         size_t current_segment;
 
+        /// Released runs of objects, by their lengths (see release_index).
+        std::vector<std::vector<ArenaIndex>> free_runs;
+        /// How many objects have been allocated from the released runs?
+        size_t reused;
+
         /// Creates a new segment with default size.
         inline void push_new_segment() {
             push_new_segment(typical_size);
@@ -110,12 +159,33 @@ namespace crossword::memory {
 
     public:
         /// Creates a new Arena allocator.
-        Arena() : current_segment(0) {
+        Arena() : current_segment(0), reused(0) {
             push_new_segment();
         }
 
+        /// How much do the indices of another arena increase, when it gets merged into this one?
+        /// @details Its segments get appended after the segments of this arena.
+        ArenaIndex merge_shift() const noexcept {
+            return static_cast<ArenaIndex>(segments.size() << segment_bits);
+        }
+
         /// Moves all segments belonging to some other Arena to this Arena.
+        /// Pointers to their objects stay valid, but indices have to be shifted
+        /// (see merge_shift). Runs released in the other arena can be reused by this one.
         void merge(Arena<T, value_init>* other) {
+            auto shift = merge_shift();
+            if (free_runs.size() < other->free_runs.size()) {
+                free_runs.resize(other->free_runs.size());
+            }
+            for (size_t n = 0; n < other->free_runs.size(); ++n) {
+                for (auto index : other->free_runs[n]) {
+                    free_runs[n].push_back(index + shift);
+                }
+            }
+            reused += other->reused;
+            other->free_runs.clear();
+            other->reused = 0;
+
             auto it = std::make_move_iterator(other->segments.begin());
             auto end = std::make_move_iterator(other->segments.end());
             while (it != end) {
@@ -158,6 +228,74 @@ namespace crossword::memory {
             return segment->alloc(n);
         }
 
+        /// Allocates a contiguous array of n objects, like alloc.
+        /// Returns the index of the first element of this array.
+        /// @details n must not be larger than a typical segment, since an index
+        /// can only point to one of its slots. Arrays allocated by index are contiguous,
+        /// so the index of the first element is enough to resolve all of them.
+        ArenaIndex alloc_index(size_t n = 1) {
+            if (n < free_runs.size() && !free_runs[n].empty()) {
+                auto index = free_runs[n].back();
+                free_runs[n].pop_back();
+                reused += n;
+                return index;
+            }
+
+            auto first = alloc(n);
+            auto offset = static_cast<size_t>(first - segments[current_segment].at(0));
+            return static_cast<ArenaIndex>((current_segment << segment_bits) | offset);
+        }
+
+        /// Resolves an index returned by alloc_index to the object it points to.
+        inline T* at(ArenaIndex index) const noexcept {
+            auto& segment = segments[index >> segment_bits];
+            return segment.at(index & (typical_size - 1));
+        }
+
+        /// Gives back a run of n objects allocated by alloc_index, which is no longer used.
+        /// The next allocation of exactly n objects takes it again, instead of new slots.
+        /// @details The objects are not destroyed, nor reset, so they have to be overwritten.
+        /// Released slots are still visited by for_each. An arena that releases runs must not
+        /// use dealloc_last, since the last allocation might have been a reused run.
+        void release_index(ArenaIndex index, size_t n) {
+            if (n == 0 || n > max_free_run) {
+                return;
+            }
+            if (free_runs.size() <= n) {
+                free_runs.resize(n + 1);
+            }
+            free_runs[n].push_back(index);
+        }
+
+        /// Reports how much memory this arena takes.
+        ArenaStats stats() const noexcept {
+            ArenaStats stats;
+            stats.segment_count = segments.size();
+            for (const auto& segment : segments) {
+                stats.reserved_bytes += segment.capacity() * sizeof(T);
+                stats.used_bytes += segment.used_count() * sizeof(T);
+            }
+            for (size_t n = 0; n < free_runs.size(); ++n) {
+                stats.released_bytes += free_runs[n].size() * n * sizeof(T);
+            }
+            return stats;
+        }
+
+        /// Reports how many objects have been allocated from released runs, instead of new slots.
+        size_t reused_count() const noexcept {
+            return reused;
+        }
+
+        /// Calls the provided function for every allocated object, in order of allocation.
+        template <typename F>
+        void for_each(F&& fn) const {
+            for (auto& segment : segments) {
+                for (size_t i = 0; i < segment.used_count(); ++i) {
+                    fn(*segment.at(i));
+                }
+            }
+        }
+
         /// Deallocates the last allocated object
         /// (decrements the internal pointer by one).
         inline void dealloc_last() noexcept {
@@ -0,0 +1,136 @@
+#ifndef CROSSWORD_HELPER_STRING_POOL_HPP
+#define CROSSWORD_HELPER_STRING_POOL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace crossword::memory {
+
+    /// Refers to a string in a StringPool: the offset of its length byte.
+    using StringHandle = uint32_t;
+
+    /// An append-only pool of short strings, stored back to back as length-prefixed UTF-8:
+    /// a single length byte, followed by the bytes of the string.
+    /// @details Strings are referred to by 32-bit handles instead of pointers,
+    /// so the pool can grow, move and be written to a file as a single block of bytes
+    /// (it has the layout of the prebuilt index word table, see indexing::prebuilt).
+    /// A pool may start at a base offset instead of zero. Pools of disjoint offset ranges
+    /// can be appended to each other without changing the handles of their strings.
+    class StringPool final {
+    private:
+        std::vector<uint8_t> bytes;
+        size_t base;
+
+    public:
+        /// Marks the absence of a string.
+        static constexpr StringHandle no_string = UINT32_MAX;
+
+        /// Longest string that fits in the pool, in bytes.
+        static constexpr size_t max_length = UINT8_MAX;
+
+        /// How many bytes of the pool does a string of the provided length take?
+        static constexpr size_t stored_size(size_t length) noexcept {
+            return 1 + length;
+        }
+
+        /// Creates an empty pool, starting at the provided offset.
+        explicit StringPool(size_t base = 0) : base(base) {}
+
+        /// Offset of the first string of the pool.
+        size_t begin_offset() const noexcept {
+            return base;
+        }
+
+        /// Offset the next string of the pool will be stored at.
+        size_t end_offset() const noexcept {
+            return base + bytes.size();
+        }
+
+        /// Reports how many bytes the strings of the pool take.
+        size_t size_bytes() const noexcept {
+            return bytes.size();
+        }
+
+        /// Exposes the bytes of the pool, starting at its base offset.
+        const uint8_t* data() const noexcept {
+            return bytes.data();
+        }
+
+        /// Moves the start of an empty pool to the provided offset.
+        /// @returns False if the pool already holds some strings.
+        bool start_at(size_t offset) noexcept {
+            if (!bytes.empty()) {
+                return false;
+            }
+            base = offset;
+            return true;
+        }
+
+        /// Copies a string to the end of the pool.
+        /// @returns Handle of the stored string, or no_string if it is too long
+        /// or the pool has run out of 32-bit offsets.
+        StringHandle add(std::u8string_view str) {
+            if (str.size() > max_length || end_offset() + stored_size(str.size()) > no_string)
+                [[unlikely]] {
+                return no_string;
+            }
+
+            auto handle = static_cast<StringHandle>(end_offset());
+            bytes.push_back(static_cast<uint8_t>(str.size()));
+            bytes.insert(bytes.end(), str.begin(), str.end());
+            return handle;
+        }
+
+        /// Returns a view of a stored string, valid until the pool grows again.
+        std::u8string_view get(StringHandle handle) const noexcept {
+            auto string = bytes.data() + (handle - base);
+            return std::u8string_view(reinterpret_cast<const char8_t*>(string + 1), string[0]);
+        }
+
+        /// Recovers the handle of a string from a view returned by get.
+        StringHandle handle_of(std::u8string_view string) const noexcept {
+            auto offset = reinterpret_cast<const uint8_t*>(string.data()) - bytes.data() - 1;
+            return static_cast<StringHandle>(base + static_cast<size_t>(offset));
+        }
+
+        /// Calls fn(handle, string) for every non-empty string of the pool, in order of handles.
+        /// Gaps left by append are zeroed, so they read as runs of empty strings and get skipped.
+        template <typename F>
+        void for_each(F&& fn) const {
+            size_t offset = 0;
+            while (offset < bytes.size()) {
+                auto length = bytes[offset];
+                if (length > 0) {
+                    auto handle = static_cast<StringHandle>(base + offset);
+                    fn(handle, get(handle));
+                }
+                offset += stored_size(length);
+            }
+        }
+
+        /// Checks whether the other pool can be appended without running out of offsets.
+        bool can_append(const StringPool& other) const noexcept {
+            return std::max(end_offset(), other.base) + other.bytes.size() <= no_string;
+        }
+
+        /// Copies the strings of the other pool to the end of this one.
+        /// If the other pool starts at or after the end of this one, it keeps its offsets
+        /// (the gap is filled with zeros). Otherwise, it gets placed right at the end.
+        /// @returns How much the handles of the other pool have to be increased by.
+        size_t append(const StringPool& other) {
+            if (other.base >= end_offset()) {
+                bytes.resize(other.base - base, 0);
+                bytes.insert(bytes.end(), other.bytes.begin(), other.bytes.end());
+                return 0;
+            }
+
+            auto shift = end_offset() - other.base;
+            bytes.insert(bytes.end(), other.bytes.begin(), other.bytes.end());
+            return shift;
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_STRING_POOL_HPP
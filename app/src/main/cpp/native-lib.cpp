@@ -1,49 +1,163 @@
 #include "indexing/anagrams.hpp"
+#include "indexing/front_coded.hpp"
 #include "indexing/missing_letters.hpp"
+#include "indexing/prebuilt.hpp"
+#include "indexing/rhymes.hpp"
 #include "indexing/word_index.hpp"
+#include "interop/class_cache.hpp"
+#include "interop/lookup_buffer.hpp"
+#include "interop/memory_stats.hpp"
 #include "interop/pointer_wrapper.hpp"
 #include "interop/strings.hpp"
 #include "utils/android.hpp"
+#include "utils/cancellation.hpp"
+#include "utils/log.hpp"
 #include "utils/utf8.hpp"
 
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 #include <android/log.h>
+#include <algorithm>
 #include <jni.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace crossword::utils;
 using namespace crossword::utils::android;
 using crossword::indexing::AnagramIndex;
 using crossword::indexing::MissingLettersIndex;
+using crossword::indexing::PrebuiltIndex;
+using crossword::indexing::RhymeIndex;
 using crossword::indexing::WordIndex;
 using crossword::utils::android::AssetManager;
 using crossword::utils::android::AssetOpenMode;
 
+namespace front_coded = crossword::indexing::front_coded;
+
+/// Words of a dictionary asset as plain text, one word per line.
+struct DictionaryText {
+    /// Keeps the text alive: either the asset itself or the text decoded from it.
+    std::shared_ptr<const void> owner;
+    const uint8_t* buffer = nullptr;
+    size_t length = 0;
+};
+
+/// Opens a dictionary asset, either plain text or front-coded (see front_coded::Header).
+/// Front-coded dictionaries get decoded in parallel, and the asset gets closed afterwards.
+/// @returns Text with a null buffer if the asset does not exist or is malformed.
+static DictionaryText open_dictionary(AssetManager& asset_manager,
+                                      std::u8string& filename,
+                                      int thread_count) {
+    auto asset = asset_manager.open_shared_asset(filename, AssetOpenMode::Buffer);
+    auto buffer = asset != nullptr ? asset->get_buffer() : nullptr;
+    if (buffer == nullptr) {
+        return {};
+    }
+
+    auto length = static_cast<size_t>(asset->length());
+    if (!front_coded::is_front_coded(buffer, length)) {
+        return {std::move(asset), buffer, length};
+    }
+
+    front_coded::Dictionary dictionary;
+    if (!dictionary.open(buffer, length)) {
+        return {};
+    }
+
+    auto text = std::make_shared<const std::vector<uint8_t>>(dictionary.decode(thread_count));
+    if (text->empty()) {
+        return {};
+    }
+    return {text, text->data(), text->size()};
+}
+
 extern "C" JNIEXPORT jobject JNICALL
 Java_xyz_lukasz_xword_search_MissingLettersIndex_loadNative(JNIEnv* env,
                                                             [[maybe_unused]] jobject thiz,
                                                             jobject jasset_mgr,
                                                             jstring path,
-                                                            jint thread_count) {
-    // Mmap the whole uncompressed file
+                                                            jstring scores_path,
+                                                            jint thread_count,
+                                                            jboolean minimize,
+                                                            jboolean compress,
+                                                            jboolean suffixes,
+                                                            jboolean positions) {
+    // Mmap the whole uncompressed file.
+    // The index copies the words into its own pool, so the text gets released once loaded
     auto filename = interop::copy_utf8_string(env, path);
     auto asset_manager = AssetManager::from_java(env, jasset_mgr);
-    auto asset = asset_manager.open_asset(filename, AssetOpenMode::Buffer);
-
-    off_t start = 0;
-    off_t length = asset.length();
+    auto text = open_dictionary(asset_manager, filename, thread_count);
 
     auto index = std::make_shared<MissingLettersIndex>();
-    auto fd = asset.open_file_descriptor(&start, &length);
-    if (fd >= 0) {
-        auto buffer = asset.get_buffer();
-        if (buffer != nullptr) {
-            index->load_from_buffer_parallel(buffer, static_cast<int>(length), thread_count);
+    if (text.buffer != nullptr) {
+        auto length = static_cast<int>(text.length);
+        index->load_from_buffer_sharded(text.buffer, length, thread_count);
+    }
+    text = {};
+
+    // Scores are optional, a dictionary without them keeps returning words alphabetically
+    if (scores_path != nullptr) {
+        auto scores_filename = interop::copy_utf8_string(env, scores_path);
+        auto scores_asset = asset_manager.open_shared_asset(scores_filename,
+                                                            AssetOpenMode::Buffer);
+        auto scores_buffer = scores_asset != nullptr ? scores_asset->get_buffer() : nullptr;
+        if (scores_buffer != nullptr) {
+            index->load_scores(scores_buffer, static_cast<size_t>(scores_asset->length()));
         }
     }
 
+    if (minimize) {
+        index->minimize();
+    }
+
+    if (compress) {
+        index->compress();
+    }
+
+    if (suffixes) {
+        index->build_suffix_trie();
+    }
+
+    if (positions) {
+        index->build_positional_index();
+    }
+
+    // Patterns starting with wildcards fan out across the whole trie, so split them up
+    auto lookup_threads = static_cast<size_t>(std::max(thread_count, 1));
+    index->set_parallel_lookup({.thread_count = lookup_threads, .split_depth = 2});
+
+    // Typing a pattern mostly fills in its dots, so cached results can be filtered instead
+    index->enable_query_cache();
+
+    return interop::wrap_shared_ptr(env, std::move(index));
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_xyz_lukasz_xword_search_MissingLettersIndex_loadPrebuiltNative(JNIEnv* env,
+                                                                    [[maybe_unused]] jobject thiz,
+                                                                    jobject jasset_mgr,
+                                                                    jstring path) {
+    // The prebuilt index is served straight from the mapped asset,
+    // so the asset has to stay open for as long as the index lives
+    auto filename = interop::copy_utf8_string(env, path);
+    auto asset_manager = AssetManager::from_java(env, jasset_mgr);
+    auto asset = asset_manager.open_shared_asset(filename, AssetOpenMode::Buffer);
+    if (asset == nullptr) {
+        return interop::null_shared_ptr(env);
+    }
+
+    auto index = std::make_shared<PrebuiltIndex>();
+    auto buffer = asset->get_buffer();
+    if (buffer != nullptr) {
+        index->load_from_buffer(buffer, 0, static_cast<size_t>(asset->length()));
+        index->retain(std::move(asset));
+    }
+
+    if (!index->valid()) {
+        return interop::null_shared_ptr(env);
+    }
+
     return interop::wrap_shared_ptr(env, std::move(index));
 }
 
@@ -53,26 +167,60 @@ Java_xyz_lukasz_xword_search_AnagramIndex_loadNative(JNIEnv* env,
                                                      jobject jasset_mgr,
                                                      jstring path,
                                                      jint thread_count) {
-    // Mmap the whole uncompressed file
+    // Mmap the whole uncompressed file.
+    // The index keeps views of the words, so the text has to stay alive as long as it lives
     auto filename = interop::copy_utf8_string(env, path);
     auto asset_manager = AssetManager::from_java(env, jasset_mgr);
-    auto asset = asset_manager.open_asset(filename, AssetOpenMode::Buffer);
-
-    off_t start = 0;
-    off_t length = asset.length();
+    auto text = open_dictionary(asset_manager, filename, thread_count);
 
     auto index = std::make_shared<AnagramIndex>();
-    auto fd = asset.open_file_descriptor(&start, &length);
-    if (fd >= 0) {
-        auto buffer = asset.get_buffer();
-        if (buffer != nullptr) {
-            index->load_from_buffer_parallel(buffer, static_cast<int>(length), thread_count);
-        }
+    if (text.buffer != nullptr) {
+        auto length = static_cast<int>(text.length);
+        index->load_from_buffer_parallel(text.buffer, length, thread_count);
+        index->retain(std::move(text.owner));
+    }
+
+    return interop::wrap_shared_ptr(env, std::move(index));
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_xyz_lukasz_xword_search_RhymeIndex_loadNative(JNIEnv* env,
+                                                   [[maybe_unused]] jobject thiz,
+                                                   jobject jasset_mgr,
+                                                   jstring path,
+                                                   jint thread_count) {
+    // Mmap the whole uncompressed file.
+    // The index copies the words into its own pool, so the text gets released once loaded
+    auto filename = interop::copy_utf8_string(env, path);
+    auto asset_manager = AssetManager::from_java(env, jasset_mgr);
+    auto text = open_dictionary(asset_manager, filename, thread_count);
+
+    auto index = std::make_shared<RhymeIndex>();
+    if (text.buffer != nullptr) {
+        auto length = static_cast<int>(text.length);
+        index->load_from_buffer_parallel(text.buffer, length, thread_count);
     }
+    text = {};
+
+    index->compress();
 
     return interop::wrap_shared_ptr(env, std::move(index));
 }
 
+/// Maps found words to a Java string array.
+static jobjectArray to_string_array(JNIEnv* env, const std::vector<std::u8string>& words) {
+    auto array_size = static_cast<jsize>(words.size());
+    auto results = env->NewObjectArray(array_size, interop::class_cache().string_class, nullptr);
+    for (size_t i = 0; i < words.size(); ++i) {
+        auto c_str = reinterpret_cast<const char*>(words.at(i).c_str());
+        auto found_word = env->NewStringUTF(c_str);
+        env->SetObjectArrayElement(results, static_cast<jsize>(i), found_word);
+        env->DeleteLocalRef(found_word);
+    }
+
+    return results;
+}
+
 extern "C" JNIEXPORT jobjectArray JNICALL
 Java_xyz_lukasz_xword_search_WordIndex_lookupNative(JNIEnv* env,
                                                     [[maybe_unused]] jobject thiz,
@@ -85,19 +233,97 @@ Java_xyz_lukasz_xword_search_WordIndex_lookupNative(JNIEnv* env,
 
     // Find all the matching words
     auto result_vec = index->lookup(query, maxResults);
+    return to_string_array(env, result_vec);
+}
 
-    // Map found words to a Java string array
-    auto string_clazz = env->FindClass("java/lang/String");
-    auto array_size = static_cast<jsize>(result_vec.size());
-    auto results = env->NewObjectArray(array_size, string_clazz, nullptr);
-    for (size_t i = 0; i < result_vec.size(); ++i) {
-        auto c_str = reinterpret_cast<const char*>(result_vec.at(i).c_str());
-        auto found_word = env->NewStringUTF(c_str);
-        env->SetObjectArrayElement(results, static_cast<jsize>(i), found_word);
-        env->DeleteLocalRef(found_word);
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_xyz_lukasz_xword_search_MissingLettersIndex_lookupBestNative(JNIEnv* env,
+                                                                  [[maybe_unused]] jobject thiz,
+                                                                  jlong native_ptr,
+                                                                  jstring jquery,
+                                                                  jint maxResults) {
+    auto query = interop::copy_utf8_string(env, jquery);
+    auto index = interop::unwrap_shared_ptr<WordIndex>(native_ptr);
+
+    // Prebuilt indexes hold no scores, so their words come alphabetically
+    auto scored_index = dynamic_cast<MissingLettersIndex*>(index.get());
+    auto result_vec = scored_index != nullptr ? scored_index->lookup_best(query, maxResults)
+                                              : index->lookup(query, maxResults);
+    return to_string_array(env, result_vec);
+}
+
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_xyz_lukasz_xword_search_WordIndex_lookupPageNative(JNIEnv* env,
+                                                        [[maybe_unused]] jobject thiz,
+                                                        jlong native_ptr,
+                                                        jstring jquery,
+                                                        jint maxResults,
+                                                        jbyteArray jcursor,
+                                                        jobject jbuffer,
+                                                        jlong cancellation_ptr) {
+    // Marshal Java arguments to native
+    auto query = interop::copy_utf8_string(env, jquery);
+    auto index = interop::unwrap_shared_ptr<WordIndex>(native_ptr);
+
+    // The token stays alive until the lookup returns, even if Java frees it meanwhile
+    std::shared_ptr<CancellationToken> cancellation;
+    if (cancellation_ptr != 0) {
+        cancellation = interop::unwrap_shared_ptr<CancellationToken>(cancellation_ptr);
     }
 
-    return results;
+    std::vector<uint8_t> cursor;
+    if (jcursor != nullptr) {
+        cursor.resize(static_cast<size_t>(env->GetArrayLength(jcursor)));
+        env->GetByteArrayRegion(jcursor, 0, static_cast<jsize>(cursor.size()),
+                                reinterpret_cast<jbyte*>(cursor.data()));
+    }
+
+    // Find the next page of matching words
+    auto page = index->lookup_page(query, std::max(maxResults, 0), cursor, cancellation.get());
+
+    // Copy the words straight from the index to the buffer
+    auto buffer = static_cast<uint8_t*>(env->GetDirectBufferAddress(jbuffer));
+    auto capacity = static_cast<size_t>(std::max(env->GetDirectBufferCapacity(jbuffer), jlong{0}));
+    auto size = interop::write_lookup_page(page, buffer, capacity);
+    if (size <= capacity && buffer != nullptr) [[likely]] {
+        return nullptr;
+    }
+    if (size > static_cast<size_t>(INT32_MAX)) [[unlikely]] {
+        log::tag("lookupPageNative").w("Page too big: %zu bytes", size);
+        return env->NewByteArray(0);
+    }
+
+    // A page that does not fit gets returned on its own, instead of being looked up again
+    std::vector<uint8_t> bytes(size);
+    interop::write_lookup_page(page, bytes.data(), bytes.size());
+    auto array = env->NewByteArray(static_cast<jsize>(size));
+    if (array != nullptr) {
+        env->SetByteArrayRegion(array, 0, static_cast<jsize>(size),
+                                reinterpret_cast<const jbyte*>(bytes.data()));
+    }
+    return array;
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_xyz_lukasz_xword_search_LookupCancellation_createNative(JNIEnv* env,
+                                                             [[maybe_unused]] jclass clazz) {
+    return interop::wrap_shared_ptr(env, std::make_shared<CancellationToken>());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_xyz_lukasz_xword_search_LookupCancellation_cancelNative([[maybe_unused]] JNIEnv* env,
+                                                             [[maybe_unused]] jclass clazz,
+                                                             jlong native_ptr) {
+    // Lookups poll the token, so cancelling never waits for them
+    interop::unwrap_shared_ptr<CancellationToken>(native_ptr)->cancel();
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_xyz_lukasz_xword_search_WordIndex_memoryStatsNative(JNIEnv* env,
+                                                         [[maybe_unused]] jobject thiz,
+                                                         jlong native_ptr) {
+    auto index = interop::unwrap_shared_ptr<WordIndex>(native_ptr);
+    return interop::to_java_memory_stats(env, index->memory_stats());
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -112,3 +338,17 @@ Java_xyz_lukasz_xword_interop_NativeSharedPointer_freeImpl([[maybe_unused]] JNIE
 
     delete ptr_to_shared;
 }
+
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, [[maybe_unused]] void* reserved) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    if (!interop::init_class_cache(env)) {
+        log::tag("JNI_OnLoad").w("Could not resolve the classes used by the native code");
+        return JNI_ERR;
+    }
+
+    return JNI_VERSION_1_6;
+}
@@ -3,8 +3,8 @@
 
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
-#include <android/log.h>
 #include <jni.h>
+#include <memory>
 #include <string>
 
 namespace crossword::utils::android {
@@ -74,49 +74,23 @@ namespace crossword::utils::android {
             return Asset(AAssetManager_open(mgr, filename_cstr, open_mode));
         }
 
+        /// Opens an asset that can outlive the current scope, e.g. to keep its buffer mapped.
+        /// Returns nullptr if the asset does not exist.
+        inline std::shared_ptr<Asset> open_shared_asset(std::u8string& path,
+                                                        AssetOpenMode open_mode) {
+            auto filename_cstr = reinterpret_cast<const char*>(path.c_str());
+            auto asset = AAssetManager_open(mgr, filename_cstr, open_mode);
+            if (asset == nullptr) {
+                return nullptr;
+            }
+            return std::make_shared<Asset>(asset);
+        }
+
         /// Obtains a native handle to the AAssetManager.
         inline static AssetManager from_java(JNIEnv* env, jobject assetManager) {
             return AssetManager(env, assetManager);
         }
     };
-
-    namespace log {
-
-        /// Logs a message with the given priority.
-        template <typename... Args>
-        inline void
-        print(android_LogPriority priority, const char* tag, const char* fmt, Args... args) {
-            __android_log_print(priority, tag, fmt, args...);
-        }
-
-        struct Logger final {
-        private:
-            /// Tag of this logger.
-            std::string tag;
-
-        public:
-
-            /// Creates a new Logger instance with a provided tag.
-            Logger(std::string tag) : tag(tag) {}
-
-            /// Logs a message with the warning priority.
-            template <typename... Args>
-            inline void w(const char* fmt, Args... args) {
-                print(ANDROID_LOG_WARN, tag.c_str(), fmt, args...);
-            }
-
-            /// Logs a message with the info priority.
-            template <typename... Args>
-            inline void i(const char* fmt, Args... args) {
-                print(ANDROID_LOG_INFO, tag.c_str(), fmt, args...);
-            }
-        };
-
-        /// Creates a logger with a given tag.
-        inline Logger tag(std::string tag) {
-            return Logger(tag);
-        }
-    }
 }
 
 #endif // CROSSWORD_HELPER_ANDROID_HPP
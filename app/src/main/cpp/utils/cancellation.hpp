@@ -0,0 +1,40 @@
+#ifndef CROSSWORD_HELPER_CANCELLATION_HPP
+#define CROSSWORD_HELPER_CANCELLATION_HPP
+
+#include <atomic>
+
+namespace crossword::utils {
+
+    /// Lets another thread stop a lookup that nobody waits for anymore,
+    /// e.g. the lookup of a pattern the user has typed over already.
+    /// @details Lookups check the token wherever they check their limit of results,
+    /// so a cancelled lookup returns within a few visited nodes. Its results are incomplete
+    /// then, and must be discarded. Checking takes a single relaxed load, since nothing
+    /// has to be synchronized with the cancelling thread besides the flag itself.
+    class CancellationToken final {
+    private:
+        std::atomic<bool> cancelled{false};
+
+    public:
+        CancellationToken() = default;
+        CancellationToken(const CancellationToken& other) = delete;
+        CancellationToken& operator=(const CancellationToken& other) = delete;
+
+        /// Asks the lookups using this token to stop. Can be called from any thread.
+        void cancel() noexcept {
+            cancelled.store(true, std::memory_order_relaxed);
+        }
+
+        /// Checks whether the token has been cancelled.
+        bool is_cancelled() const noexcept {
+            return cancelled.load(std::memory_order_relaxed);
+        }
+
+        /// Checks whether an optional token has been cancelled.
+        static bool is_cancelled(const CancellationToken* token) noexcept {
+            return token != nullptr && token->is_cancelled();
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_CANCELLATION_HPP
@@ -0,0 +1,118 @@
+#ifndef CROSSWORD_HELPER_LINES_HPP
+#define CROSSWORD_HELPER_LINES_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace crossword::utils {
+
+    namespace detail {
+
+#if defined(__AVX2__)
+        /// How many bytes does line_break_mask check at once?
+        constexpr size_t line_block_size = 32;
+        /// How many bits of the mask does a single byte take?
+        constexpr int line_mask_bits_per_byte = 1;
+
+        /// Finds CR and LF bytes in a block of line_block_size bytes.
+        /// @returns A mask with the bits of every line break byte set.
+        inline uint64_t line_break_mask(const uint8_t* block) {
+            auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+            auto lf = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+            auto cr = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r'));
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(lf, cr)));
+        }
+#elif defined(__SSE2__)
+        constexpr size_t line_block_size = 16;
+        constexpr int line_mask_bits_per_byte = 1;
+
+        inline uint64_t line_break_mask(const uint8_t* block) {
+            auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+            auto lf = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+            auto cr = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(lf, cr)));
+        }
+#elif defined(__ARM_NEON)
+        constexpr size_t line_block_size = 16;
+        // NEON has no movemask, narrowing the comparison leaves a nibble per byte instead
+        constexpr int line_mask_bits_per_byte = 4;
+
+        inline uint64_t line_break_mask(const uint8_t* block) {
+            auto bytes = vld1q_u8(block);
+            auto lf = vceqq_u8(bytes, vdupq_n_u8('\n'));
+            auto cr = vceqq_u8(bytes, vdupq_n_u8('\r'));
+            auto matches = vreinterpretq_u16_u8(vorrq_u8(lf, cr));
+            auto nibbles = vreinterpret_u64_u8(vshrn_n_u16(matches, 4));
+            return vget_lane_u64(nibbles, 0);
+        }
+#else
+        // No vector instructions, scan byte by byte
+        constexpr size_t line_block_size = 0;
+        constexpr int line_mask_bits_per_byte = 1;
+
+        inline uint64_t line_break_mask(const uint8_t*) {
+            return 0;
+        }
+#endif
+    }
+
+    /// Splits a buffer into lines and calls the provided function for every non-empty one.
+    /// Both CR and LF are considered line breaks.
+    /// @details Line breaks are searched for a whole vector register at a time (if available),
+    /// so a single comparison usually covers several dictionary words.
+    /// @param buffer Pointer to the data buffer.
+    /// @param start Index to start searching from.
+    /// @param end Exclusive end index of buffer parsing.
+    /// @param fn Function taking a pointer to the first byte of the line and its length.
+    template <typename F>
+    void for_each_line(const uint8_t* buffer, const size_t start, const size_t end, F&& fn) {
+        auto line_start = start;
+
+        // CRLF sequences and multiple line breaks are valid,
+        // but since we control the input, we know that's pretty rare
+        auto line_break = [&](size_t index) {
+            if (index > line_start) [[likely]] {
+                fn(buffer + line_start, index - line_start);
+            }
+            line_start = index + 1;
+        };
+
+        auto index = start;
+        if constexpr (detail::line_block_size > 0) {
+            constexpr auto bits = detail::line_mask_bits_per_byte;
+            constexpr auto byte_mask = (uint64_t{1} << bits) - 1;
+
+            for (; index + detail::line_block_size <= end; index += detail::line_block_size) {
+                auto mask = detail::line_break_mask(buffer + index);
+                while (mask != 0) {
+                    auto bit = std::countr_zero(mask);
+                    line_break(index + static_cast<size_t>(bit / bits));
+                    mask &= ~(byte_mask << (bit - bit % bits));
+                }
+            }
+        }
+
+        while (index < end) {
+            auto byte = buffer[index];
+            if (byte == '\n' || byte == '\r') {
+                line_break(index);
+            }
+            ++index;
+        }
+
+        // In case the buffer did not end with a new line,
+        // push the remaining chars
+        if (end > line_start) {
+            fn(buffer + line_start, end - line_start);
+        }
+    }
+}
+
+#endif // CROSSWORD_HELPER_LINES_HPP
@@ -0,0 +1,66 @@
+#ifndef CROSSWORD_HELPER_LOG_HPP
+#define CROSSWORD_HELPER_LOG_HPP
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#else
+#include <cstdio>
+#endif
+
+#include <string>
+
+namespace crossword::utils::log {
+
+    enum class Priority : int {
+        Info,
+        Warn
+    };
+
+    /// Logs a message with the given priority.
+    /// On Android, messages go to logcat. Everywhere else, they are printed to stderr.
+    template <typename... Args>
+    inline void print(Priority priority, const char* tag, const char* fmt, Args... args) {
+#ifdef __ANDROID__
+        auto android_priority = priority == Priority::Warn ? ANDROID_LOG_WARN : ANDROID_LOG_INFO;
+        __android_log_print(android_priority, tag, fmt, args...);
+#else
+        std::fprintf(stderr, "%c/%s: ", priority == Priority::Warn ? 'W' : 'I', tag);
+        if constexpr (sizeof...(Args) > 0) {
+            std::fprintf(stderr, fmt, args...);
+        } else {
+            std::fputs(fmt, stderr);
+        }
+        std::fputc('\n', stderr);
+#endif
+    }
+
+    struct Logger final {
+    private:
+        /// Tag of this logger.
+        std::string tag;
+
+    public:
+
+        /// Creates a new Logger instance with a provided tag.
+        Logger(std::string tag) : tag(tag) {}
+
+        /// Logs a message with the warning priority.
+        template <typename... Args>
+        inline void w(const char* fmt, Args... args) {
+            print(Priority::Warn, tag.c_str(), fmt, args...);
+        }
+
+        /// Logs a message with the info priority.
+        template <typename... Args>
+        inline void i(const char* fmt, Args... args) {
+            print(Priority::Info, tag.c_str(), fmt, args...);
+        }
+    };
+
+    /// Creates a logger with a given tag.
+    inline Logger tag(std::string tag) {
+        return Logger(tag);
+    }
+}
+
+#endif // CROSSWORD_HELPER_LOG_HPP
@@ -0,0 +1,71 @@
+#ifndef CROSSWORD_HELPER_MAPPED_FILE_HPP
+#define CROSSWORD_HELPER_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace crossword::utils {
+
+    /// A read-only, memory-mapped file.
+    /// The pages are file-backed and shared, so the OS is free to evict them under pressure.
+    class MappedFile final {
+    private:
+        const uint8_t* data;
+        size_t length;
+
+        MappedFile(const uint8_t* data, size_t length) : data(data), length(length) {}
+
+    public:
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&&) = delete;
+        ~MappedFile() {
+            if (data != nullptr) {
+                munmap(const_cast<uint8_t*>(data), length);
+            }
+        }
+
+        /// Maps the whole file into memory.
+        /// @returns The mapped file, or nullptr if the file could not be opened or mapped.
+        static std::shared_ptr<MappedFile> open(const char* path) {
+            auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return nullptr;
+            }
+
+            struct stat info {};
+            if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+                close(fd);
+                return nullptr;
+            }
+
+            auto size = static_cast<size_t>(info.st_size);
+            auto address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (address == MAP_FAILED) {
+                return nullptr;
+            }
+
+            auto bytes = static_cast<const uint8_t*>(address);
+            return std::shared_ptr<MappedFile>(new MappedFile(bytes, size));
+        }
+
+        /// Gets a pointer to the mapped contents of the file.
+        inline const uint8_t* get_buffer() const noexcept {
+            return data;
+        }
+
+        /// Reports the total size of the file.
+        inline size_t size() const noexcept {
+            return length;
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_MAPPED_FILE_HPP
@@ -0,0 +1,245 @@
+#ifndef CROSSWORD_HELPER_THREAD_POOL_HPP
+#define CROSSWORD_HELPER_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crossword::utils {
+
+    /// Counts the unfinished tasks of a fork-join section, so that they can be waited for.
+    /// @details A group must outlive the tasks submitted with it (see ThreadPool::wait).
+    class TaskGroup final {
+    private:
+        friend class ThreadPool;
+
+        std::atomic<size_t> pending{0};
+
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup& other) = delete;
+        TaskGroup& operator=(const TaskGroup& other) = delete;
+
+        /// Checks whether all the tasks submitted so far have finished.
+        bool done() const noexcept {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+    };
+
+    /// A long-lived pool of worker threads, which steal tasks from each other.
+    /// @details Every worker has its own queue. Tasks submitted by a worker go to its queue,
+    /// where it picks up the newest ones first (they are likely to be still in cache),
+    /// while idle workers steal the oldest ones. Tasks submitted from other threads
+    /// are spread over the queues. Threads waiting for a group run queued tasks meanwhile,
+    /// so tasks can fork and wait for their own subtasks without starving the pool.
+    /// Threads outside of the pool run only the tasks of the group they wait for.
+    class ThreadPool final {
+    private:
+        struct Task {
+            std::function<void()> fn;
+            TaskGroup* group;
+        };
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+
+        /// Number of tasks waiting in all the queues.
+        std::atomic<size_t> queued{0};
+        /// Spreads tasks submitted from outside of the pool over the queues.
+        std::atomic<size_t> next_queue{0};
+
+        /// Guards sleeping: workers wait for tasks, other threads wait for their groups.
+        std::mutex sleep_mutex;
+        std::condition_variable task_queued;
+        std::condition_variable group_done;
+        bool stopping;
+
+        /// Pool and queue of the current thread, if it is a worker.
+        static inline thread_local ThreadPool* current_pool = nullptr;
+        static inline thread_local size_t current_queue = 0;
+
+        /// Picks the queue the current thread prefers to push to and pop from.
+        size_t home_queue() noexcept {
+            if (current_pool == this) {
+                return current_queue;
+            }
+            return next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        }
+
+        /// Takes a task from the home queue, or steals one from any other queue.
+        /// @param group If not null, only a task of this group can be taken.
+        bool try_pop(size_t home, const TaskGroup* group, Task& task) {
+            if (queued.load(std::memory_order_acquire) == 0) {
+                return false;
+            }
+
+            for (size_t i = 0; i < queues.size(); ++i) {
+                auto& queue = *queues[(home + i) % queues.size()];
+                std::lock_guard lock(queue.mutex);
+                if (queue.tasks.empty()) {
+                    continue;
+                }
+
+                if (group != nullptr) {
+                    auto it = std::find_if(queue.tasks.begin(), queue.tasks.end(),
+                                           [group](const Task& queued_task) {
+                                               return queued_task.group == group;
+                                           });
+                    if (it == queue.tasks.end()) {
+                        continue;
+                    }
+                    task = std::move(*it);
+                    queue.tasks.erase(it);
+                } else if (i == 0) {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            return false;
+        }
+
+        /// Runs a single queued task, if there is any.
+        /// @param group If not null, only a task of this group can be run.
+        /// @returns True if a task has been run.
+        bool try_run(size_t home, const TaskGroup* group) {
+            Task task;
+            if (!try_pop(home, group, task)) {
+                return false;
+            }
+
+            task.fn();
+            if (task.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                // The group might be gone right after its counter drops, so do not touch it
+                std::lock_guard lock(sleep_mutex);
+                group_done.notify_all();
+            }
+            return true;
+        }
+
+        void work(size_t index) {
+            current_pool = this;
+            current_queue = index;
+
+            while (true) {
+                if (try_run(index, nullptr)) {
+                    continue;
+                }
+
+                std::unique_lock lock(sleep_mutex);
+                task_queued.wait(lock, [this]() {
+                    return stopping || queued.load(std::memory_order_acquire) > 0;
+                });
+                if (stopping && queued.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+            }
+        }
+
+    public:
+        /// Starts a pool with the provided number of worker threads (at least one).
+        explicit ThreadPool(size_t thread_count) : stopping(false) {
+            thread_count = std::max<size_t>(thread_count, 1);
+            for (size_t i = 0; i < thread_count; ++i) {
+                queues.push_back(std::make_unique<Queue>());
+            }
+            for (size_t i = 0; i < thread_count; ++i) {
+                threads.emplace_back(&ThreadPool::work, this, i);
+            }
+        }
+
+        ThreadPool(const ThreadPool& other) = delete;
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+
+        /// Finishes all the queued tasks and stops the workers.
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(sleep_mutex);
+                stopping = true;
+            }
+            task_queued.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        /// Returns the pool shared by the whole library,
+        /// with a worker for every hardware thread.
+        static ThreadPool& shared() {
+            static ThreadPool pool(std::thread::hardware_concurrency());
+            return pool;
+        }
+
+        /// Reports how many worker threads the pool has.
+        size_t thread_count() const noexcept {
+            return threads.size();
+        }
+
+        /// Queues a task as a part of the group.
+        void submit(TaskGroup& group, std::function<void()> fn) {
+            group.pending.fetch_add(1, std::memory_order_relaxed);
+
+            // Count the task first, so that the counter never drops below the queued tasks
+            queued.fetch_add(1, std::memory_order_release);
+            auto& queue = *queues[home_queue()];
+            {
+                std::lock_guard lock(queue.mutex);
+                queue.tasks.push_back({std::move(fn), &group});
+            }
+
+            // Taking the lock orders this with a worker that is just about to sleep
+            {
+                std::lock_guard lock(sleep_mutex);
+            }
+            task_queued.notify_one();
+        }
+
+        /// Waits until all the tasks of the group finish, running queued tasks meanwhile.
+        /// A thread outside of the pool (e.g. one serving a lookup) runs only the tasks
+        /// of this group, so that it never waits for unrelated work.
+        void wait(TaskGroup& group) {
+            auto home = home_queue();
+            auto only = current_pool == this ? nullptr : &group;
+            while (!group.done()) {
+                if (try_run(home, only)) {
+                    continue;
+                }
+
+                // The remaining tasks of the group are running elsewhere. They might still
+                // queue more tasks though, so look for them again every now and then
+                std::unique_lock lock(sleep_mutex);
+                group_done.wait_for(lock, std::chrono::milliseconds(1),
+                                    [&group]() { return group.done(); });
+            }
+        }
+
+        /// Runs fn(i) for every i in [0, count) on the pool and waits for all of them.
+        template <typename F>
+        void parallel_for(size_t count, F&& fn) {
+            TaskGroup group;
+            for (size_t i = 0; i < count; ++i) {
+                submit(group, [&fn, i]() { fn(i); });
+            }
+            wait(group);
+        }
+    };
+}
+
+#endif // CROSSWORD_HELPER_THREAD_POOL_HPP
@@ -10,15 +10,15 @@ namespace crossword::utils {
     }
 
     constexpr bool codepoint_is_two_bytes(const unsigned char b) {
-        return (b & 0b11000000) == 0b11000000;
+        return (b & 0b11100000) == 0b11000000;
     }
 
     constexpr bool codepoint_is_three_bytes(const unsigned char b) {
-        return (b & 0b11100000) == 0b11100000;
+        return (b & 0b11110000) == 0b11100000;
     }
 
     constexpr bool codepoint_is_four_bytes(const unsigned char b) {
-        return (b & 0b11110000) == 0b11110000;
+        return (b & 0b11111000) == 0b11110000;
     }
 
     constexpr bool codepoint_is_continuation(const unsigned char b) {
@@ -37,6 +37,71 @@ namespace crossword::utils {
         if (a >= 65 && a <= 90) return a + 32;
         return a;
     }
+
+    /// Decodes a single codepoint and advances the iterator past it.
+    /// Malformed or truncated sequences decode to U+FFFD and consume one byte.
+    constexpr char32_t decode_codepoint(const char8_t*& it, const char8_t* end) {
+        auto lead = static_cast<unsigned char>(*it);
+        auto size = codepoint_size(lead);
+        if (size < 1 || end - it < size) [[unlikely]] {
+            ++it;
+            return U'\uFFFD';
+        }
+
+        char32_t cp = 0;
+        switch (size) {
+        case 1:
+            cp = lead;
+            break;
+        case 2:
+            cp = lead & 0b00011111;
+            break;
+        case 3:
+            cp = lead & 0b00001111;
+            break;
+        default:
+            cp = lead & 0b00000111;
+            break;
+        }
+
+        for (auto i = 1; i < size; ++i) {
+            cp = (cp << 6) | (static_cast<unsigned char>(it[i]) & 0b00111111);
+        }
+
+        it += size;
+        return cp;
+    }
+
+    /// Maps a codepoint to its lowercase form.
+    /// Covers ASCII, Latin-1 and Latin Extended-A, which is enough for our dictionaries.
+    constexpr char32_t fold_case(const char32_t cp) {
+        if (cp < 0x80) return to_lower(static_cast<unsigned char>(cp));
+        if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 0x20;
+        if (cp >= 0x100 && cp <= 0x137) return cp | 1;
+        if (cp >= 0x139 && cp <= 0x148) return (cp & 1) ? cp + 1 : cp;
+        if (cp >= 0x14A && cp <= 0x177) return cp | 1;
+        if (cp >= 0x179 && cp <= 0x17E) return (cp & 1) ? cp + 1 : cp;
+        return cp;
+    }
+
+    /// Encodes a codepoint as UTF-8 and appends it to the string.
+    inline void append_codepoint(std::u8string& str, const char32_t cp) {
+        if (cp < 0x80) {
+            str.push_back(static_cast<char8_t>(cp));
+        } else if (cp < 0x800) {
+            str.push_back(static_cast<char8_t>(0b11000000 | (cp >> 6)));
+            str.push_back(static_cast<char8_t>(0b10000000 | (cp & 0b00111111)));
+        } else if (cp < 0x10000) {
+            str.push_back(static_cast<char8_t>(0b11100000 | (cp >> 12)));
+            str.push_back(static_cast<char8_t>(0b10000000 | ((cp >> 6) & 0b00111111)));
+            str.push_back(static_cast<char8_t>(0b10000000 | (cp & 0b00111111)));
+        } else {
+            str.push_back(static_cast<char8_t>(0b11110000 | (cp >> 18)));
+            str.push_back(static_cast<char8_t>(0b10000000 | ((cp >> 12) & 0b00111111)));
+            str.push_back(static_cast<char8_t>(0b10000000 | ((cp >> 6) & 0b00111111)));
+            str.push_back(static_cast<char8_t>(0b10000000 | (cp & 0b00111111)));
+        }
+    }
 }
 
 #endif // CROSSWORD_HELPER_UTF8_HPP
@@ -2,29 +2,127 @@
 #define CROSSWORD_HELPER_WORD_NODE_HPP
 
 #include "collections/chunked_map.hpp"
+#include "locale/alphabet.hpp"
 #include "memory/arena.hpp"
-#include "utils/android.hpp"
-#include "utils/utf8.hpp"
+#include "memory/string_pool.hpp"
+#include "utils/cancellation.hpp"
+#include "utils/log.hpp"
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace crossword {
 
     using ::crossword::collections::ChunkedMap;
+    using ::crossword::collections::ChunkedMapIterator;
     using ::crossword::collections::MapChunk;
+    using ::crossword::locale::Symbol;
     using ::crossword::memory::Arena;
+    using ::crossword::memory::ArenaIndex;
+    using ::crossword::memory::StringHandle;
+    using ::crossword::memory::StringPool;
     using namespace ::crossword::utils;
-    using namespace ::crossword::utils::android;
+
+    struct WordNode;
+
+    /// Refers to a WordNode allocated in TrieArenas.
+    using NodeIndex = ArenaIndex;
+    /// Children of a WordNode, keyed by alphabet symbols.
+    using ChildMap = ChunkedMap<uint8_t, NodeIndex>;
+    using ChildChunk = MapChunk<uint8_t, NodeIndex>;
+
+    /// Arenas holding the nodes of a trie and their child maps.
+    /// @details Nodes refer to their children by 32-bit indices instead of pointers,
+    /// so every walk over the trie needs its arenas to resolve them.
+    struct TrieArenas {
+        Arena<WordNode> nodes;
+        Arena<ChildChunk> chunks;
+
+        /// Resolves a node index.
+        inline WordNode* node(NodeIndex index) const noexcept {
+            return nodes.at(index);
+        }
+
+        /// Moves all the nodes and chunks of another trie to these arenas.
+        /// @param other_root Root of the other trie, which is not allocated in its arenas.
+        /// @details The indices of the other trie get shifted past the ones of this trie,
+        /// by rewriting its arenas in order of allocation, instead of walking the trie.
+        inline void merge(TrieArenas* other, WordNode* other_root);
+
+        /// Gives a node a new, exactly sized map of the given children, allocated in these arenas.
+        /// Used by the passes copying a trie to fresh arenas (see indexing::TrieCompressor).
+        /// @returns The number of chunks the map took.
+        inline size_t copy_children(WordNode* node,
+                                    const std::vector<std::pair<uint8_t, NodeIndex>>& children);
+    };
+
+    /// Collects the words found by WordNode::search, up to a limit,
+    /// or until the lookup gets cancelled.
+    /// @details A custom collector can be passed to WordNode::search instead. It provides:
+    /// - bool full(), which stops the search as soon as it returns true,
+    /// - void push(StringHandle word), called for every word found, in order,
+    /// - bool descend(WordNode* child, size_t index, uint32_t ordinal, const Cursor* after),
+    ///   called before searching a child; returning false skips that child
+    ///   (e.g. to search it later, see indexing::LookupTask, or because nothing below
+    ///   can make it to the results, see indexing::ScoredResults). The cursor is the one
+    ///   passed to search (symbols) or to match (a vector of symbols).
+    struct LimitedResults {
+        std::vector<std::u8string_view>& words;
+        size_t limit;
+        const StringPool& pool;
+        const CancellationToken* cancellation = nullptr;
+
+        bool full() const noexcept {
+            return words.size() >= limit || CancellationToken::is_cancelled(cancellation);
+        }
+
+        void push(StringHandle word) {
+            words.push_back(pool.get(word));
+        }
+
+        template <typename Cursor>
+        constexpr bool descend(WordNode*, size_t, uint32_t, const Cursor*) const noexcept {
+            return true;
+        }
+    };
 
     /// A node in an index representing set of strings.
+    /// @details Children are keyed by alphabet symbols (see locale::Alphabet),
+    /// so the depth of a node is the length of its word in letters,
+    /// unless the trie has been path-compressed (see the label field).
     struct WordNode {
     public:
-        std::u8string* valid_word;
-        ChunkedMap<uint8_t, WordNode*> children;
+        /// How many symbols can a node label hold?
+        static constexpr size_t label_capacity = 4;
+
+        /// Handle of the word this node represents, or StringPool::no_string.
+        StringHandle valid_word;
+        /// Children of the node, as indices of the node arena.
+        ChildMap children;
+        /// Lengths of the words in the subtree of this node, counted from this node.
+        /// See length_bit for the meaning of the bits.
+        uint32_t length_mask;
+        union {
+            /// Number of words in the subtree of this node, including the node itself.
+            /// Only maintained in minimized tries, where it is used to recover words by ordinals.
+            uint32_t word_count;
+            /// Highest score of a word in the subtree of this node, including the node itself.
+            /// Only maintained in scored tries, which are never minimized (see assign_scores).
+            uint32_t max_score;
+        };
+        /// Symbols of a collapsed chain of single-child nodes, which follow this node.
+        /// The word and children of the node belong to the end of that chain.
+        /// Symbols are never zero (see locale::wildcard), so the unused tail is zeroed.
+        Symbol label[label_capacity];
 
         /// Creates a new WordNode representing an invalid word.
-        constexpr WordNode() : valid_word(nullptr) {}
+        constexpr WordNode() :
+            valid_word(StringPool::no_string),
+            length_mask(0), word_count(0), label{} {}
 
         WordNode(const WordNode& other) = delete;
         WordNode& operator=(const WordNode& other) = delete;
@@ -32,7 +130,13 @@ namespace crossword {
         /// Determines whether this node represents a valid word.
         /// This only makes sense in context of a particular tree index.
         constexpr inline bool valid() noexcept {
-            return valid_word != nullptr;
+            return valid_word != StringPool::no_string;
+        }
+
+        /// Maps the remaining length of a word to its bit in a length mask.
+        /// All the lengths of 31 symbols or more share the highest bit.
+        static constexpr uint32_t length_bit(size_t length) noexcept {
+            return uint32_t{1} << std::min<size_t>(length, 31);
         }
 
         /// Does this node have any children nodes?
@@ -40,38 +144,53 @@ namespace crossword {
             return !children.empty();
         }
 
-        size_t calculate_size() noexcept {
+        size_t calculate_size(const TrieArenas& arenas) noexcept {
             size_t count = 0;
             if (valid()) {
                 count += 1;
             }
             if (has_children()) {
-                for (const auto& entry : children) {
-                    count += entry.second->calculate_size();
+                for (const auto& entry : children.entries(&arenas.chunks)) {
+                    count += arenas.node(entry.second)->calculate_size(arenas);
                 }
             }
             return count;
         }
 
-        size_t count_nodes() noexcept {
+        size_t count_nodes(const TrieArenas& arenas) noexcept {
             size_t count = 1;
             if (has_children()) {
-                for (const auto& entry : children) {
-                    count += entry.second->count_nodes();
+                for (const auto& entry : children.entries(&arenas.chunks)) {
+                    count += arenas.node(entry.second)->count_nodes(arenas);
+                }
+            }
+            return count;
+        }
+
+        size_t count_chunks(const TrieArenas& arenas) noexcept {
+            size_t count = children.allocated_chunks;
+            if (has_children()) {
+                for (const auto& entry : children.entries(&arenas.chunks)) {
+                    count += arenas.node(entry.second)->count_chunks(arenas);
                 }
             }
             return count;
         }
 
         /// Pushes a word deep down the index.
-        /// @param str Word being pushed into the index.
+        /// @param str Handle of the word being pushed into the index.
+        /// @param symbols The word, encoded as alphabet symbols.
         /// @param index Current index depth.
-        bool push_word(std::u8string* str,
+        /// @param arenas The arenas of the trie, which new nodes get allocated in.
+        bool push_word(StringHandle str,
+                       const std::vector<Symbol>& symbols,
                        const size_t index,
-                       Arena<WordNode>* node_arena,
-                       Arena<MapChunk<uint8_t, WordNode*>>* chunk_arena) {
+                       TrieArenas* arenas) {
             // Check the length of the word (depth of the index)
-            auto word_length = str->length();
+            auto word_length = symbols.size();
+            if (index <= word_length) [[likely]] {
+                length_mask |= length_bit(word_length - index);
+            }
 
             if (index == word_length) {
                 valid_word = str;
@@ -79,118 +198,348 @@ namespace crossword {
             }
 
             if (index < word_length) {
-                auto key = str->at(index);
-                if (utils::codepoint_is_one_byte(key)) {
-                    key = utils::to_lower(key);
-                }
+                auto key = symbols[index];
 
-                auto new_child = node_arena->alloc();
-                auto [entry, inserted] = children.find_or_insert(key, new_child, chunk_arena);
-                auto [_key, node] = entry;
+                auto new_child = arenas->nodes.alloc_index();
+                auto [entry, inserted]
+                    = children.find_or_insert_sorted(key, new_child, &arenas->chunks);
+                auto node = arenas->node(entry.second);
 
                 // No string assignment happened, bump the arena pointer back
                 if (!inserted) {
-                    node_arena->dealloc_last();
+                    arenas->nodes.dealloc_last();
                 }
 
                 // Is the next node a target for the word to stay?
                 if (index + 1 == word_length) {
                     node->valid_word = str;
+                    node->length_mask |= length_bit(0);
                     return true;
                 } else {
                     // Whatever, just push it forward
-                    return node->push_word(str, index + 1, node_arena, chunk_arena);
+                    return node->push_word(str, symbols, index + 1, arenas);
                 }
             }
 
-            log::tag("push_word").w("Missed a word: %s", str->c_str());
+            log::tag("push_word").w("Missed a word: %u", str);
             return false;
         }
 
         /// Find words matching a provided pattern.
-        /// All matching words will be added to the passed vector.
+        /// All matching words will be added to the passed vector, as views of the stored words.
         /// If limit > 0, only n words will be added.
-        /// If a cursor value is provided, assuming children are sorted,
-        /// starts search from that cursor value (TODO).
-        void find_words(std::vector<std::u8string>& vec,
-                        const std::u8string& pattern,
+        /// Children are kept sorted, so the words come in the order of their symbols.
+        /// @param pattern The pattern, encoded as alphabet symbols. Wildcards match any symbol.
+        /// @param arenas The arenas holding the nodes of the trie.
+        /// @param pool The pool holding the words of the trie.
+        /// @param after Symbols of a word that matches the pattern, or null.
+        /// If provided, the search resumes right after that word.
+        /// @param cancellation Stops the search once cancelled, or null.
+        void find_words(std::vector<std::u8string_view>& vec,
+                        const std::vector<Symbol>& pattern,
                         const size_t index,
-                        const int32_t point_offset,
-                        const int32_t limit) {
-            // The pattern matched a wildcard and parent was a multi-byte character
-            if (point_offset > 0) {
-                for (const auto& [_key, child] : children) {
-                    // The wildcard is a single character, do not increment index
-                    child->find_words(vec, pattern, index, point_offset - 1, limit);
-                }
-                return;
+                        const int32_t limit,
+                        const TrieArenas& arenas,
+                        const StringPool& pool,
+                        const Symbol* after = nullptr,
+                        const CancellationToken* cancellation = nullptr) {
+            LimitedResults results{vec, static_cast<size_t>(std::max(limit, 0)), pool,
+                                   cancellation};
+            search<false>(results, arenas, pattern, index, 0, nullptr, after);
+        }
+
+        /// Find words matching a provided pattern in a minimized trie.
+        /// Nodes of such a trie are shared between many words, so instead of valid_word,
+        /// the words are recovered from their ordinals (positions in depth-first order).
+        /// @param ordinal Ordinal of the first word in this subtree.
+        /// @param words All the words of the trie, ordered by their ordinals.
+        void find_words_by_ordinal(std::vector<std::u8string_view>& vec,
+                                   const std::vector<Symbol>& pattern,
+                                   const size_t index,
+                                   const int32_t limit,
+                                   const uint32_t ordinal,
+                                   const StringHandle* words,
+                                   const TrieArenas& arenas,
+                                   const StringPool& pool,
+                                   const Symbol* after = nullptr,
+                                   const CancellationToken* cancellation = nullptr) {
+            LimitedResults results{vec, static_cast<size_t>(std::max(limit, 0)), pool,
+                                   cancellation};
+            search<true>(results, arenas, pattern, index, ordinal, words, after);
+        }
+
+    private:
+        /// Calculates the ordinal of the first word under the child at the provided position.
+        inline uint32_t child_ordinal(uint32_t ordinal,
+                                      ChunkedMapIterator<uint8_t, NodeIndex> position,
+                                      const TrieArenas& arenas) {
+            auto result = ordinal + (valid() ? 1 : 0);
+            for (auto it = children.begin(&arenas.chunks); it != position; ++it) {
+                result += arenas.node((*it).second)->word_count;
             }
+            return result;
+        }
 
+    public:
+        /// Finds words matching a provided pattern, passing them to a custom collector
+        /// (see LimitedResults for what it has to provide).
+        /// @tparam by_ordinal Whether the words are recovered from their ordinals,
+        ///                    see find_words_by_ordinal.
+        /// @param after Symbols of the word to resume after, as long as this node lies on its
+        /// path. Subtrees ordered before that path are skipped without visiting them.
+        template <bool by_ordinal, typename Results>
+        void search(Results& results,
+                    const TrieArenas& arenas,
+                    const std::vector<Symbol>& pattern,
+                    size_t index,
+                    const uint32_t ordinal,
+                    const StringHandle* words,
+                    const Symbol* after) {
             // The result vector is full
-            if (limit <= static_cast<int>(vec.size())) {
+            if (results.full()) {
+                return;
+            }
+
+            // No word of the pattern's length down there? Do not even look
+            if ((length_mask & length_bit(pattern.size() - index)) == 0) {
                 return;
             }
 
+            // A collapsed chain of nodes? Match its whole label in one go
+            for (size_t i = 0; i < label_capacity && label[i] != 0; ++i, ++index) {
+                if (index == pattern.size()) {
+                    return;
+                }
+                auto symbol = pattern[index];
+                if (symbol != label[i] && symbol != locale::wildcard) {
+                    return;
+                }
+                if (after != nullptr && label[i] != after[index]) {
+                    // The whole subtree comes either before or after the cursor
+                    if (label[i] < after[index]) {
+                        return;
+                    }
+                    after = nullptr;
+                }
+            }
+
             // We have reached the end of the pattern!
             // If this node represents a valid word, add it to the result vector
-            if (index == pattern.length()) {
-                if (valid()) {
-                    auto word_copy = *valid_word;
-                    vec.push_back(word_copy);
+            if (index == pattern.size()) {
+                // ...unless it is the very word to resume after
+                if (valid() && after == nullptr) {
+                    if constexpr (by_ordinal) {
+                        results.push(words[ordinal]);
+                    } else {
+                        results.push(valid_word);
+                    }
                 }
                 return;
             }
 
-            // Perhaps we have went too far?
-            if (index > pattern.length()) [[unlikely]] {
-                log::tag("find_words").w("Missed node ending pattern %s", pattern.c_str());
+            // No children? We're done
+            if (!has_children()) {
                 return;
             }
 
-            // No children? We're done
-            if (!has_children()) {
+            // Every symbol is a whole letter, so a wildcard always spans exactly one level
+            auto symbol = pattern[index];
+            if (symbol == locale::wildcard) {
+                auto next_ordinal = ordinal + (valid() ? 1 : 0);
+                for (const auto& [key, child_index] : children.entries(&arenas.chunks)) {
+                    auto child = arenas.node(child_index);
+                    if (after == nullptr || key >= after[index]) {
+                        // Only the child on the path of the cursor has to resume after it
+                        auto child_after = (after != nullptr && key == after[index]) ? after
+                                                                                     : nullptr;
+                        if (results.descend(child, index + 1, next_ordinal, child_after)) {
+                            child->template search<by_ordinal>(results, arenas, pattern,
+                                                               index + 1, next_ordinal, words,
+                                                               child_after);
+                        }
+                    }
+                    if constexpr (by_ordinal) {
+                        next_ordinal += child->word_count;
+                    }
+                }
                 return;
             }
 
-            auto ch = static_cast<uint8_t>(pattern.at(index));
-            if (ch == '.') {
-                for (const auto& [key, child] : children) {
-                    int offset = 0;
-                    if (!utils::codepoint_is_continuation(key))
-                        offset = utils::codepoint_size(key) - 1;
+            if (after != nullptr && symbol != after[index]) {
+                if (symbol < after[index]) {
+                    return;
+                }
+                after = nullptr;
+            }
 
-                    child->find_words(vec, pattern, index + 1, offset, limit);
+            auto result = children.find(symbol, &arenas.chunks);
+            if (result != children.end(&arenas.chunks)) {
+                auto child = arenas.node(result.get_element().second);
+                uint32_t next_ordinal = 0;
+                if constexpr (by_ordinal) {
+                    next_ordinal = child_ordinal(ordinal, result, arenas);
                 }
+                if (results.descend(child, index + 1, next_ordinal, after)) {
+                    child->template search<by_ordinal>(results, arenas, pattern, index + 1,
+                                                       next_ordinal, words, after);
+                }
+            }
+        }
+
+        /// Finds words accepted by an automaton (see indexing::CompiledPattern),
+        /// passing them to a custom collector (see LimitedResults).
+        /// @details Every edge steps the automaton, and subtrees are skipped as soon as
+        /// no state is left, or no word below has a length any of the states can accept.
+        /// Words come in the order of their symbols, a word before the longer ones under it.
+        /// @param states States of the automaton before matching the label of this node.
+        /// @param length Number of symbols matched so far.
+        /// @param after Symbols of the word to resume after, as long as this node lies on its
+        /// path, or null. Unlike in search, it may be of any length.
+        template <bool by_ordinal, typename Automaton, typename Results>
+        void match(Results& results,
+                   const TrieArenas& arenas,
+                   const Automaton& automaton,
+                   typename Automaton::StateSet states,
+                   size_t length,
+                   const uint32_t ordinal,
+                   const StringHandle* words,
+                   const std::vector<Symbol>* after) {
+            if (results.full()) {
                 return;
             }
 
-            auto result = children.find(ch);
-            if (result != children.end()) {
-                auto [_key, child] = result.get_element();
-                child->find_words(vec, pattern, index + 1, 0, limit);
+            if ((length_mask & automaton.remaining_lengths(states, length)) == 0) {
+                return;
+            }
+
+            for (size_t i = 0; i < label_capacity && label[i] != 0; ++i, ++length) {
+                states = automaton.step(states, label[i]);
+                if (states == 0) {
+                    return;
+                }
+                if (after != nullptr
+                    && (length == after->size() || label[i] != (*after)[length])) {
+                    // The whole subtree comes either before or after the cursor
+                    if (length < after->size() && label[i] < (*after)[length]) {
+                        return;
+                    }
+                    after = nullptr;
+                }
+            }
+
+            // On the path of the cursor, this is either the cursor word or one of its prefixes,
+            // both of which have been returned already
+            if (valid() && after == nullptr && automaton.accepts(states, length)) {
+                if constexpr (by_ordinal) {
+                    results.push(words[ordinal]);
+                } else {
+                    results.push(valid_word);
+                }
             }
 
-            auto ch_lower = utils::to_lower(ch);
-            if (ch == ch_lower) {
+            // Everything below the cursor word comes after it
+            if (after != nullptr && length == after->size()) {
+                after = nullptr;
+            }
+
+            if (!has_children()) {
                 return;
             }
 
-            auto result_lower = children.find(ch_lower);
-            if (result_lower != children.end()) {
-                auto [_key, child] = result_lower.get_element();
-                child->find_words(vec, pattern, index + 1, 0, limit);
+            auto only = automaton.only_symbol(states);
+            if (only != locale::wildcard) {
+                if (after != nullptr && only != (*after)[length]) {
+                    if (only < (*after)[length]) {
+                        return;
+                    }
+                    after = nullptr;
+                }
+
+                auto result = children.find(only, &arenas.chunks);
+                if (result != children.end(&arenas.chunks)) {
+                    auto child = arenas.node(result.get_element().second);
+                    uint32_t next_ordinal = 0;
+                    if constexpr (by_ordinal) {
+                        next_ordinal = child_ordinal(ordinal, result, arenas);
+                    }
+                    if (results.descend(child, length + 1, next_ordinal, after)) {
+                        child->template match<by_ordinal>(results, arenas, automaton,
+                                                          automaton.step(states, only),
+                                                          length + 1, next_ordinal, words, after);
+                    }
+                }
+                return;
+            }
+
+            auto next_ordinal = ordinal + (valid() ? 1 : 0);
+            for (const auto& [key, child_index] : children.entries(&arenas.chunks)) {
+                auto child = arenas.node(child_index);
+                if (after == nullptr || key >= (*after)[length]) {
+                    auto next_states = automaton.step(states, key);
+                    auto child_after = (after != nullptr && key == (*after)[length]) ? after
+                                                                                     : nullptr;
+                    if (next_states != 0
+                        && results.descend(child, length + 1, next_ordinal, child_after)) {
+                        child->template match<by_ordinal>(results, arenas, automaton,
+                                                          next_states, length + 1, next_ordinal,
+                                                          words, child_after);
+                    }
+                }
+                if constexpr (by_ordinal) {
+                    next_ordinal += child->word_count;
+                }
+            }
+        }
+
+        /// Replaces every word handle of the subtree with fn(handle), calling fn for the words
+        /// in the order of their symbols. Must not be used on a minimized trie.
+        template <typename F>
+        void renumber_words(F&& fn, const TrieArenas& arenas) {
+            if (valid()) {
+                valid_word = fn(valid_word);
+            }
+            for (const auto& entry : children.entries(&arenas.chunks)) {
+                arenas.node(entry.second)->renumber_words(fn, arenas);
+            }
+        }
+
+        /// Caches the highest score of a word in every node of the subtree (see max_score).
+        /// Must not be used on a minimized trie, whose nodes are shared between many words.
+        /// @param score_of Function returning the score of a word by its handle.
+        /// @returns The highest score in the subtree.
+        template <typename F>
+        uint32_t assign_scores(F&& score_of, const TrieArenas& arenas) {
+            max_score = valid() ? score_of(valid_word) : 0;
+            for (const auto& entry : children.entries(&arenas.chunks)) {
+                max_score = std::max(max_score,
+                                     arenas.node(entry.second)->assign_scores(score_of, arenas));
+            }
+            return max_score;
+        }
+
+        /// Moves the word handles of the subtree, e.g. after its pool has been appended
+        /// to another pool (see StringPool::append). Must not be used on a minimized trie.
+        void relocate_words(size_t shift, const TrieArenas& arenas) noexcept {
+            if (valid()) {
+                valid_word = static_cast<StringHandle>(valid_word + shift);
+            }
+            for (const auto& entry : children.entries(&arenas.chunks)) {
+                arenas.node(entry.second)->relocate_words(shift, arenas);
             }
         }
 
         /// Merges another node with this node.
         /// Assume the other node always represents the same place in an index as this one.
         /// @param other The other node to merge with this one.
-        /// @param chunk_arena The arena to allocate new map elements with.
-        void merge(WordNode* other, Arena<MapChunk<uint8_t, WordNode*>>* chunk_arena) {
+        /// Its trie has to be merged into the arenas of this one already (see TrieArenas::merge).
+        /// @param arenas The arenas to resolve nodes with and allocate new map elements in.
+        void merge(WordNode* other, TrieArenas* arenas) {
             if (other->valid()) {
                 valid_word = other->valid_word;
             }
 
+            length_mask |= other->length_mask;
+
             // The other node does not have children? Nothing else to merge
             if (!other->has_children()) {
                 return;
@@ -204,20 +553,52 @@ namespace crossword {
 
             // Both nodes have children? It gets a bit more complicated.
             // First, iterate over the other node's children
-            for (auto [key, other_child] : other->children) {
-                auto result = children.find(key);
-                if (result == children.end()) {
+            for (auto [key, other_child] : other->children.entries(&arenas->chunks)) {
+                auto result = children.find(key, &arenas->chunks);
+                if (result == children.end(&arenas->chunks)) {
                     // The other node has a child that this node does not have? Save it
                     // (ignore the result, we are sure an insertion will happen)
-                    children.find_or_insert(key, other_child, chunk_arena);
+                    children.find_or_insert_sorted(key, other_child, &arenas->chunks);
                 } else {
                     // If both nodes exist, merge them by recursion
-                    auto this_child = result.get_element().second;
-                    this_child->merge(other_child, chunk_arena);
+                    auto this_child = arenas->node(result.get_element().second);
+                    this_child->merge(arenas->node(other_child), arenas);
                 }
             }
         }
     };
+
+    static_assert(sizeof(WordNode) <= 24, "WordNode must not be larger than 24 bytes");
+
+    inline void TrieArenas::merge(TrieArenas* other, WordNode* other_root) {
+        auto node_shift = nodes.merge_shift();
+        auto chunk_shift = chunks.merge_shift();
+
+        // Unused slots get shifted as well, but they are never resolved anyway
+        other_root->children.relocate(chunk_shift);
+        other->nodes.for_each([chunk_shift](WordNode& node) {
+            node.children.relocate(chunk_shift);
+        });
+        other->chunks.for_each([node_shift](ChildChunk& chunk) {
+            chunk.value1 += node_shift;
+            chunk.value2 += node_shift;
+            chunk.value3 += node_shift;
+        });
+
+        nodes.merge(&other->nodes);
+        chunks.merge(&other->chunks);
+    }
+
+    inline size_t
+    TrieArenas::copy_children(WordNode* node,
+                              const std::vector<std::pair<uint8_t, NodeIndex>>& children) {
+        node->children = ChildMap();
+        node->children.reserve(static_cast<int16_t>(children.size()), &chunks);
+        for (const auto& [key, child] : children) {
+            node->children.find_or_insert(key, child, &chunks);
+        }
+        return static_cast<size_t>(node->children.allocated_chunks);
+    }
 }
 
 #endif // CROSSWORD_HELPER_WORD_NODE_HPP
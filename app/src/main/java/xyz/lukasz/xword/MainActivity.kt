@@ -18,7 +18,6 @@ import xyz.lukasz.xword.search.MissingLettersIndex
 import xyz.lukasz.xword.search.SearchResultsViewModel
 import xyz.lukasz.xword.search.WordIndexFactory
 import xyz.lukasz.xword.search.WordIndexType
-import xyz.lukasz.xword.utils.showSnackbar
 import java.util.*
 
 @AndroidEntryPoint
@@ -42,14 +41,6 @@ class MainActivity : ActivityBase<ActivityMainBinding>(R.layout.activity_main) {
             }
         }
 
-        resultsViewModel.results.observe(this) {
-            val maxResults = SearchResultsViewModel.MAX_RESULTS
-            if (it.size >= maxResults) {
-                val message = resources.getString(R.string.search_showing_only, it.size)
-                binding.mainLayout.showSnackbar(message)
-            }
-        }
-
         val searchFragment = SearchFragment()
         supportFragmentManager.commit {
             add(binding.fragmentContainerView.id, searchFragment, "search")
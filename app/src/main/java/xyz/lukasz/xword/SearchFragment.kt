@@ -7,6 +7,8 @@ import android.view.ViewGroup
 import androidx.fragment.app.Fragment
 import androidx.fragment.app.activityViewModels
 import androidx.fragment.app.commit
+import androidx.recyclerview.widget.LinearLayoutManager
+import androidx.recyclerview.widget.RecyclerView
 import com.google.android.material.tabs.TabLayout
 import dagger.hilt.android.AndroidEntryPoint
 import timber.log.Timber
@@ -38,6 +40,17 @@ class SearchFragment : Fragment(R.layout.fragment_search) {
                     submitList(it)
                 }
             }
+            addOnScrollListener(object : RecyclerView.OnScrollListener() {
+                override fun onScrolled(recyclerView: RecyclerView, dx: Int, dy: Int) {
+                    // Fetch the next page before the user reaches the end of the list
+                    val layoutManager = recyclerView.layoutManager as? LinearLayoutManager
+                        ?: return
+                    val lastVisible = layoutManager.findLastVisibleItemPosition()
+                    if (lastVisible >= layoutManager.itemCount - PREFETCH_DISTANCE) {
+                        searchResultsViewModel.loadMoreResults()
+                    }
+                }
+            })
         }
 
         val searchBoxFragment = SearchBoxFragment()
@@ -53,6 +66,7 @@ class SearchFragment : Fragment(R.layout.fragment_search) {
                 val position = tab?.position ?: return
                 val mode = arrayOf(
                     WordIndexType.MISSING_LETTERS,
+                    WordIndexType.RHYMES,
                     WordIndexType.ANAGRAMS
                 ).getOrNull(position) ?: return
                 searchResultsViewModel.switchIndexCategory(resources.assets, mode)
@@ -78,4 +92,11 @@ class SearchFragment : Fragment(R.layout.fragment_search) {
         val adapter = binding.recyclerView.adapter as SingleWordAdapter
         adapter.submitList(results)
     }
+
+    companion object {
+        /**
+         * How many items before the end of the list should the next page be requested.
+         */
+        private const val PREFETCH_DISTANCE: Int = 50
+    }
 }
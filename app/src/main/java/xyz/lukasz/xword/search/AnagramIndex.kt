@@ -11,7 +11,7 @@ class AnagramIndex(locale: Locale) : WordIndex(locale) {
      */
     override fun loadFromAsset(assetManager: AssetManager) {
         unload()
-        val assetPath = resolveAssetPath()
+        val assetPath = resolveDictionaryAssetPath(assetManager)
         val threadCount = Runtime.getRuntime().availableProcessors()
         nativeIndex = loadNative(assetManager, assetPath, threadCount)
         if (nativeIndex.nil) {
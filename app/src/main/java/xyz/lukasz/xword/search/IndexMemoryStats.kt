@@ -0,0 +1,59 @@
+package xyz.lukasz.xword.search
+
+/**
+ * Native memory taken by a single arena of an index.
+ */
+class ArenaMemoryStats(
+    /**
+     * What the arena holds, e.g. "nodes".
+     */
+    val name: String,
+    val segmentCount: Long,
+    /**
+     * Bytes taken by all the segments of the arena.
+     */
+    val reservedBytes: Long,
+    /**
+     * Bytes taken by the allocated slots, including the released ones.
+     */
+    val usedBytes: Long,
+    /**
+     * Bytes of released slots, which wait to be reused.
+     */
+    val releasedBytes: Long
+) {
+
+    /**
+     * Bytes reserved by the arena, but not holding any live object.
+     */
+    val wastedBytes: Long
+        get() = reservedBytes - usedBytes + releasedBytes
+}
+
+/**
+ * Describes how much native memory an index takes and what takes it.
+ */
+class IndexMemoryStats(
+    val arenas: Array<ArenaMemoryStats>,
+    /**
+     * Bytes taken outside of the arenas, e.g. by stored words or hash tables.
+     */
+    val otherBytes: Long,
+    /**
+     * Nodes reachable in the trie of the index, or zero if it has no trie.
+     */
+    val nodeCount: Long,
+    val chunkCount: Long,
+    val wordCount: Long,
+    /**
+     * Number of nodes by their number of children: fanOut[n] nodes have n children.
+     */
+    val fanOut: LongArray
+) {
+
+    /**
+     * Bytes taken by the whole index.
+     */
+    val totalBytes: Long
+        get() = otherBytes + arenas.sumOf { it.reservedBytes }
+}
@@ -0,0 +1,49 @@
+package xyz.lukasz.xword.search
+
+import org.jetbrains.annotations.Contract
+import xyz.lukasz.xword.interop.NativeSharedPointer
+
+/**
+ * Stops a native lookup that nobody waits for anymore,
+ * e.g. the lookup of a pattern the user has typed over already.
+ * Lookups check it as they walk the index, so a cancelled one returns within microseconds,
+ * with incomplete results that have to be discarded.
+ */
+class LookupCancellation : AutoCloseable {
+
+    /**
+     * Pointer to a native cancellation token.
+     */
+    private val nativeToken = createNative()
+
+    /**
+     * Pointer to pass to native lookups.
+     */
+    fun getPointer(): Long {
+        return nativeToken.getPointer()
+    }
+
+    /**
+     * Asks the lookups using this cancellation to stop. Can be called from any thread.
+     */
+    fun cancel() {
+        val pointer = nativeToken.getPointer()
+        if (pointer != 0L) {
+            cancelNative(pointer)
+        }
+    }
+
+    override fun close() {
+        nativeToken.free()
+    }
+
+    private companion object {
+
+        @JvmStatic
+        @Contract(" -> new", pure = true)
+        external fun createNative(): NativeSharedPointer
+
+        @JvmStatic
+        external fun cancelNative(pointer: Long)
+    }
+}
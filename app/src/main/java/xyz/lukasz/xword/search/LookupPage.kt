@@ -0,0 +1,112 @@
+package xyz.lukasz.xword.search
+
+import java.nio.ByteBuffer
+
+/**
+ * A single page of lookup results.
+ */
+class LookupPage(
+    /**
+     * Words found on this page.
+     */
+    val words: List<String>,
+    /**
+     * Opaque position right after the last word of this page,
+     * or null if there are no more results.
+     */
+    val cursor: ByteArray?
+) {
+
+    /**
+     * Can the lookup be continued with another page?
+     */
+    val hasMore: Boolean
+        get() = cursor != null
+
+    companion object {
+
+        /**
+         * A page without any results.
+         */
+        fun empty(): LookupPage {
+            return LookupPage(emptyList(), null)
+        }
+
+        /**
+         * Copies a page written by the native code out of a direct buffer,
+         * so that the buffer can be reused for the next page.
+         */
+        fun copyOf(buffer: ByteBuffer): ByteBuffer {
+            val wordCount = buffer.getInt(0)
+            val cursorLength = buffer.getInt(Int.SIZE_BYTES)
+            val wordsStart = EncodedWordList.OFFSETS_START +
+                (wordCount + 1) * Int.SIZE_BYTES + cursorLength
+            val size = wordsStart +
+                buffer.getInt(EncodedWordList.OFFSETS_START + wordCount * Int.SIZE_BYTES)
+
+            val page = buffer.duplicate()
+            page.position(0)
+            page.limit(size)
+            return ByteBuffer.allocate(size).order(buffer.order()).put(page)
+        }
+
+        /**
+         * Reads a page written by the native code to a buffer
+         * (see write_lookup_page in interop/lookup_buffer.hpp for the layout).
+         * The words are not decoded until they are accessed.
+         * The buffer must be in native byte order and it must not be reused afterwards.
+         */
+        fun fromBuffer(buffer: ByteBuffer): LookupPage {
+            val wordCount = buffer.getInt(0)
+            val cursorLength = buffer.getInt(Int.SIZE_BYTES)
+            val cursorStart = EncodedWordList.OFFSETS_START + (wordCount + 1) * Int.SIZE_BYTES
+            val wordsStart = cursorStart + cursorLength
+
+            val cursor = if (cursorLength > 0) {
+                ByteArray(cursorLength).also {
+                    val view = buffer.duplicate()
+                    view.position(cursorStart)
+                    view.get(it)
+                }
+            } else {
+                null
+            }
+
+            return LookupPage(EncodedWordList(buffer, wordCount, wordsStart), cursor)
+        }
+    }
+}
+
+/**
+ * A list of words packed by the native code into a single buffer of UTF-8 bytes.
+ * Every word is decoded on its first access.
+ */
+class EncodedWordList(
+    private val buffer: ByteBuffer,
+    override val size: Int,
+    private val wordsStart: Int
+) : AbstractList<String>() {
+
+    private val decoded = arrayOfNulls<String>(size)
+
+    override fun get(index: Int): String {
+        decoded[index]?.let { return it }
+
+        val start = buffer.getInt(OFFSETS_START + index * Int.SIZE_BYTES)
+        val end = buffer.getInt(OFFSETS_START + (index + 1) * Int.SIZE_BYTES)
+        val bytes = buffer.duplicate()
+        bytes.limit(wordsStart + end)
+        bytes.position(wordsStart + start)
+
+        val word = Charsets.UTF_8.decode(bytes).toString()
+        decoded[index] = word
+        return word
+    }
+
+    companion object {
+        /**
+         * Offset of the word offset table, right after the word count and the cursor length.
+         */
+        const val OFFSETS_START: Int = 2 * Int.SIZE_BYTES
+    }
+}
@@ -1,33 +1,135 @@
 package xyz.lukasz.xword.search
 
 import android.content.res.AssetManager
+import org.jetbrains.annotations.Contract
+import timber.log.Timber
 import xyz.lukasz.xword.interop.NativeSharedPointer
 import java.util.*
 
 /**
  * MissingLettersIndex is an index that provides lookup of words,
  * where the matched pattern can have some of its letters missing.
+ *
+ * Besides letters and dots (any single letter), patterns can contain
+ * sets of letters (`[ąa]`, or `[^ąa]` for any other letter), runs of any letters
+ * (`*` for any number of them, `?` for one or none) and a trailing length bound
+ * (`{5,7}`, `{5}`, `{5,}` or `{,7}`). A pattern is matched in a single pass over the index.
+ *
+ * Patterns ending in more known letters than they start with (e.g. `*ość`) are looked up
+ * in a trie of reversed words, if one is built. Results of every pattern come in alphabetical
+ * order, no matter which structure they are looked up in.
+ *
+ * If the dictionary comes with word frequencies, [lookupBest] returns the most frequent
+ * matches first.
  */
-class MissingLettersIndex(locale: Locale) : WordIndex(locale) {
+class MissingLettersIndex(
+    locale: Locale,
+    /**
+     * Should the index be minimized after loading?
+     * A minimized index takes several times less memory, but it takes longer to load.
+     */
+    private val minimize: Boolean = false,
+    /**
+     * Should chains of single-child nodes be collapsed after loading?
+     * A compressed index takes less memory and long patterns are matched faster.
+     */
+    private val compress: Boolean = false,
+    /**
+     * Should a trie of reversed words be built after loading?
+     * It speeds up patterns ending in known letters, but takes about as much memory as the index.
+     */
+    private val suffixes: Boolean = false,
+    /**
+     * Should sets of words by their letters at every position be built after loading?
+     * They speed up patterns starting with a wildcard (e.g. `.a.o.e..`) the most.
+     */
+    private val positions: Boolean = false,
+    /**
+     * Should a prebuilt index of the dictionary be mapped instead, if the build has one?
+     * It loads in no time and takes no native heap, but it is served as it was built: it is not
+     * compressed, it has no trie of reversed words nor positional sets, its lookups run on
+     * a single thread without a query cache, and it knows no word frequencies.
+     * The other options are ignored then. Such an index is built by the host-side tooling
+     * (see the README), the app build does not produce it.
+     */
+    private val prebuilt: Boolean = false
+) : WordIndex(locale) {
 
     /**
      * Attempts to load an internal asset under a specified path.
      */
     override fun loadFromAsset(assetManager: AssetManager) {
         unload()
-        val assetPath = resolveAssetPath()
+
+        // A prebuilt index is mapped in place instead of being built from scratch
+        val prebuiltPath = resolvePrebuiltAssetPath()
+        if (prebuilt && assetExists(assetManager, prebuiltPath)) {
+            nativeIndex = loadPrebuiltNative(assetManager, prebuiltPath)
+            if (!nativeIndex.nil) {
+                return
+            }
+            Timber.w("Prebuilt index %s is not valid, falling back to the dictionary", prebuiltPath)
+        }
+
+        val assetPath = resolveDictionaryAssetPath(assetManager)
+        val scoresPath = resolveScoresAssetPath().takeIf { assetExists(assetManager, it) }
         val threadCount = Runtime.getRuntime().availableProcessors()
-        nativeIndex = loadNative(assetManager, assetPath, threadCount)
+        nativeIndex = loadNative(
+            assetManager, assetPath, scoresPath, threadCount, minimize, compress, suffixes,
+            positions
+        )
         if (nativeIndex.nil) {
             throw Exception("Native loading failed")
         }
     }
 
+    /**
+     * Looks up the words matching the query, from the most to the least frequent.
+     * Words of equal frequencies, or all of them if the dictionary has no frequencies,
+     * come in alphabetical order.
+     */
+    @Contract("_, _ -> new", pure = true)
+    fun lookupBest(query: String, maxResults: Int): MutableList<String> {
+        return if (ready) {
+            val queryStr = normalizeQuery(query)
+            val resultArray = lookupBestNative(nativeIndex.getPointer(), queryStr, maxResults)
+            mutableListOf(*resultArray)
+        } else {
+            mutableListOf()
+        }
+    }
+
+    /**
+     * Resolves the path of the word frequencies of the dictionary: lines of a word,
+     * a tab and a number. Such an asset is optional.
+     */
+    private fun resolveScoresAssetPath(): String {
+        return "dictionaries/${locale.language}_${locale.country}/frequencies.txt"
+    }
+
     /**
      * A native method that attempts to load and index a native Dictionary
      * and returns a pointer to that object
      * or null, if the operation failed.
      */
-    private external fun loadNative(assetManager: AssetManager, filename: String, threads: Int)
+    private external fun loadNative(
+        assetManager: AssetManager,
+        filename: String,
+        scoresFilename: String?,
+        threads: Int,
+        minimize: Boolean,
+        compress: Boolean,
+        suffixes: Boolean,
+        positions: Boolean
+    ): NativeSharedPointer
+
+    /**
+     * A native method that maps a prebuilt index asset
+     * and returns a pointer to that object
+     * or a null pointer, if the asset is not a valid index.
+     */
+    private external fun loadPrebuiltNative(assetManager: AssetManager, filename: String)
         : NativeSharedPointer
+
+    private external fun lookupBestNative(pointer: Long, query: String, max: Int): Array<String>
 }
@@ -4,11 +4,13 @@ import android.content.Context
 import android.content.res.AssetManager
 import android.view.View
 import androidx.annotation.AnyThread
+import androidx.annotation.MainThread
 import androidx.lifecycle.*
 import androidx.transition.Fade
 import androidx.transition.TransitionManager
 import dagger.hilt.android.lifecycle.HiltViewModel
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.Job
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
 import timber.log.Timber
@@ -27,6 +29,13 @@ class SearchResultsViewModel @Inject constructor(
     val index = MutableLiveData<WordIndex?>(null)
     val query = MutableLiveData("")
 
+    /**
+     * Cursor of the last loaded page of results,
+     * or null if all the results of the current query have been loaded.
+     */
+    private var nextPageCursor: ByteArray? = null
+    private var lookupJob: Job? = null
+
     init {
         index.observeForever { tryLookupIfStateValid() }
         query.observeForever {
@@ -51,7 +60,7 @@ class SearchResultsViewModel @Inject constructor(
         }
     }
 
-    @AnyThread
+    @MainThread
     private fun tryLookupIfStateValid() {
         val index = this.index.value
         val query = this.query.value
@@ -63,26 +72,103 @@ class SearchResultsViewModel @Inject constructor(
             Timber.d("State is invalid: index is not ready")
         } else {
             Timber.d("State is valid; dispatching lookup")
-            searchAndUpdateResults(index, query, MAX_RESULTS)
+            searchAndUpdateResults(index, query)
         }
     }
 
-    @AnyThread
-    private fun searchAndUpdateResults(index: WordIndex, query: String, maxResults: Int) {
-        viewModelScope.launch(Dispatchers.IO) {
-            val queryResults = index.lookup(query, maxResults)
-            Timber.i("Found %d results for pattern \"%s\"", queryResults.size, query)
-            queryResults.sortWith(index.collator)
-            _results.postValue(queryResults)
+    @MainThread
+    private fun searchAndUpdateResults(index: WordIndex, query: String) {
+        // The previous query has been typed over, so stop its native lookup too
+        lookupJob?.cancel()
+        nextPageCursor = null
+        lookupJob = viewModelScope.launch(Dispatchers.Main) {
+            val page = withContext(Dispatchers.IO) { index.lookupPage(query, PAGE_SIZE, null) }
+            Timber.i("Found %d results for pattern \"%s\"", page.words.size, query)
+            nextPageCursor = page.cursor
+            _results.value = page.words
+        }
+    }
+
+    /**
+     * Appends the next page of results of the current query, if there is one.
+     * Does nothing if a page is already being loaded.
+     */
+    @MainThread
+    fun loadMoreResults() {
+        val index = this.index.value ?: return
+        val query = this.query.value ?: return
+        val cursor = nextPageCursor ?: return
+        if (lookupJob?.isActive == true) {
+            return
+        }
+
+        lookupJob = viewModelScope.launch(Dispatchers.Main) {
+            val page = withContext(Dispatchers.IO) { index.lookupPage(query, PAGE_SIZE, cursor) }
+            Timber.i("Found %d more results for pattern \"%s\"", page.words.size, query)
+            nextPageCursor = page.cursor
+            _results.value = PagedResults.of(_results.value ?: emptyList(), page.words)
         }
     }
 
+
     override fun onCleared() {
         super.onCleared()
     }
 
     companion object {
-        const val MAX_RESULTS: Int = 500
+        /**
+         * How many results are loaded at once.
+         */
+        const val PAGE_SIZE: Int = 500
     }
 }
 
+/**
+ * Results loaded so far, page by page.
+ * Pages decode their words lazily, so joining them must not touch the words.
+ */
+private class PagedResults private constructor(
+    private val pages: List<List<String>>,
+    /**
+     * Index of the first word of every page, followed by the total size.
+     */
+    private val offsets: IntArray
+) : AbstractList<String>() {
+
+    override val size: Int get() = offsets.last()
+
+    override fun get(index: Int): String {
+        if (index < 0 || index >= size) {
+            throw IndexOutOfBoundsException("Index $index out of bounds for size $size")
+        }
+
+        // The last page starting at or before the index holds it
+        val found = offsets.binarySearch(index, 0, pages.size)
+        val page = if (found >= 0) found else -found - 2
+        return pages[page][index - offsets[page]]
+    }
+
+    /**
+     * Returns the results followed by another page of them.
+     * Empty pages are left out, so that every offset starts a page of its own.
+     */
+    fun withPage(page: List<String>): PagedResults {
+        if (page.isEmpty()) {
+            return this
+        }
+        return PagedResults(pages + listOf(page), offsets + (size + page.size))
+    }
+
+    companion object {
+
+        private val EMPTY = PagedResults(emptyList(), intArrayOf(0))
+
+        /**
+         * Joins the results loaded so far with another page of them.
+         */
+        fun of(previous: List<String>, page: List<String>): PagedResults {
+            val results = previous as? PagedResults ?: EMPTY.withPage(previous)
+            return results.withPage(page)
+        }
+    }
+}
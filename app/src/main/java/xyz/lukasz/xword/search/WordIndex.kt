@@ -1,11 +1,19 @@
 package xyz.lukasz.xword.search
 
 import android.content.res.AssetManager
+import kotlinx.coroutines.CoroutineStart
+import kotlinx.coroutines.awaitCancellation
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.launch
 import org.jetbrains.annotations.Contract
 import xyz.lukasz.xword.interop.NativeSharedPointer
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.text.Collator
 import java.text.Normalizer
 import java.util.*
+import java.util.concurrent.atomic.AtomicInteger
+import java.util.concurrent.atomic.AtomicReference
 
 abstract class WordIndex(
     /**
@@ -26,6 +34,18 @@ abstract class WordIndex(
      */
     protected var nativeIndex = NativeSharedPointer.nil()
 
+    /**
+     * Capacity of the buffers pages of results are written to.
+     * It grows whenever a page does not fit, and lookups may run on several threads at once.
+     */
+    private val pageBufferCapacity = AtomicInteger(INITIAL_PAGE_BUFFER_CAPACITY)
+
+    /**
+     * Direct buffer reused between page lookups, or null while a lookup is using it.
+     * Lookups running at the same time as that one allocate their own buffers.
+     */
+    private val pageBuffer = AtomicReference<ByteBuffer?>(null)
+
     /**
      * Is this index in a valid state?
      */
@@ -41,10 +61,37 @@ abstract class WordIndex(
         return "dictionaries/${locale.language}_${locale.country}/words.txt"
     }
 
+    /**
+     * Resolves the path of the dictionary to load: the front-coded one the Gradle build
+     * encodes from the plain text one (see encodeDictionaries), which takes half the space,
+     * or the plain text one in builds that still bundle it.
+     */
+    protected fun resolveDictionaryAssetPath(assetManager: AssetManager): String {
+        val frontCodedPath = "dictionaries/${locale.language}_${locale.country}/words.fcd"
+        return if (assetExists(assetManager, frontCodedPath)) frontCodedPath else resolveAssetPath()
+    }
+
+    /**
+     * Resolves the path of an index prebuilt from the dictionary by the host-side tooling.
+     * Such an asset might not be present in every build.
+     */
+    protected fun resolvePrebuiltAssetPath(): String {
+        return "dictionaries/${locale.language}_${locale.country}/words.idx"
+    }
+
+    /**
+     * Checks whether an asset exists without opening it.
+     */
+    protected fun assetExists(assetManager: AssetManager, path: String): Boolean {
+        val directory = path.substringBeforeLast('/', "")
+        val filename = path.substringAfterLast('/')
+        return assetManager.list(directory)?.contains(filename) ?: false
+    }
+
     @Contract("_ -> new", pure = true)
     fun lookup(query: String, maxResults: Int): MutableList<String> {
         return if (ready) {
-            val queryStr = Normalizer.normalize(query.lowercase(locale), Normalizer.Form.NFKC)
+            val queryStr = normalizeQuery(query)
             val resultArray = lookupNative(nativeIndex.getPointer(), queryStr, maxResults)
             mutableListOf(*resultArray)
         } else {
@@ -52,9 +99,129 @@ abstract class WordIndex(
         }
     }
 
+    /**
+     * Looks up a single page of results.
+     * Words come in the alphabetical order of the index, so pages do not overlap.
+     * The lookup blocks the calling thread, but cancelling the calling coroutine stops it
+     * within microseconds, instead of letting it search the rest of the index.
+     * @param cursor Cursor of the previous page of the same query, or null for the first page.
+     */
+    suspend fun lookupPage(query: String, maxResults: Int, cursor: ByteArray?): LookupPage {
+        if (!ready) {
+            return LookupPage.empty()
+        }
+
+        return LookupCancellation().use { cancellation ->
+            coroutineScope {
+                // Children get cancelled right away, even while the lookup blocks this thread,
+                // so a child waiting for the cancellation is the one to stop the lookup
+                val canceller = launch(start = CoroutineStart.UNDISPATCHED) {
+                    try {
+                        awaitCancellation()
+                    } finally {
+                        cancellation.cancel()
+                    }
+                }
+
+                try {
+                    lookupPage(query, maxResults, cursor, cancellation)
+                } finally {
+                    canceller.cancel()
+                }
+            }
+        }
+    }
+
+    @Contract("_, _, _, _ -> new", pure = true)
+    private fun lookupPage(
+        query: String,
+        maxResults: Int,
+        cursor: ByteArray?,
+        cancellation: LookupCancellation
+    ): LookupPage {
+        // The whole page is written to a single buffer, so that no strings are created up front
+        val queryStr = normalizeQuery(query)
+        val pointer = nativeIndex.getPointer()
+        val token = cancellation.getPointer()
+        val buffer = takePageBuffer()
+        try {
+            val ownPage = lookupPageNative(pointer, queryStr, maxResults, cursor, buffer, token)
+                ?: return LookupPage.fromBuffer(LookupPage.copyOf(buffer))
+
+            // The page did not fit, so it came in an array of its own, and the next one will fit
+            if (ownPage.isEmpty()) {
+                return LookupPage.empty()
+            }
+            growPageBuffers(ownPage.size)
+            return LookupPage.fromBuffer(ByteBuffer.wrap(ownPage).order(ByteOrder.nativeOrder()))
+        } finally {
+            pageBuffer.compareAndSet(null, buffer)
+        }
+    }
+
+    /**
+     * Reports how much native memory this index takes and what takes it,
+     * or null if the index is not loaded.
+     * The whole index gets walked, so this should not be called on the main thread.
+     */
+    fun memoryStats(): IndexMemoryStats? {
+        return if (ready) memoryStatsNative(nativeIndex.getPointer()) else null
+    }
+
+    /**
+     * Takes the reused page buffer, or allocates a new one if another lookup is using it
+     * or if it is too small for the biggest page so far.
+     */
+    private fun takePageBuffer(): ByteBuffer {
+        val capacity = pageBufferCapacity.get()
+        val buffer = pageBuffer.getAndSet(null)
+        return if (buffer != null && buffer.capacity() >= capacity) {
+            buffer
+        } else {
+            ByteBuffer.allocateDirect(capacity).order(ByteOrder.nativeOrder())
+        }
+    }
+
+    private fun growPageBuffers(capacity: Int) {
+        while (true) {
+            val current = pageBufferCapacity.get()
+            if (current >= capacity || pageBufferCapacity.compareAndSet(current, capacity)) {
+                return
+            }
+        }
+    }
+
+    protected fun normalizeQuery(query: String): String {
+        return Normalizer.normalize(query.lowercase(locale), Normalizer.Form.NFKC)
+    }
+
     private external fun lookupNative(pointer: Long, query: String, max: Int): Array<String>
 
+    /**
+     * Writes a page of results to the direct buffer.
+     * @param cancellation Pointer to a native cancellation token, or 0.
+     * @return Null if the page has been written to the buffer, or the page itself
+     * (in the same layout) if it did not fit. An empty array stands for a page too big to return.
+     */
+    private external fun lookupPageNative(
+        pointer: Long,
+        query: String,
+        max: Int,
+        cursor: ByteArray?,
+        buffer: ByteBuffer,
+        cancellation: Long
+    ): ByteArray?
+
+    private external fun memoryStatsNative(pointer: Long): IndexMemoryStats
+
     open fun unload() {
         nativeIndex.free()
     }
+
+    companion object {
+        /**
+         * Big enough for a page of 500 typical words.
+         */
+        private const val INITIAL_PAGE_BUFFER_CAPACITY: Int = 16 * 1024
+    }
 }
@@ -12,7 +12,9 @@ object WordIndexFactory {
     fun create(type: WordIndexType): WordIndex {
         val locale = getLocale()
         return when (type) {
-            WordIndexType.MISSING_LETTERS -> MissingLettersIndex(locale)
+            WordIndexType.MISSING_LETTERS ->
+                MissingLettersIndex(locale, compress = true, suffixes = true, positions = true)
+            WordIndexType.RHYMES -> RhymeIndex(locale)
             WordIndexType.ANAGRAMS -> AnagramIndex(locale)
             else -> throw IllegalArgumentException("Unknown category name: $type")
         }
@@ -2,5 +2,6 @@ package xyz.lukasz.xword.search
 
 enum class WordIndexType {
     MISSING_LETTERS,
+    RHYMES,
     ANAGRAMS;
 }
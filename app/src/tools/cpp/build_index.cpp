@@ -0,0 +1,100 @@
+#include "indexing/missing_letters.hpp"
+#include "indexing/prebuilt.hpp"
+#include "utils/mapped_file.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using crossword::indexing::MissingLettersIndex;
+using crossword::indexing::PrebuiltIndex;
+using crossword::utils::MappedFile;
+
+namespace prebuilt = crossword::indexing::prebuilt;
+
+/// Writes the whole buffer to a file, replacing it atomically.
+static bool write_file(const std::string& path, const std::vector<uint8_t>& contents) {
+    auto temp_path = path + ".tmp";
+    auto file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    auto written = std::fwrite(contents.data(), 1, contents.size(), file);
+    auto closed = std::fclose(file) == 0;
+    if (written != contents.size() || !closed) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+/// Builds a prebuilt missing letters index out of a plain text dictionary.
+/// Usage: crossword-index-builder <words.txt> <words.idx> [thread count]
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s <words.txt> <words.idx> [thread count]\n", argv[0]);
+        return 2;
+    }
+
+    int thread_count = argc > 3 ? std::atoi(argv[3])
+                                : static_cast<int>(std::thread::hardware_concurrency());
+
+    auto input = MappedFile::open(argv[1]);
+    if (input == nullptr) {
+        std::fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    auto index = std::make_unique<MissingLettersIndex>();
+    index->load_from_buffer_parallel(input->get_buffer(), static_cast<int>(input->size()),
+                                     std::max(thread_count, 1));
+
+    // A prebuilt index keeps a single word per trie node
+    if (index->has_homographs()) {
+        std::fprintf(stderr, "Some words differ only in letters outside of the alphabet\n");
+        return 1;
+    }
+
+    auto blob = prebuilt::serialize(index->root_node(), index->node_arenas(), index->words(),
+                                    MissingLettersIndex::alphabet_type::id);
+    if (blob.empty()) {
+        std::fprintf(stderr, "Could not serialize the index\n");
+        return 1;
+    }
+
+    if (!write_file(argv[2], blob)) {
+        std::fprintf(stderr, "Could not write %s\n", argv[2]);
+        return 1;
+    }
+
+    // Map the result back and make sure it answers the same as the index it was built from
+    auto output = MappedFile::open(argv[2]);
+    PrebuiltIndex prebuilt_index;
+    if (output != nullptr) {
+        prebuilt_index.load_from_buffer(output->get_buffer(), 0, output->size());
+    }
+
+    if (!prebuilt_index.valid()) {
+        std::fprintf(stderr, "Written index is not valid\n");
+        return 1;
+    }
+
+    constexpr size_t max_results = 100000;
+    for (auto pattern : {u8"k.t", u8"..a..", u8"ż..a", u8"......ość"}) {
+        auto expected = index->lookup(pattern, max_results);
+        auto actual = prebuilt_index.lookup(pattern, max_results);
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        if (expected != actual) {
+            std::fprintf(stderr, "Written index does not match for pattern %s\n",
+                         reinterpret_cast<const char*>(pattern));
+            return 1;
+        }
+    }
+
+    std::printf("Wrote %zu bytes to %s\n", blob.size(), argv[2]);
+    return 0;
+}
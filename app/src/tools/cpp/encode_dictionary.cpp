@@ -0,0 +1,87 @@
+#include "indexing/front_coded.hpp"
+#include "utils/lines.hpp"
+#include "utils/mapped_file.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using crossword::utils::MappedFile;
+
+namespace front_coded = crossword::indexing::front_coded;
+
+/// Writes the whole buffer to a file, replacing it atomically.
+static bool write_file(const std::string& path, const std::vector<uint8_t>& contents) {
+    auto temp_path = path + ".tmp";
+    auto file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    auto written = std::fwrite(contents.data(), 1, contents.size(), file);
+    auto closed = std::fclose(file) == 0;
+    if (written != contents.size() || !closed) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+/// Converts a plain text dictionary into a front-coded one.
+/// Usage: crossword-dictionary-encoder <words.txt> <words.fcd> [lines per block]
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s <words.txt> <words.fcd> [lines per block]\n", argv[0]);
+        return 2;
+    }
+
+    auto lines_per_block = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3]))
+                                    : front_coded::default_lines_per_block;
+
+    auto input = MappedFile::open(argv[1]);
+    if (input == nullptr) {
+        std::fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    auto blob = front_coded::encode(input->get_buffer(), input->size(), lines_per_block);
+    if (blob.empty()) {
+        std::fprintf(stderr, "Could not encode the dictionary\n");
+        return 1;
+    }
+
+    if (!write_file(argv[2], blob)) {
+        std::fprintf(stderr, "Could not write %s\n", argv[2]);
+        return 1;
+    }
+
+    // Map the result back and make sure it decodes to the lines it was encoded from
+    auto output = MappedFile::open(argv[2]);
+    front_coded::Dictionary dictionary;
+    if (output == nullptr || !dictionary.open(output->get_buffer(), output->size())) {
+        std::fprintf(stderr, "Written dictionary is not valid\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> expected;
+    crossword::utils::for_each_line(input->get_buffer(), 0, input->size(),
+                                    [&](const uint8_t* line, size_t length) {
+                                        expected.insert(expected.end(), line, line + length);
+                                        expected.push_back('\n');
+                                    });
+
+    auto thread_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (dictionary.decode(thread_count) != expected) {
+        std::fprintf(stderr, "Written dictionary does not decode to %s\n", argv[1]);
+        return 1;
+    }
+
+    std::printf("Wrote %zu bytes to %s (%zu lines, %.1f%% of %zu bytes)\n", blob.size(), argv[2],
+                dictionary.line_count(), 100.0 * static_cast<double>(blob.size())
+                                         / static_cast<double>(input->size()),
+                input->size());
+    return 0;
+}